@@ -0,0 +1,750 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+/**********************************************************************
+	CensusSGM.cpp : Defines the census transform and semi global
+				matching stereo matcher of the shared library.
+	The census of the 5x5 or 9x7 window is matched with Hamming
+	distances kept in 8 bits, aggregated along 4 or 8 paths and the
+	disparity is refined to 1/16 pixel, with SSE2 when available.
+	Refine searches a few disparities around a prior, for the levels
+	of the coarse to fine matching. ComputeMasked matches only the
+	pixels of a texture mask, with the costs of their window only.
+**********************************************************************/
+#include "Tara.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CENSUS_PATH_PAD		16	// Bytes around each path cost vector, the outer ones stay at 255
+
+namespace Tara
+{
+//Constructor
+CensusSGM::CensusSGM()
+{
+	gNumDisparities = 64;
+	gWindow = 5;
+	gPaths = 8;
+	gUniquenessRatio = 5;
+	gDisp12MaxDiff = 1;
+	SetPenalties(0, 0);
+}
+
+//Sets the parameters, the penalties are reset to the defaults of the window
+void CensusSGM::SetParams(int NumDisparities, int Window, int Paths, int UniquenessRatio, int Disp12MaxDiff)
+{
+	gNumDisparities = std::min(std::max((NumDisparities + 15) & ~15, 16), CENSUS_MAX_DISPARITIES);
+	gWindow = (Window <= 5) ? 5 : 9;
+	gPaths = (Paths <= 4) ? 4 : 8;
+	gUniquenessRatio = std::max(UniquenessRatio, 0);
+	gDisp12MaxDiff = Disp12MaxDiff;
+	SetPenalties(0, 0);
+}
+
+//Zero selects the defaults, P1 + P2 stay below the 8 bit range of the path costs
+void CensusSGM::SetPenalties(int P1, int P2)
+{
+	int MaxCost = (gWindow == 5) ? 24 : 62;
+
+	if(P1 <= 0)
+		P1 = (gWindow == 5) ? 4 : 10;
+	if(P2 <= 0)
+		P2 = (gWindow == 5) ? 48 : 120;
+
+	gP2 = std::min(P2, 255 - MaxCost);
+	gP1 = std::min(P1, gP2);
+}
+
+//Disparity of cv::Mat images
+void CensusSGM::compute(const cv::Mat &Left, const cv::Mat &Right, cv::Mat &LeftDisparity, cv::Mat *RightDisparity)
+{
+	CV_Assert(Left.type() == CV_8UC1 && Right.type() == CV_8UC1 && Left.size() == Right.size());
+
+	LeftDisparity.create(Left.rows, Left.cols, CV_16S);
+	if(RightDisparity)
+		RightDisparity->create(Left.rows, Left.cols, CV_16S);
+
+	Compute(Left.ptr<UINT8>(), (int)Left.step, Right.ptr<UINT8>(), (int)Right.step, Left.cols, Left.rows,
+		LeftDisparity.ptr<INT16>(), RightDisparity ? RightDisparity->ptr<INT16>() : NULL, (int)(LeftDisparity.step / sizeof(INT16)));
+}
+
+//Disparity of 8 bit buffers
+void CensusSGM::Compute(const UINT8 *Left, int LeftStride, const UINT8 *Right, int RightStride, int Width, int Height,
+			INT16 *LeftDisparity, INT16 *RightDisparity, int DispStride)
+{
+	int D = gNumDisparities, LP = D + 2 * CENSUS_PATH_PAD;
+	size_t Pixels = (size_t)Width * Height;
+
+	if(gCensusLeft.size() < Pixels)
+	{
+		gCensusLeft.resize(Pixels);
+		gCensusRight.resize(Pixels);
+	}
+	if(gCost.size() < Pixels * D)
+	{
+		gCost.resize(Pixels * D);
+		gSum.resize(Pixels * D);
+	}
+	//Two buffers for the horizontal path, two rows for each of the three other directions and the zero path
+	size_t PathVectors = 2 + 6 * (size_t)Width + 1;
+	if(gPath.size() != PathVectors * LP)
+	{
+		gPath.assign(PathVectors * LP, 255);
+		gPathMin.assign(PathVectors, 0);
+	}
+	memset(&gPath[(PathVectors - 1) * LP + CENSUS_PATH_PAD], 0, D);
+	gReversed.resize(Width + D);
+	gRightCost.resize(Width);
+	gRightDisp.resize(Width);
+
+	Census(Left, Width, Height, LeftStride, &gCensusLeft[0]);
+	Census(Right, Width, Height, RightStride, &gCensusRight[0]);
+
+	for(int y = 0; y < Height; y++)
+		RowCost(&gCensusLeft[(size_t)y * Width], &gCensusRight[(size_t)y * Width], Width, &gCost[(size_t)y * Width * D]);
+
+	Aggregate(Width, Height, true, LeftDisparity, RightDisparity, DispStride);
+	Aggregate(Width, Height, false, LeftDisparity, RightDisparity, DispStride);
+}
+
+//Census of one image, bit k is set when the k-th neighbour in row major order is darker than the centre
+void CensusSGM::Census(const UINT8 *Image, int Width, int Height, int Stride, UINT64 *Census)
+{
+	int rx = (gWindow == 5) ? 2 : 4, ry = (gWindow == 5) ? 2 : 3;
+	int PaddedWidth = Width + 2 * rx + 16, x = 0;
+
+	//Replicated borders, the extra 16 bytes keep the vector loads inside the buffer
+	gPadded.resize((size_t)PaddedWidth * (Height + 2 * ry));
+	for(int y = 0; y < Height + 2 * ry; y++)
+	{
+		const UINT8 *Src = Image + (size_t)std::min(std::max(y - ry, 0), Height - 1) * Stride;
+		UINT8 *Dst = &gPadded[(size_t)y * PaddedWidth];
+
+		memset(Dst, Src[0], rx);
+		memcpy(Dst + rx, Src, Width);
+		memset(Dst + rx + Width, Src[Width - 1], PaddedWidth - rx - Width);
+	}
+
+	for(int y = 0; y < Height; y++)
+	{
+		const UINT8 *Centre = &gPadded[(size_t)(y + ry) * PaddedWidth + rx];
+		UINT64 *Out = Census + (size_t)y * Width;
+
+		x = 0;
+#if defined(__SSE2__)
+		const __m128i Sign = _mm_set1_epi8((char)0x80);
+		for(; x + 16 <= Width; x += 16)
+		{
+			__m128i c = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Centre + x)), Sign);
+			__m128i p[8];
+			int k = 0;
+
+			for(int i = 0; i < 8; i++)
+				p[i] = _mm_setzero_si128();
+
+			for(int dy = -ry; dy <= ry; dy++)
+			{
+				for(int dx = -rx; dx <= rx; dx++)
+				{
+					if(dy == 0 && dx == 0)
+						continue;
+					__m128i n = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Centre + dy * PaddedWidth + x + dx)), Sign);
+					__m128i Bit = _mm_set1_epi8((char)(1 << (k & 7)));
+					p[k >> 3] = _mm_or_si128(p[k >> 3], _mm_and_si128(_mm_cmplt_epi8(n, c), Bit));
+					k++;
+				}
+			}
+
+			//Transpose the eight bit planes into one 64 bit census per pixel
+			for(int Half = 0; Half < 2; Half++)
+			{
+				__m128i a0, a1, a2, a3, b0, b1, b2, b3;
+				if(Half == 0)
+				{
+					a0 = _mm_unpacklo_epi8(p[0], p[1]); a1 = _mm_unpacklo_epi8(p[2], p[3]);
+					a2 = _mm_unpacklo_epi8(p[4], p[5]); a3 = _mm_unpacklo_epi8(p[6], p[7]);
+				}
+				else
+				{
+					a0 = _mm_unpackhi_epi8(p[0], p[1]); a1 = _mm_unpackhi_epi8(p[2], p[3]);
+					a2 = _mm_unpackhi_epi8(p[4], p[5]); a3 = _mm_unpackhi_epi8(p[6], p[7]);
+				}
+				b0 = _mm_unpacklo_epi16(a0, a1); b1 = _mm_unpackhi_epi16(a0, a1);
+				b2 = _mm_unpacklo_epi16(a2, a3); b3 = _mm_unpackhi_epi16(a2, a3);
+
+				__m128i *Dst = (__m128i*)(Out + x + Half * 8);
+				_mm_storeu_si128(Dst + 0, _mm_unpacklo_epi32(b0, b2));
+				_mm_storeu_si128(Dst + 1, _mm_unpackhi_epi32(b0, b2));
+				_mm_storeu_si128(Dst + 2, _mm_unpacklo_epi32(b1, b3));
+				_mm_storeu_si128(Dst + 3, _mm_unpackhi_epi32(b1, b3));
+			}
+		}
+#endif
+		for(; x < Width; x++)
+		{
+			UINT64 Value = 0;
+			int k = 0;
+			for(int dy = -ry; dy <= ry; dy++)
+			{
+				for(int dx = -rx; dx <= rx; dx++)
+				{
+					if(dy == 0 && dx == 0)
+						continue;
+					if(Centre[dy * PaddedWidth + x + dx] < Centre[x])
+						Value |= (UINT64)1 << k;
+					k++;
+				}
+			}
+			Out[x] = Value;
+		}
+	}
+}
+
+//Reverses the right census of one row so that the disparities of each left pixel are contiguous
+void CensusSGM::ReverseRow(const UINT64 *Right, int Width)
+{
+	UINT64 *Reversed = &gReversed[0];
+
+	for(int i = 0; i < Width; i++)
+		Reversed[i] = Right[Width - 1 - i];
+	memset(Reversed + Width, 0, gNumDisparities * sizeof(UINT64));
+}
+
+//Hamming distances of the left pixel x to the reversed right row
+void CensusSGM::PixelCost(UINT64 Left, int x, int Width, UINT8 *Out)
+{
+	int D = gNumDisparities, MaxCost = (gWindow == 5) ? 24 : 62;
+	const UINT64 *Candidates = &gReversed[0] + Width - 1 - x;
+	int d = 0;
+
+#if defined(__SSE2__)
+	const __m128i l = _mm_set1_epi64x((long long)Left);
+	const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+	const __m128i Zero = _mm_setzero_si128();
+	for(; d < D; d += 16)
+	{
+		__m128i s[8];
+		for(int i = 0; i < 8; i++)
+		{
+			//Bytewise population count, then the sum of the bytes of each 64 bit lane
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Candidates + d + 2 * i)), l);
+			v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+			v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+			v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+			s[i] = _mm_shuffle_epi32(_mm_sad_epu8(v, Zero), _MM_SHUFFLE(3, 3, 2, 0));
+		}
+		__m128i c0 = _mm_packs_epi32(_mm_unpacklo_epi64(s[0], s[1]), _mm_unpacklo_epi64(s[2], s[3]));
+		__m128i c1 = _mm_packs_epi32(_mm_unpacklo_epi64(s[4], s[5]), _mm_unpacklo_epi64(s[6], s[7]));
+		_mm_storeu_si128((__m128i*)(Out + d), _mm_packus_epi16(c0, c1));
+	}
+#endif
+	for(; d < D; d++)
+		Out[d] = (UINT8)__builtin_popcountll(Left ^ Candidates[d]);
+
+	//No right pixel for the disparities larger than x
+	for(d = x + 1; d < D; d++)
+		Out[d] = (UINT8)MaxCost;
+}
+
+//Hamming distances of one row
+void CensusSGM::RowCost(const UINT64 *Left, const UINT64 *Right, int Width, UINT8 *Cost)
+{
+	ReverseRow(Right, Width);
+
+	for(int x = 0; x < Width; x++)
+		PixelCost(Left[x], x, Width, Cost + (size_t)x * gNumDisparities);
+}
+
+//Cost of one path at one pixel: L = C + min(Lp(d), Lp(d-1) + P1, Lp(d+1) + P1, min Lp + P2) - min Lp
+static inline void AggregatePixel(const UINT8 *Cost, const UINT8 *Prev, UINT8 PrevMin, UINT8 *Cur, UINT8 *CurMin,
+					UINT16 *Sum, bool Store, int D, int P1, int P2)
+{
+	int d = 0;
+#if defined(__SSE2__)
+	const __m128i vP1 = _mm_set1_epi8((char)P1);
+	const __m128i vPrevMin = _mm_set1_epi8((char)PrevMin);
+	const __m128i vJump = _mm_set1_epi8((char)std::min((int)PrevMin + P2, 255));
+	const __m128i Zero = _mm_setzero_si128();
+	__m128i MinAcc = _mm_set1_epi8((char)0xff);
+
+	for(; d < D; d += 16)
+	{
+		__m128i m = _mm_min_epu8(_mm_adds_epu8(_mm_loadu_si128((const __m128i*)(Prev + d - 1)), vP1),
+					 _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(Prev + d + 1)), vP1));
+		m = _mm_min_epu8(m, _mm_loadu_si128((const __m128i*)(Prev + d)));
+		m = _mm_min_epu8(m, vJump);
+		__m128i L = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(Cost + d)), _mm_subs_epu8(m, vPrevMin));
+		_mm_storeu_si128((__m128i*)(Cur + d), L);
+		MinAcc = _mm_min_epu8(MinAcc, L);
+
+		__m128i Lo = _mm_unpacklo_epi8(L, Zero), Hi = _mm_unpackhi_epi8(L, Zero);
+		if(!Store)
+		{
+			Lo = _mm_add_epi16(Lo, _mm_loadu_si128((const __m128i*)(Sum + d)));
+			Hi = _mm_add_epi16(Hi, _mm_loadu_si128((const __m128i*)(Sum + d + 8)));
+		}
+		_mm_storeu_si128((__m128i*)(Sum + d), Lo);
+		_mm_storeu_si128((__m128i*)(Sum + d + 8), Hi);
+	}
+	MinAcc = _mm_min_epu8(MinAcc, _mm_srli_si128(MinAcc, 8));
+	MinAcc = _mm_min_epu8(MinAcc, _mm_srli_si128(MinAcc, 4));
+	MinAcc = _mm_min_epu8(MinAcc, _mm_srli_si128(MinAcc, 2));
+	MinAcc = _mm_min_epu8(MinAcc, _mm_srli_si128(MinAcc, 1));
+	*CurMin = (UINT8)_mm_cvtsi128_si32(MinAcc);
+#else
+	int Jump = std::min((int)PrevMin + P2, 255), Min = 255;
+	for(; d < D; d++)
+	{
+		int m = std::min(std::min(Prev[d - 1] + P1, Prev[d + 1] + P1), 255);
+		m = std::min(std::min(m, (int)Prev[d]), Jump);
+		int L = std::min(Cost[d] + m - PrevMin, 255);
+		Cur[d] = (UINT8)L;
+		Min = std::min(Min, L);
+		Sum[d] = (UINT16)(Store ? L : Sum[d] + L);
+	}
+	*CurMin = (UINT8)Min;
+#endif
+}
+
+//Aggregation along the horizontal, vertical and with 8 paths the diagonal directions
+void CensusSGM::Aggregate(int Width, int Height, bool Forward, INT16 *LeftDisparity, INT16 *RightDisparity, int DispStride)
+{
+	int D = gNumDisparities, LP = D + 2 * CENSUS_PATH_PAD;
+	int Step = Forward ? 1 : -1;
+	size_t ZeroPath = 2 + 6 * (size_t)Width;
+
+	//Path vector i starts at Base + i * LP, its minimum is Min[i]
+	UINT8 *Base = &gPath[CENSUS_PATH_PAD];
+	UINT8 *Min = &gPathMin[0];
+
+	for(int iy = 0; iy < Height; iy++)
+	{
+		int y = Forward ? iy : Height - 1 - iy;
+
+		//Rows of the vertical, first and second diagonal paths, current and previous
+		size_t Row[3][2];
+		for(int i = 0; i < 3; i++)
+		{
+			Row[i][0] = 2 + (size_t)(2 * i + (iy & 1)) * Width;
+			Row[i][1] = 2 + (size_t)(2 * i + ((iy + 1) & 1)) * Width;
+		}
+
+		for(int ix = 0; ix < Width; ix++)
+		{
+			int x = Forward ? ix : Width - 1 - ix;
+			size_t Pixel = (size_t)y * Width + x;
+			const UINT8 *Cost = &gCost[Pixel * D];
+			UINT16 *Sum = &gSum[Pixel * D];
+			size_t Prev, Cur;
+
+			//Along the row
+			Prev = (ix > 0) ? ((ix + 1) & 1) : ZeroPath;
+			Cur = ix & 1;
+			AggregatePixel(Cost, Base + Prev * LP, Min[Prev], Base + Cur * LP, &Min[Cur], Sum, Forward, D, gP1, gP2);
+
+			//Along the column
+			Prev = (iy > 0) ? Row[0][1] + x : ZeroPath;
+			Cur = Row[0][0] + x;
+			AggregatePixel(Cost, Base + Prev * LP, Min[Prev], Base + Cur * LP, &Min[Cur], Sum, false, D, gP1, gP2);
+
+			if(gPaths == 8)
+			{
+				//From the previous pixel of the previous row
+				Prev = (iy > 0 && ix > 0) ? Row[1][1] + x - Step : ZeroPath;
+				Cur = Row[1][0] + x;
+				AggregatePixel(Cost, Base + Prev * LP, Min[Prev], Base + Cur * LP, &Min[Cur], Sum, false, D, gP1, gP2);
+
+				//From the next pixel of the previous row
+				Prev = (iy > 0 && ix < Width - 1) ? Row[2][1] + x + Step : ZeroPath;
+				Cur = Row[2][0] + x;
+				AggregatePixel(Cost, Base + Prev * LP, Min[Prev], Base + Cur * LP, &Min[Cur], Sum, false, D, gP1, gP2);
+			}
+		}
+
+		//The sums of a row are complete once the backward pass leaves it
+		if(!Forward)
+			SelectRow(&gSum[(size_t)y * Width * D], Width, LeftDisparity + (size_t)y * DispStride,
+					RightDisparity ? RightDisparity + (size_t)y * DispStride : NULL);
+	}
+}
+
+//Winner takes all with the uniqueness check, parabolic subpixel and left right check as in cv::StereoSGBM
+void CensusSGM::SelectRow(const UINT16 *Sum, int Width, INT16 *LeftDisparity, INT16 *RightDisparity)
+{
+	int D = gNumDisparities;
+	const INT16 Invalid = -CENSUS_DISP_SCALE;
+
+	for(int x = 0; x < Width; x++)
+	{
+		gRightCost[x] = INT_MAX;
+		gRightDisp[x] = -1;
+	}
+
+	for(int x = 0; x < Width; x++)
+	{
+		const UINT16 *S = Sum + (size_t)x * D;
+		int MinS = INT_MAX, Second = INT_MAX, Best = 0, d;
+
+		//Sums stay below 8 * 255, signed 16 bit compares are safe
+#if defined(__SSE2__)
+		__m128i vMin = _mm_set1_epi16(0x7fff);
+		for(d = 0; d < D; d += 8)
+			vMin = _mm_min_epi16(vMin, _mm_loadu_si128((const __m128i*)(S + d)));
+		vMin = _mm_min_epi16(vMin, _mm_srli_si128(vMin, 8));
+		vMin = _mm_min_epi16(vMin, _mm_srli_si128(vMin, 4));
+		vMin = _mm_min_epi16(vMin, _mm_srli_si128(vMin, 2));
+		MinS = _mm_cvtsi128_si32(vMin) & 0xffff;
+
+		vMin = _mm_set1_epi16((short)MinS);
+		for(d = 0; d < D; d += 8)
+		{
+			int Mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(S + d)), vMin));
+			if(Mask)
+			{
+				Best = d + (__builtin_ctz(Mask) >> 1);
+				break;
+			}
+		}
+
+		//Smallest sum away from the best disparity and its neighbours
+		const __m128i Lanes = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), Max = _mm_set1_epi16(0x7fff);
+		const __m128i Low = _mm_set1_epi16((short)(Best - 2)), High = _mm_set1_epi16((short)(Best + 2));
+		__m128i vSecond = Max;
+		for(d = 0; d < D; d += 8)
+		{
+			__m128i Index = _mm_add_epi16(Lanes, _mm_set1_epi16((short)d));
+			__m128i Band = _mm_and_si128(_mm_cmpgt_epi16(Index, Low), _mm_cmplt_epi16(Index, High));
+			__m128i v = _mm_loadu_si128((const __m128i*)(S + d));
+			vSecond = _mm_min_epi16(vSecond, _mm_or_si128(_mm_andnot_si128(Band, v), _mm_and_si128(Band, Max)));
+		}
+		vSecond = _mm_min_epi16(vSecond, _mm_srli_si128(vSecond, 8));
+		vSecond = _mm_min_epi16(vSecond, _mm_srli_si128(vSecond, 4));
+		vSecond = _mm_min_epi16(vSecond, _mm_srli_si128(vSecond, 2));
+		Second = _mm_cvtsi128_si32(vSecond) & 0xffff;
+#else
+		for(d = 0; d < D; d++)
+		{
+			if(S[d] < MinS)
+			{
+				MinS = S[d];
+				Best = d;
+			}
+		}
+		Second = 0x7fff;
+		for(d = 0; d < D; d++)
+		{
+			if(abs(Best - d) > 1)
+				Second = std::min(Second, (int)S[d]);
+		}
+#endif
+
+		LeftDisparity[x] = Invalid;
+		if(Second * (100 - gUniquenessRatio) < MinS * 100)
+			continue;
+
+		int xr = x - Best;
+		if(xr >= 0 && gRightCost[xr] > MinS)
+		{
+			gRightCost[xr] = MinS;
+			gRightDisp[xr] = Best;
+		}
+
+		if(Best > 0 && Best < D - 1)
+		{
+			int Denom2 = std::max(S[Best - 1] + S[Best + 1] - 2 * S[Best], 1);
+			d = Best * CENSUS_DISP_SCALE + ((S[Best - 1] - S[Best + 1]) * CENSUS_DISP_SCALE + Denom2) / (Denom2 * 2);
+		}
+		else
+			d = Best * CENSUS_DISP_SCALE;
+		LeftDisparity[x] = (INT16)d;
+	}
+
+	if(gDisp12MaxDiff >= 0)
+	{
+		for(int x = 0; x < Width; x++)
+		{
+			int d1 = LeftDisparity[x];
+			if(d1 == Invalid)
+				continue;
+
+			//Both integer neighbours of the subpixel disparity have to disagree with the right view
+			int _d = d1 >> CENSUS_DISP_SHIFT, d_ = (d1 + CENSUS_DISP_SCALE - 1) >> CENSUS_DISP_SHIFT;
+			int _x = x - _d, x_ = x - d_;
+			if(0 <= _x && _x < Width && gRightDisp[_x] >= 0 && abs(gRightDisp[_x] - _d) > gDisp12MaxDiff &&
+			   0 <= x_ && x_ < Width && gRightDisp[x_] >= 0 && abs(gRightDisp[x_] - d_) > gDisp12MaxDiff)
+				LeftDisparity[x] = Invalid;
+		}
+	}
+
+	//Right view in the convention of the right matcher, negative disparities
+	if(RightDisparity)
+	{
+		for(int x = 0; x < Width; x++)
+			RightDisparity[x] = (INT16)((gRightDisp[x] >= 0) ? -gRightDisp[x] * CENSUS_DISP_SCALE : -D * CENSUS_DISP_SCALE);
+	}
+}
+
+//Searches Radius disparities on both sides of the prior, the costs are aggregated at the same offset from the prior
+//of each pixel, which holds where the prior is smooth
+void CensusSGM::Refine(const cv::Mat &Left, const cv::Mat &Right, const cv::Mat &Prior, int Radius, cv::Mat &Disparity)
+{
+	CV_Assert(Left.type() == CV_8UC1 && Right.type() == CV_8UC1 && Left.size() == Right.size());
+	CV_Assert(Prior.type() == CV_16S && Prior.size() == Left.size());
+
+	int Width = Left.cols, Height = Left.rows, Offsets = 2 * Radius + 1;
+	int MaxCost = (gWindow == 5) ? 24 : 62;
+	size_t Pixels = (size_t)Width * Height;
+	const INT16 Invalid = -CENSUS_DISP_SCALE;
+
+	if(gCensusLeft.size() < Pixels)
+	{
+		gCensusLeft.resize(Pixels);
+		gCensusRight.resize(Pixels);
+	}
+	Census(Left.ptr<UINT8>(), Width, Height, (int)Left.step, &gCensusLeft[0]);
+	Census(Right.ptr<UINT8>(), Width, Height, (int)Right.step, &gCensusRight[0]);
+
+	gRefineCost.resize(Offsets);
+	gRefineSum.resize(Offsets);
+	for(int k = 0; k < Offsets; k++)
+		gRefineCost[k].create(Height, Width, CV_16U);
+
+	for(int y = 0; y < Height; y++)
+	{
+		const INT16 *P = Prior.ptr<INT16>(y);
+		const UINT64 *L = &gCensusLeft[(size_t)y * Width], *R = &gCensusRight[(size_t)y * Width];
+
+		for(int x = 0; x < Width; x++)
+		{
+			int d0 = (P[x] + CENSUS_DISP_SCALE / 2) >> CENSUS_DISP_SHIFT;
+			for(int k = 0; k < Offsets; k++)
+			{
+				int xr = x - (d0 + k - Radius);
+				gRefineCost[k].ptr<UINT16>(y)[x] = (UINT16)((P[x] < 0 || xr < 0 || xr > x || xr >= Width) ?
+									MaxCost : __builtin_popcountll(L[x] ^ R[xr]));
+			}
+		}
+	}
+
+	for(int k = 0; k < Offsets; k++)
+	{
+		cv::boxFilter(gRefineCost[k], gRefineSum[k], CV_16U, cv::Size(CENSUS_REFINE_WINDOW, CENSUS_REFINE_WINDOW),
+				cv::Point(-1, -1), false, cv::BORDER_REPLICATE);
+	}
+
+	//More than a third of the bits differing is close to a random match
+	int Reject = CENSUS_REFINE_WINDOW * CENSUS_REFINE_WINDOW * MaxCost / 3;
+
+	Disparity.create(Height, Width, CV_16S);
+	for(int y = 0; y < Height; y++)
+	{
+		const INT16 *P = Prior.ptr<INT16>(y);
+		INT16 *D = Disparity.ptr<INT16>(y);
+
+		for(int x = 0; x < Width; x++)
+		{
+			int Best = 0, BestCost = INT_MAX;
+
+			D[x] = Invalid;
+			if(P[x] < 0)
+				continue;
+
+			for(int k = 0; k < Offsets; k++)
+			{
+				int Cost = gRefineSum[k].ptr<UINT16>(y)[x];
+				if(Cost < BestCost)
+				{
+					BestCost = Cost;
+					Best = k;
+				}
+			}
+
+			int d = ((P[x] + CENSUS_DISP_SCALE / 2) >> CENSUS_DISP_SHIFT) + Best - Radius;
+			if(BestCost > Reject || d < 0)
+				continue;
+
+			//Parabolic subpixel as in SelectRow, not at the ends of the window
+			if(Best > 0 && Best < Offsets - 1)
+			{
+				int c0 = gRefineSum[Best - 1].ptr<UINT16>(y)[x], c2 = gRefineSum[Best + 1].ptr<UINT16>(y)[x];
+				int Denom2 = std::max(c0 + c2 - 2 * BestCost, 1);
+				D[x] = (INT16)(d * CENSUS_DISP_SCALE + ((c0 - c2) * CENSUS_DISP_SCALE + Denom2) / (Denom2 * 2));
+			}
+			else
+			{
+				D[x] = (INT16)(d * CENSUS_DISP_SCALE);
+			}
+		}
+	}
+}
+
+//Pixels whose horizontal gradient reaches the threshold, the only direction along which the matching is resolved
+void CensusSGM::TextureMask(const cv::Mat &Image, int Threshold, cv::Mat &Mask)
+{
+	CV_Assert(Image.type() == CV_8UC1);
+
+	int Width = Image.cols;
+	UINT8 lThreshold = (UINT8)std::min(std::max(Threshold, 1), 255);
+
+	Mask.create(Image.size(), CV_8UC1);
+	for(int y = 0; y < Image.rows; y++)
+	{
+		const UINT8 *I = Image.ptr<UINT8>(y);
+		UINT8 *M = Mask.ptr<UINT8>(y);
+		int x = 1;
+
+		M[0] = 0;
+#if defined(__SSE2__)
+		const __m128i vThreshold = _mm_set1_epi8((char)lThreshold);
+		for(; x + 16 < Width; x += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(I + x - 1)), b = _mm_loadu_si128((const __m128i*)(I + x + 1));
+			__m128i Diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+			_mm_storeu_si128((__m128i*)(M + x), _mm_cmpeq_epi8(_mm_max_epu8(Diff, vThreshold), Diff));
+		}
+#endif
+		for(; x < Width - 1; x++)
+			M[x] = (abs(I[x + 1] - I[x - 1]) >= lThreshold) ? 255 : 0;
+		if(Width > 1)
+			M[Width - 1] = 0;
+	}
+}
+
+//Full range search of the masked pixels, the costs are computed only within CENSUS_REFINE_WINDOW of them
+void CensusSGM::ComputeMasked(const cv::Mat &Left, const cv::Mat &Right, const cv::Mat &Mask, cv::Mat &LeftDisparity)
+{
+	CV_Assert(Left.type() == CV_8UC1 && Right.type() == CV_8UC1 && Left.size() == Right.size());
+	CV_Assert(Mask.type() == CV_8UC1 && Mask.size() == Left.size());
+
+	int Width = Left.cols, Height = Left.rows, D = gNumDisparities, r = CENSUS_REFINE_WINDOW / 2;
+	int MaxCost = (gWindow == 5) ? 24 : 62;
+	size_t Pixels = (size_t)Width * Height;
+	const INT16 Invalid = -CENSUS_DISP_SCALE;
+
+	if(gCensusLeft.size() < Pixels)
+	{
+		gCensusLeft.resize(Pixels);
+		gCensusRight.resize(Pixels);
+	}
+	if(gCost.size() < Pixels * D)
+		gCost.resize(Pixels * D);
+	gReversed.resize(Width + D);
+	gMaskedSum.resize(D);
+
+	Census(Left.ptr<UINT8>(), Width, Height, (int)Left.step, &gCensusLeft[0]);
+	Census(Right.ptr<UINT8>(), Width, Height, (int)Right.step, &gCensusRight[0]);
+
+	//Costs of the pixels within the window of a masked pixel
+	cv::dilate(Mask, gSupport, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(CENSUS_REFINE_WINDOW, CENSUS_REFINE_WINDOW)));
+	for(int y = 0; y < Height; y++)
+	{
+		const UINT8 *S = gSupport.ptr<UINT8>(y);
+		const UINT64 *L = &gCensusLeft[(size_t)y * Width];
+		bool lReversed = false;
+
+		for(int x = 0; x < Width; x++)
+		{
+			if(!S[x])
+				continue;
+
+			if(!lReversed)
+			{
+				ReverseRow(&gCensusRight[(size_t)y * Width], Width);
+				lReversed = true;
+			}
+			PixelCost(L[x], x, Width, &gCost[((size_t)y * Width + x) * D]);
+		}
+	}
+
+	//More than a third of the bits differing is close to a random match, as in Refine
+	int Reject = CENSUS_REFINE_WINDOW * CENSUS_REFINE_WINDOW * MaxCost / 3;
+	UINT16 *Sum = &gMaskedSum[0];
+
+	LeftDisparity.create(Height, Width, CV_16S);
+	LeftDisparity.setTo(cv::Scalar(Invalid));
+	for(int y = 0; y < Height; y++)
+	{
+		const UINT8 *M = Mask.ptr<UINT8>(y);
+		INT16 *Out = LeftDisparity.ptr<INT16>(y);
+
+		for(int x = 0; x < Width; x++)
+		{
+			if(!M[x])
+				continue;
+
+			//Box of the costs, replicated at the borders
+			memset(Sum, 0, D * sizeof(UINT16));
+			for(int dy = -r; dy <= r; dy++)
+			{
+				int yy = std::min(std::max(y + dy, 0), Height - 1);
+				for(int dx = -r; dx <= r; dx++)
+				{
+					int xx = std::min(std::max(x + dx, 0), Width - 1);
+					const UINT8 *C = &gCost[((size_t)yy * Width + xx) * D];
+					int d = 0;
+#if defined(__SSE2__)
+					const __m128i Zero = _mm_setzero_si128();
+					for(; d < D; d += 16)
+					{
+						__m128i v = _mm_loadu_si128((const __m128i*)(C + d));
+						__m128i *Acc = (__m128i*)(Sum + d);
+						_mm_storeu_si128(Acc, _mm_add_epi16(_mm_loadu_si128(Acc), _mm_unpacklo_epi8(v, Zero)));
+						_mm_storeu_si128(Acc + 1, _mm_add_epi16(_mm_loadu_si128(Acc + 1), _mm_unpackhi_epi8(v, Zero)));
+					}
+#endif
+					for(; d < D; d++)
+						Sum[d] += C[d];
+				}
+			}
+
+			//Winner takes all with the uniqueness check of SelectRow
+			int MinS = INT_MAX, Second = 0x7fff, Best = 0, d;
+			for(d = 0; d < D; d++)
+			{
+				if(Sum[d] < MinS)
+				{
+					MinS = Sum[d];
+					Best = d;
+				}
+			}
+			for(d = 0; d < D; d++)
+			{
+				if(abs(Best - d) > 1)
+					Second = std::min(Second, (int)Sum[d]);
+			}
+
+			if(MinS > Reject || Second * (100 - gUniquenessRatio) < MinS * 100)
+				continue;
+
+			if(Best > 0 && Best < D - 1)
+			{
+				int Denom2 = std::max(Sum[Best - 1] + Sum[Best + 1] - 2 * Sum[Best], 1);
+				Out[x] = (INT16)(Best * CENSUS_DISP_SCALE + ((Sum[Best - 1] - Sum[Best + 1]) * CENSUS_DISP_SCALE + Denom2) / (Denom2 * 2));
+			}
+			else
+			{
+				Out[x] = (INT16)(Best * CENSUS_DISP_SCALE);
+			}
+		}
+	}
+}
+
+}
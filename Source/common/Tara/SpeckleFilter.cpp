@@ -0,0 +1,414 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+/**********************************************************************
+	SpeckleFilter.cpp : Defines the post processing of the disparity
+				map of the shared library.
+	The speckle filter labels the connected regions of horizontal
+	tiles in parallel with a union find of the pixels, merges the
+	labels of the tile seams and removes the small regions in
+	parallel. The hole filling fills the invalid runs of each row.
+	The temporal filter averages each pixel over the frames of a
+	static camera with SSE2 when available.
+**********************************************************************/
+#include "Tara.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Tara
+{
+//Constructor
+SpeckleFilter::SpeckleFilter()
+{
+}
+
+//Root of a pixel, halving the path on the way, only called on the pixels a single thread owns
+static inline int FindRoot(int *Parent, int Pixel)
+{
+	while(Parent[Pixel] != Pixel)
+	{
+		Parent[Pixel] = Parent[Parent[Pixel]];
+		Pixel = Parent[Pixel];
+	}
+	return Pixel;
+}
+
+//Root of a pixel without writing, for the threads reading the whole forest
+static inline int ReadRoot(const int *Parent, int Pixel)
+{
+	while(Parent[Pixel] != Pixel)
+		Pixel = Parent[Pixel];
+	return Pixel;
+}
+
+//Merges the regions of two pixels, the smaller region joins the larger one so the trees stay shallow
+static inline void Unite(int *Parent, int *Size, int A, int B)
+{
+	A = FindRoot(Parent, A);
+	B = FindRoot(Parent, B);
+	if(A == B)
+		return;
+
+	if(Size[A] < Size[B])
+		std::swap(A, B);
+
+	Parent[B] = A;
+	Size[A] += Size[B];
+}
+
+//Rows of a tile, the tiles split the map evenly
+static inline int TileRow(int Rows, int Tile, int Tiles)
+{
+	return Rows * Tile / Tiles;
+}
+
+//Labels the regions within each tile, the pixels of a tile only join the pixels of the same tile
+class SpeckleLabelBody : public cv::ParallelLoopBody
+{
+public:
+	SpeckleLabelBody(const cv::Mat &Disparity, int NewVal, int MaxDiff, int Tiles, int *Parent, int *Size) :
+		gDisparity(Disparity), gNewVal(NewVal), gMaxDiff(MaxDiff), gTiles(Tiles), gParent(Parent), gSize(Size)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Tiles) const
+	{
+		int lCols = gDisparity.cols;
+
+		for(int Tile = Tiles.start; Tile < Tiles.end; Tile++)
+		{
+			int y0 = TileRow(gDisparity.rows, Tile, gTiles);
+			int y1 = TileRow(gDisparity.rows, Tile + 1, gTiles);
+
+			for(int y = y0; y < y1; y++)
+			{
+				const INT16 *lRow = gDisparity.ptr<INT16>(y);
+				const INT16 *lUp = (y > y0) ? gDisparity.ptr<INT16>(y - 1) : NULL;
+				int lBase = y * lCols;
+
+				for(int x = 0; x < lCols; x++)
+				{
+					int lPixel = lBase + x;
+
+					if(lRow[x] == gNewVal)
+					{
+						gParent[lPixel] = -1;
+						continue;
+					}
+
+					gParent[lPixel] = lPixel;
+					gSize[lPixel] = 1;
+
+					if(x > 0 && lRow[x - 1] != gNewVal && abs(lRow[x] - lRow[x - 1]) <= gMaxDiff)
+						Unite(gParent, gSize, lPixel, lPixel - 1);
+
+					if(lUp != NULL && lUp[x] != gNewVal && abs(lRow[x] - lUp[x]) <= gMaxDiff)
+						Unite(gParent, gSize, lPixel, lPixel - lCols);
+				}
+			}
+		}
+	}
+
+private:
+	const cv::Mat &gDisparity;
+	int gNewVal, gMaxDiff, gTiles;
+	int *gParent, *gSize;
+};
+
+//Sets the pixels of the regions with at most MaxSpeckleSize pixels to NewVal, the forest is only read
+class SpeckleRemoveBody : public cv::ParallelLoopBody
+{
+public:
+	SpeckleRemoveBody(cv::Mat &Disparity, int NewVal, int MaxSpeckleSize, int Tiles, const int *Parent, const int *Size) :
+		gDisparity(Disparity), gNewVal(NewVal), gMaxSpeckleSize(MaxSpeckleSize), gTiles(Tiles), gParent(Parent), gSize(Size)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Tiles) const
+	{
+		int lCols = gDisparity.cols;
+
+		for(int Tile = Tiles.start; Tile < Tiles.end; Tile++)
+		{
+			int y0 = TileRow(gDisparity.rows, Tile, gTiles);
+			int y1 = TileRow(gDisparity.rows, Tile + 1, gTiles);
+
+			for(int y = y0; y < y1; y++)
+			{
+				INT16 *lRow = gDisparity.ptr<INT16>(y);
+				const int *lParent = gParent + y * lCols;
+
+				for(int x = 0; x < lCols; x++)
+				{
+					if(lParent[x] >= 0 && gSize[ReadRoot(gParent, y * lCols + x)] <= gMaxSpeckleSize)
+						lRow[x] = (INT16)gNewVal;
+				}
+			}
+		}
+	}
+
+private:
+	cv::Mat &gDisparity;
+	int gNewVal, gMaxSpeckleSize, gTiles;
+	const int *gParent, *gSize;
+};
+
+//Removes the small regions of similar disparities
+void SpeckleFilter::Filter(cv::Mat &Disparity, int NewVal, int MaxSpeckleSize, int MaxDiff)
+{
+	CV_Assert(Disparity.type() == CV_16S);
+
+	if(MaxSpeckleSize <= 0 || Disparity.empty())
+		return;
+
+	int lTiles = std::max(1, std::min(cv::getNumThreads(), Disparity.rows / SPECKLE_MIN_TILE_ROWS));
+	int lCols = Disparity.cols;
+
+	if(gParent.size() < Disparity.total())
+	{
+		gParent.resize(Disparity.total());
+		gSize.resize(Disparity.total());
+	}
+
+	int *lParent = &gParent[0];
+	int *lSize = &gSize[0];
+
+	cv::parallel_for_(cv::Range(0, lTiles), SpeckleLabelBody(Disparity, NewVal, MaxDiff, lTiles, lParent, lSize), (double)lTiles);
+
+	//The regions crossing a seam are merged serially, one row per seam
+	for(int Tile = 1; Tile < lTiles; Tile++)
+	{
+		int y = TileRow(Disparity.rows, Tile, lTiles);
+		const INT16 *lRow = Disparity.ptr<INT16>(y);
+		const INT16 *lUp = Disparity.ptr<INT16>(y - 1);
+
+		for(int x = 0; x < lCols; x++)
+		{
+			if(lRow[x] != NewVal && lUp[x] != NewVal && abs(lRow[x] - lUp[x]) <= MaxDiff)
+				Unite(lParent, lSize, y * lCols + x, (y - 1) * lCols + x);
+		}
+	}
+
+	cv::parallel_for_(cv::Range(0, lTiles), SpeckleRemoveBody(Disparity, NewVal, MaxSpeckleSize, lTiles, lParent, lSize), (double)lTiles);
+}
+
+//Fills the invalid runs of a range of rows
+class HoleFillBody : public cv::ParallelLoopBody
+{
+public:
+	HoleFillBody(cv::Mat &Disparity, int Invalid, int MaxWidth, bool Interpolate) :
+		gDisparity(Disparity), gInvalid(Invalid), gMaxWidth(MaxWidth), gInterpolate(Interpolate)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Rows) const
+	{
+		int lCols = gDisparity.cols;
+
+		for(int y = Rows.start; y < Rows.end; y++)
+		{
+			INT16 *lRow = gDisparity.ptr<INT16>(y);
+			int x = 0;
+
+			while(x < lCols)
+			{
+				if(lRow[x] > gInvalid)
+				{
+					x++;
+					continue;
+				}
+
+				int lStart = x;
+				while(x < lCols && lRow[x] <= gInvalid)
+					x++;
+
+				//Rows without a valid pixel stay invalid
+				if(lStart == 0 && x == lCols)
+					break;
+
+				if(gMaxWidth > 0 && x - lStart > gMaxWidth)
+					continue;
+
+				if(gInterpolate && lStart > 0 && x < lCols)
+				{
+					int lLeft = lRow[lStart - 1], lRight = lRow[x];
+					int lSpan = x - lStart + 1;
+					for(int i = lStart; i < x; i++)
+						lRow[i] = (INT16)(lLeft + (lRight - lLeft) * (i - lStart + 1) / lSpan);
+				}
+				else
+				{
+					INT16 lFill = (lStart == 0) ? lRow[x] : (x == lCols) ? lRow[lStart - 1] : std::min(lRow[lStart - 1], lRow[x]);
+					for(int i = lStart; i < x; i++)
+						lRow[i] = lFill;
+				}
+			}
+		}
+	}
+
+private:
+	cv::Mat &gDisparity;
+	int gInvalid, gMaxWidth;
+	bool gInterpolate;
+};
+
+//Fills the invalid runs of each row from their ends
+void SpeckleFilter::FillHoles(cv::Mat &Disparity, int Invalid, int MaxWidth, bool Interpolate)
+{
+	CV_Assert(Disparity.type() == CV_16S);
+
+	cv::parallel_for_(cv::Range(0, Disparity.rows), HoleFillBody(Disparity, Invalid, MaxWidth, Interpolate));
+}
+
+//Constructor
+TemporalFilter::TemporalFilter()
+{
+	gPersistence = 0;
+}
+
+//Forgets the previous frames
+void TemporalFilter::Reset()
+{
+	gAverage.release();
+	gAge.release();
+}
+
+#if defined(__SSE2__)
+//Lanes of A where Mask is set, of B elsewhere
+static inline __m128i Select(__m128i Mask, __m128i A, __m128i B)
+{
+	return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+}
+
+static inline __m128 Select(__m128 Mask, __m128 A, __m128 B)
+{
+	return _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B));
+}
+#endif
+
+//Filters one row, the SSE2 loop gives the same result as the scalar one
+static void TemporalRow(INT16 *Disparity, float *Average, int *Age, int Width, int Invalid, float Alpha, int Persistence, float ResetDiff)
+{
+	int x = 0;
+
+#if defined(__SSE2__)
+	const __m128i lInvalid = _mm_set1_epi32(Invalid);
+	const __m128i lNoAverage = _mm_set1_epi32(Persistence + 1);
+	const __m128i lOne = _mm_set1_epi32(1);
+	const __m128 lAlpha = _mm_set1_ps(Alpha);
+	const __m128 lResetDiff = _mm_set1_ps(ResetDiff);
+	const __m128 lAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	for(; x <= Width - 8; x += 8)
+	{
+		__m128i lRaw = _mm_loadu_si128((const __m128i*)(Disparity + x));
+		__m128i lOut[2];
+
+		for(int Half = 0; Half < 2; Half++)
+		{
+			//Sign extension of four disparities
+			__m128i lDisp = (Half == 0) ? _mm_srai_epi32(_mm_unpacklo_epi16(lRaw, lRaw), 16) : _mm_srai_epi32(_mm_unpackhi_epi16(lRaw, lRaw), 16);
+			__m128 lNew = _mm_cvtepi32_ps(lDisp);
+			__m128 lAverage = _mm_loadu_ps(Average + x + 4 * Half);
+			__m128i lAge = _mm_loadu_si128((const __m128i*)(Age + x + 4 * Half));
+
+			__m128i lValid = _mm_cmpgt_epi32(lDisp, lInvalid);
+			__m128i lHeld = _mm_cmpgt_epi32(lNoAverage, lAge);
+			__m128 lDiff = _mm_sub_ps(lNew, lAverage);
+			__m128 lBlend = _mm_and_ps(_mm_castsi128_ps(lHeld), _mm_cmple_ps(_mm_and_ps(lDiff, lAbsMask), lResetDiff));
+
+			//Valid pixels are averaged or restart, the others keep their average and age until it is dropped
+			lNew = Select(lBlend, _mm_add_ps(lAverage, _mm_mul_ps(lAlpha, lDiff)), lNew);
+			lAverage = Select(_mm_castsi128_ps(lValid), lNew, lAverage);
+			lAge = _mm_andnot_si128(lValid, _mm_add_epi32(lAge, _mm_and_si128(lHeld, lOne)));
+
+			_mm_storeu_ps(Average + x + 4 * Half, lAverage);
+			_mm_storeu_si128((__m128i*)(Age + x + 4 * Half), lAge);
+
+			lOut[Half] = Select(_mm_cmpgt_epi32(lNoAverage, lAge), _mm_cvtps_epi32(lAverage), lInvalid);
+		}
+
+		_mm_storeu_si128((__m128i*)(Disparity + x), _mm_packs_epi32(lOut[0], lOut[1]));
+	}
+#endif
+
+	for(; x < Width; x++)
+	{
+		bool lHeld = (Age[x] <= Persistence);
+
+		if(Disparity[x] > Invalid)
+		{
+			float lDiff = Disparity[x] - Average[x];
+			Average[x] = (lHeld && fabsf(lDiff) <= ResetDiff) ? Average[x] + Alpha * lDiff : (float)Disparity[x];
+			Age[x] = 0;
+		}
+		else if(lHeld)
+		{
+			Age[x]++;
+		}
+
+		Disparity[x] = (INT16)((Age[x] <= Persistence) ? cvRound(Average[x]) : Invalid);
+	}
+}
+
+//Filters a range of rows
+class TemporalBody : public cv::ParallelLoopBody
+{
+public:
+	TemporalBody(cv::Mat &Disparity, cv::Mat &Average, cv::Mat &Age, int Invalid, float Alpha, int Persistence, float ResetDiff) :
+		gDisparity(Disparity), gAverage(Average), gAge(Age), gInvalid(Invalid), gAlpha(Alpha), gPersistence(Persistence), gResetDiff(ResetDiff)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Rows) const
+	{
+		for(int y = Rows.start; y < Rows.end; y++)
+		{
+			TemporalRow(gDisparity.ptr<INT16>(y), gAverage.ptr<float>(y), gAge.ptr<int>(y), gDisparity.cols,
+					gInvalid, gAlpha, gPersistence, gResetDiff);
+		}
+	}
+
+private:
+	cv::Mat &gDisparity, &gAverage, &gAge;
+	int gInvalid;
+	float gAlpha;
+	int gPersistence;
+	float gResetDiff;
+};
+
+//Averages the map with the previous frames
+void TemporalFilter::Filter(cv::Mat &Disparity, int Invalid, float Alpha, int Persistence, float ResetDiff)
+{
+	CV_Assert(Disparity.type() == CV_16S);
+
+	//A new size or persistence starts without an average
+	if(gAverage.size() != Disparity.size() || Persistence != gPersistence)
+	{
+		gAverage = cv::Mat::zeros(Disparity.size(), CV_32F);
+		gAge.create(Disparity.size(), CV_32S);
+		gAge.setTo(cv::Scalar(Persistence + 1));
+		gPersistence = Persistence;
+	}
+
+	cv::parallel_for_(cv::Range(0, Disparity.rows), TemporalBody(Disparity, gAverage, gAge, Invalid, Alpha, Persistence, ResetDiff));
+}
+
+}
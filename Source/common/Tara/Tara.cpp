@@ -194,7 +194,33 @@ Disparity::Disparity()
 	ImageSize.height = 0;
 
 	//Default
-	e_DisparityOption = 1;
+	gFilteredDisparity = false;
+	GetDisparityPresetParams(DISPARITY_OPTION ? DISPARITY_PRESET_BALANCED_SGBM : DISPARITY_PRESET_FAST_BM, &gParams);
+	gPendingParams = gParams;
+	gParamsPending = false;
+	gFilterCreated = false;
+	e_ScaleImage = gParams.ScaleImage;
+	gDepthLUTScale = 0;
+	gDisparityFrames = 0;
+	gRegionFrame = 0;
+	gNumberOfDisparities = gParams.NumberOfDisparities;
+	gPriorFrames = 0;
+	gSearchRatio = 1.0;
+	pthread_mutex_init(&gParamsLock, NULL);
+
+	memset(&gTiming, 0x00, sizeof(gTiming));
+	gLastDisparityNs = 0;
+	IMUHistoryFirst = 0;
+
+	//Right matcher worker, started on the first filtered frame
+	gWorkerRunning = false;
+	gWorkerExit = false;
+	gJobPending = false;
+	gJobDone = false;
+	gJobFailed = false;
+	pthread_mutex_init(&gWorkerLock, NULL);
+	pthread_cond_init(&gJobCond, NULL);
+	pthread_cond_init(&gDoneCond, NULL);
 }
 
 //Destructor
@@ -208,6 +234,12 @@ Disparity::~Disparity()
 
 	//Deinitialise the extension unit
 	DeinitExtensionUnit();
+
+	StopRightWorker();
+	pthread_cond_destroy(&gDoneCond);
+	pthread_cond_destroy(&gJobCond);
+	pthread_mutex_destroy(&gWorkerLock);
+	pthread_mutex_destroy(&gParamsLock);
 }
 
 BOOL Disparity::InitCamera(bool GenerateDisparity, bool FilteredDisparityMap)
@@ -318,6 +350,147 @@ BOOL Disparity::GrabFrame(cv::Mat *LeftImage, cv::Mat *RightImage)
 	return TRUE;
 }
 
+//Grabs the frame along with the CLOCK_MONOTONIC time it was captured
+BOOL Disparity::GrabFrame(cv::Mat *LeftImage, cv::Mat *RightImage, UINT64 *TimestampNs)
+{
+	if(!GrabFrame(LeftImage, RightImage))
+		return FALSE;
+
+	//V4L2 stamps the buffer with CLOCK_MONOTONIC when the frame is dequeued
+	UINT64 lNow = GetMonotonicTimeNs();
+	double lBufferMs = _CameraDevice.get(CV_CAP_PROP_POS_MSEC);
+	UINT64 lBufferNs = (lBufferMs > 0) ? (UINT64)(lBufferMs * 1000000.0) : 0;
+
+	//Falls back to the local time if the backend reports a different clock
+	if(lBufferNs == 0 || lBufferNs > lNow || (lNow - lBufferNs) > 1000000000ULL)
+		lBufferNs = lNow;
+
+	*TimestampNs = lBufferNs;
+	return TRUE;
+}
+
+//Orders the IMU samples by time
+static bool IMUSampleBefore(const IMURAWSAMPLE_TypeDef &Sample, UINT64 TimestampNs)
+{
+	return Sample.TimestampNs < TimestampNs;
+}
+
+//Moves the IMU samples from the ring to the history until EndNs is covered
+BOOL Disparity::UpdateIMUHistory(UINT64 EndNs, int TimeoutMs)
+{
+	UINT32 lNumValues = 0;
+	UINT64 lDeadline = GetMonotonicTimeNs() + (UINT64)max(TimeoutMs, 0) * 1000000ULL;
+
+	if(IMUBatch.size() != IMU_BATCH_VALUES)
+		IMUBatch.resize(IMU_BATCH_VALUES);
+
+	for(;;)
+	{
+		//Drain whatever is queued without waiting
+		while(PopIMURawBatch(&IMUBatch[0], IMU_BATCH_VALUES, 0, &lNumValues) && lNumValues > 0)
+			IMUHistory.insert(IMUHistory.end(), IMUBatch.begin(), IMUBatch.begin() + lNumValues);
+
+		if(!IMUHistory.empty() && IMUHistory.back().TimestampNs >= EndNs)
+			break;
+
+		//Wait for the sample after EndNs, one sample is enough to end the wait
+		UINT64 lNow = GetMonotonicTimeNs();
+		if(TimeoutMs <= 0 || lNow >= lDeadline)
+			break;
+
+		if(!PopIMURawBatch(&IMUBatch[0], 1, (INT32)((lDeadline - lNow) / 1000000ULL) + 1, &lNumValues))
+			break;
+		if(lNumValues > 0)
+			IMUHistory.push_back(IMUBatch[0]);
+	}
+
+	//Drop the samples older than the history window
+	if(!IMUHistory.empty() && IMUHistory.back().TimestampNs > IMU_HISTORY_NS)
+	{
+		UINT64 lOldest = IMUHistory.back().TimestampNs - IMU_HISTORY_NS;
+		deque<IMURAWSAMPLE_TypeDef>::iterator lKept = lower_bound(IMUHistory.begin(), IMUHistory.end(), lOldest, IMUSampleBefore);
+		IMUHistoryFirst += lKept - IMUHistory.begin();
+		IMUHistory.erase(IMUHistory.begin(), lKept);
+	}
+
+	return (!IMUHistory.empty() && IMUHistory.back().TimestampNs >= EndNs);
+}
+
+//Returns the raw IMU samples received in [StartNs, EndNs)
+BOOL Disparity::GetIMURawBundle(UINT64 StartNs, UINT64 EndNs, vector<IMURAWSAMPLE_TypeDef> *Samples, int TimeoutMs)
+{
+	BOOL lComplete;
+
+	Samples->clear();
+	if(EndNs <= StartNs)
+		return FALSE;
+
+	lComplete = UpdateIMUHistory(EndNs, TimeoutMs);
+
+	deque<IMURAWSAMPLE_TypeDef>::iterator lFirst = lower_bound(IMUHistory.begin(), IMUHistory.end(), StartNs, IMUSampleBefore);
+	deque<IMURAWSAMPLE_TypeDef>::iterator lLast = lower_bound(lFirst, IMUHistory.end(), EndNs, IMUSampleBefore);
+	Samples->assign(lFirst, lLast);
+
+	//FALSE when the interval is not fully covered yet, the samples found so far are still returned
+	return lComplete;
+}
+
+//Returns the IMU samples received in [StartNs, EndNs)
+BOOL Disparity::GetIMUBundle(UINT64 StartNs, UINT64 EndNs, vector<IMUDATAOUTPUT_TypeDef> *Samples, int TimeoutMs)
+{
+	vector<IMURAWSAMPLE_TypeDef> lRawSamples;
+	BOOL lComplete = GetIMURawBundle(StartNs, EndNs, &lRawSamples, TimeoutMs);
+
+	Samples->resize(lRawSamples.size());
+	if(!lRawSamples.empty())
+	{
+		ConvertIMURawToValues(&lRawSamples[0], lRawSamples.size(), &(*Samples)[0]);
+
+		//Numbered by their position in the stream rather than in the bundle
+		UINT64 lFirst = IMUHistoryFirst + (lower_bound(IMUHistory.begin(), IMUHistory.end(), lRawSamples[0].TimestampNs, IMUSampleBefore) - IMUHistory.begin());
+		for(size_t index = 0; index < Samples->size(); index++)
+			(*Samples)[index].IMU_VALUE_ID = (UINT16)(((lFirst + index) % IMU_AXES_VALUES_MAX) + 1);
+	}
+
+	return lComplete;
+}
+
+//Returns the IMU sample interpolated at TimestampNs
+BOOL Disparity::GetIMUValueAt(UINT64 TimestampNs, IMUDATAOUTPUT_TypeDef *Sample, int TimeoutMs)
+{
+	if(!UpdateIMUHistory(TimestampNs, TimeoutMs))
+		return FALSE;
+
+	deque<IMURAWSAMPLE_TypeDef>::iterator lNext = lower_bound(IMUHistory.begin(), IMUHistory.end(), TimestampNs, IMUSampleBefore);
+	if(lNext == IMUHistory.begin())
+	{
+		//Older than the history, only exact matches are returned
+		if(lNext->TimestampNs != TimestampNs)
+			return FALSE;
+		ConvertIMURawToValues(&(*lNext), 1, Sample);
+		Sample->IMU_VALUE_ID = (UINT16)((IMUHistoryFirst % IMU_AXES_VALUES_MAX) + 1);
+		return TRUE;
+	}
+
+	IMUDATAOUTPUT_TypeDef lA, lB;
+	ConvertIMURawToValues(&(*(lNext - 1)), 1, &lA);
+	ConvertIMURawToValues(&(*lNext), 1, &lB);
+	double t = (lB.TimestampNs > lA.TimestampNs) ? double(TimestampNs - lA.TimestampNs) / double(lB.TimestampNs - lA.TimestampNs) : 1.0;
+
+	//The ID of the nearest sample, from its position in the stream as the device sends none
+	UINT64 lNearest = IMUHistoryFirst + (lNext - IMUHistory.begin()) - ((t < 0.5) ? 1 : 0);
+	Sample->IMU_VALUE_ID = (UINT16)((lNearest % IMU_AXES_VALUES_MAX) + 1);
+	Sample->accX  = lA.accX  + t * (lB.accX  - lA.accX);
+	Sample->accY  = lA.accY  + t * (lB.accY  - lA.accY);
+	Sample->accZ  = lA.accZ  + t * (lB.accZ  - lA.accZ);
+	Sample->gyroX = lA.gyroX + t * (lB.gyroX - lA.gyroX);
+	Sample->gyroY = lA.gyroY + t * (lB.gyroY - lA.gyroY);
+	Sample->gyroZ = lA.gyroZ + t * (lB.gyroZ - lA.gyroZ);
+	Sample->TimestampNs = TimestampNs;
+
+	return TRUE;
+}
+
 //initialise all the variables and create the Disparity parameters
 BOOL Disparity::Init(bool GenerateDisparity) 
 {
@@ -343,201 +516,1188 @@ BOOL Disparity::Init(bool GenerateDisparity)
 	//Initialises only when the disparity option is enabled
 	if(GenerateDisparity)
 	{
-		//BM method Parameters for computing Disparity Map
-		bm_preFilterSize	=	5;
-		bm_preFilterCap		=	25;
-		bm_SADWindowSize	=	20; // must be odd, within 5..255 and not larger than image width or height
-		bm_minDisparity		=	0;	
-		bm_textureThreshold	=	5;
-		bm_uniquenessRatio	=	1;	
-		bm_speckleRange		=	31;
-		bm_disp12MaxDiff	=	1;
-		bm_numberOfDisparities	=	4;  // = val * 16
-		bm_speckleWindowSize	=	350;
-
-		//SGBM method Parameters for computing Disparity Map
-		sgbm_preFilterCap	=	61;
-		sgbm_SADWindowSize	=	8;
-		sgbm_minDisparity	=	0; 
-		sgbm_speckleRange	=	31;
-		sgbm_disp12MaxDiff	=	1;	
-		sgbm_uniquenessRatio	 =	0; 
-		sgbm_speckleWindowSize	 =	200;
-		sgbm_numberOfDisparities =	4;
-
-		e_DWSLFLambda	=	8000.0;
-		e_DWSLFSigma	=	1.5;
-		e_ScaleDispMap	=	5.0;
-		e_ScaleImage	=	0.60;
+		//Disparity Map Quality and Frame Rate from the compile time option, the filter from the user choice
+		GetDisparityPresetParams(DISPARITY_OPTION ? DISPARITY_PRESET_BALANCED_SGBM : DISPARITY_PRESET_FAST_BM, &gParams);
+		gParams.Filtered = gFilteredDisparity;
+		ValidateParams(&gParams);
 	
-		if(DISPARITY_OPTION) // Disparity Map Quality and Frame Rate 
+		mRange = cv::Mat(cv::Size(50, ImageSize.height), CV_8UC1);
+		for (int Row = 0; Row < ImageSize.height; Row++)
 		{
-			e_DisparityOption = 1;  // 1 - Stereo_SGBM
+			const float scaleR = float(255.0 / (float)ImageSize.height);
+			mRange.row(Row).setTo(Row * scaleR);
 		}
-		else
+
+		//Algorithm Parameters
+		SetAlgorithmParam();
+	}	
+
+	return TRUE;
+}
+
+//Parameters the right matcher and the WLS filter copy from the left matcher when they are created
+static bool SameMatchingRange(const DISPARITYPARAMS_TypeDef &A, const DISPARITYPARAMS_TypeDef &B)
+{
+	return A.Matcher == B.Matcher && A.NumberOfDisparities == B.NumberOfDisparities &&
+		A.MinDisparity == B.MinDisparity && A.BlockSize == B.BlockSize && A.PreFilterCap == B.PreFilterCap;
+}
+
+//The WLS filter is the only one which needs the right disparity
+static bool NeedsRightView(const DISPARITYPARAMS_TypeDef &Params)
+{
+	return Params.Filtered && Params.PostFilter == DISPARITY_FILTER_WLS;
+}
+
+//Setting up the parameters of Disparity Algorithm, the matchers are created once and then updated through their setters
+BOOL Disparity::SetAlgorithmParam()
+{	
+	if(DEBUG_ENABLED)
+		cout << "SetAlgorithmParam : Setting Up the Algorithm Parameters\n";
+	int numberOfDisparities;
+	cv::Ptr<cv::StereoMatcher> lLeftMatcher;
+
+	numberOfDisparities = gParams.NumberOfDisparities;
+	numberOfDisparities = numberOfDisparities > 0 ? numberOfDisparities : ((ImageSize.width/8) + 15) & -16;
+	gNumberOfDisparities = numberOfDisparities;
+
+	//The prior and the temporal average of other parameters do not apply, the matchers below are set to the full range
+	gPriorDisparity.release();
+	gSearchRanges.clear();
+	temporal_filter.Reset();
+
+	if(gParams.Matcher == DISPARITY_MATCHER_BM)  //STEREO_BM algorithm
+	{
+		if(bm_left.empty())
+		{
+			bm_left = cv::StereoBM::create(numberOfDisparities, gParams.BlockSize);
+		}
+
+		bm_left->setROI1(cv::Rect(0, 0, ImageSize.width, ImageSize.height)); //CHECk Width
+		bm_left->setROI2(cv::Rect(0, 0, ImageSize.width, ImageSize.height)); //CHECk Width
+		bm_left->setPreFilterCap(gParams.PreFilterCap);
+		bm_left->setPreFilterSize(gParams.PreFilterSize);
+		bm_left->setBlockSize(gParams.BlockSize);
+		bm_left->setMinDisparity(gParams.MinDisparity);
+		bm_left->setNumDisparities(numberOfDisparities);
+		bm_left->setTextureThreshold(gParams.TextureThreshold);
+		bm_left->setUniquenessRatio(gParams.UniquenessRatio);
+		bm_left->setSpeckleWindowSize(gParams.ParallelSpeckle ? 0 : gParams.SpeckleWindowSize);
+		bm_left->setSpeckleRange(gParams.SpeckleRange);
+		bm_left->setDisp12MaxDiff(gParams.Disp12MaxDiff);
+		bm_left->setPreFilterType(CV_STEREO_BM_XSOBEL);
+
+		lLeftMatcher = bm_left;
+	}
+	else if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM || gParams.Matcher == DISPARITY_MATCHER_SEMI_DENSE) //Census transform
+	{
+		census_left.SetParams(numberOfDisparities, gParams.BlockSize, gParams.Paths, gParams.UniquenessRatio, gParams.Disp12MaxDiff);
+	}
+	else if(gParams.Matcher == DISPARITY_MATCHER_PYRAMID_SGBM) //Coarse to fine STEREO_3WAY
+	{
+		//The smallest level searches the full range scaled down, the finer ones only refine it
+		int lCoarseDisparities = ((numberOfDisparities >> DISPARITY_PYRAMID_LEVELS) + 15) & -16;
+
+		if(gPyramidMatcher.empty())
+		{
+			gPyramidMatcher = cv::StereoSGBM::create(0, lCoarseDisparities, gParams.BlockSize);
+		}
+
+		gPyramidMatcher->setPreFilterCap(gParams.PreFilterCap);
+		gPyramidMatcher->setBlockSize(gParams.BlockSize);
+		gPyramidMatcher->setP1(8 * gParams.BlockSize * gParams.BlockSize);
+		gPyramidMatcher->setP2(32 * gParams.BlockSize * gParams.BlockSize);
+		gPyramidMatcher->setNumDisparities(lCoarseDisparities);
+		gPyramidMatcher->setMinDisparity(0);
+		gPyramidMatcher->setUniquenessRatio(gParams.UniquenessRatio);
+		gPyramidMatcher->setSpeckleWindowSize(0);
+		gPyramidMatcher->setDisp12MaxDiff(gParams.Disp12MaxDiff);
+		gPyramidMatcher->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);
+
+		census_refine.SetParams(numberOfDisparities, 5, 4, gParams.UniquenessRatio, gParams.Disp12MaxDiff);
+	}
+	else //STEREO_3WAY
+	{
+		if(sgbm_left.empty())
 		{
-			e_DisparityOption = 0;  // 0 - Stereo_BM
+			sgbm_left = cv::StereoSGBM::create(gParams.MinDisparity, numberOfDisparities, gParams.BlockSize);
 		}
+
+		int cn = 1;
+		sgbm_left->setPreFilterCap(gParams.PreFilterCap);
+		sgbm_left->setBlockSize(gParams.BlockSize);
+		sgbm_left->setP1(8 * cn * gParams.BlockSize * gParams.BlockSize);
+		sgbm_left->setP2(32 * cn * gParams.BlockSize * gParams.BlockSize);
+		sgbm_left->setNumDisparities(numberOfDisparities);
+		sgbm_left->setMinDisparity(gParams.MinDisparity);
+		sgbm_left->setUniquenessRatio(gParams.UniquenessRatio);
+		sgbm_left->setSpeckleWindowSize(gParams.ParallelSpeckle ? 0 : gParams.SpeckleWindowSize);
+		sgbm_left->setSpeckleRange(gParams.SpeckleRange);
+		sgbm_left->setDisp12MaxDiff(gParams.Disp12MaxDiff);
 	
-		mRange = cv::Mat(cv::Size(50, ImageSize.height), CV_8UC1);
-		for (int Row = 0; Row < ImageSize.height; Row++)
+		sgbm_left->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);		
+
+		lLeftMatcher = sgbm_left;
+
+		//One SGBM object per stripe so that each keeps its own buffers, without the speckle filter
+		gStripeMatchers.resize((gParams.Stripes > 1) ? gParams.Stripes : 0);
+		gStripeDisparity.resize(gStripeMatchers.size());
+		for(size_t Stripe = 0; Stripe < gStripeMatchers.size(); Stripe++)
 		{
-			const float scaleR = float(255.0 / (float)ImageSize.height);
-			mRange.row(Row).setTo(Row * scaleR);
+			if(gStripeMatchers[Stripe].empty())
+			{
+				gStripeMatchers[Stripe] = cv::StereoSGBM::create(gParams.MinDisparity, numberOfDisparities, gParams.BlockSize);
+			}
+
+			gStripeMatchers[Stripe]->setPreFilterCap(gParams.PreFilterCap);
+			gStripeMatchers[Stripe]->setBlockSize(gParams.BlockSize);
+			gStripeMatchers[Stripe]->setP1(sgbm_left->getP1());
+			gStripeMatchers[Stripe]->setP2(sgbm_left->getP2());
+			gStripeMatchers[Stripe]->setNumDisparities(numberOfDisparities);
+			gStripeMatchers[Stripe]->setMinDisparity(gParams.MinDisparity);
+			gStripeMatchers[Stripe]->setUniquenessRatio(gParams.UniquenessRatio);
+			gStripeMatchers[Stripe]->setSpeckleWindowSize(0);
+			gStripeMatchers[Stripe]->setDisp12MaxDiff(gParams.Disp12MaxDiff);
+			gStripeMatchers[Stripe]->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);
+		}
+	}
+
+	if(NeedsRightView(gParams)) //Gives a WLS Filtered Disparity
+	{
+		//Only a change of the disparity range or the block needs a new right matcher and filter
+		if(!gFilterCreated || !SameMatchingRange(gParams, gFilterParams))
+		{
+			if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM)
+			{
+				//No right matcher, the filter is set up as createDisparityWLSFilter does from the block size
+				wls_filter = createDisparityWLSFilterGeneric(true);
+				wls_filter->setDepthDiscontinuityRadius((int)ceil(0.33 * gParams.BlockSize));
+			}
+			else
+			{
+				wls_filter = createDisparityWLSFilter(lLeftMatcher);
+				if(gParams.Matcher == DISPARITY_MATCHER_BM)
+					bm_right = createRightMatcher(lLeftMatcher);
+				else
+					sgbm_right = createRightMatcher(lLeftMatcher);
+			}
+
+			gFilterParams = gParams;
+			gFilterCreated = true;
+		}
+
+		wls_filter->setLambda(gParams.WLSLambda);
+		wls_filter->setSigmaColor(gParams.WLSSigma);
+	}
+
+	e_ScaleImage = gParams.ScaleImage;
+
+	return TRUE;
+}
+
+//Clamps the parameters to the values the matchers accept
+void Disparity::ValidateParams(DISPARITYPARAMS_TypeDef *Params)
+{
+	if(Params->Matcher != DISPARITY_MATCHER_BM && Params->Matcher != DISPARITY_MATCHER_CENSUS_SGM &&
+		Params->Matcher != DISPARITY_MATCHER_PYRAMID_SGBM && Params->Matcher != DISPARITY_MATCHER_SEMI_DENSE)
+		Params->Matcher = DISPARITY_MATCHER_SGBM;
+
+	Params->ScaleImage = LIMIT(Params->ScaleImage, 0.20, 1);
+	Params->NumberOfDisparities = (max(Params->NumberOfDisparities, 0) + 15) & -16;
+
+	if(Params->Matcher == DISPARITY_MATCHER_BM)
+	{
+		//must be odd, within 5..255 and not larger than image width or height
+		Params->BlockSize = (Params->BlockSize > 0) ? int(LIMIT(Params->BlockSize, 5, 255)) : 9;
+		if(Params->BlockSize % 2 == 0)
+		{
+			Params->BlockSize++;
+		}
+
+		Params->PreFilterCap = int(LIMIT(Params->PreFilterCap, 1, 63)); // must be within 1 and 63
+		Params->PreFilterSize = int(LIMIT(Params->PreFilterSize, 5, 63));
+		if(Params->PreFilterSize % 2 == 0)
+		{
+			Params->PreFilterSize++;
+		}
+	}
+	else if(Params->Matcher == DISPARITY_MATCHER_CENSUS_SGM || Params->Matcher == DISPARITY_MATCHER_SEMI_DENSE)
+	{
+		//5x5 or 9x7 census, disparities from 0
+		Params->BlockSize = (Params->BlockSize <= 5) ? 5 : 9;
+		Params->MinDisparity = 0;
+		Params->NumberOfDisparities = min(Params->NumberOfDisparities, CENSUS_MAX_DISPARITIES);
+	}
+	else
+	{
+		Params->BlockSize = (Params->BlockSize > 0) ? Params->BlockSize : 3;
+		Params->PreFilterCap = max(Params->PreFilterCap, 1);
+	}
+
+	if(Params->Matcher == DISPARITY_MATCHER_PYRAMID_SGBM || Params->Matcher == DISPARITY_MATCHER_SEMI_DENSE)
+	{
+		//Left view only, the pyramid range already comes from the coarse level and the semi dense one costs little
+		Params->MinDisparity = 0;
+		Params->Filtered = Params->Filtered && Params->PostFilter != DISPARITY_FILTER_WLS;
+		Params->TemporalPrior = DISPARITY_PRIOR_OFF;
+		Params->AutoRange = false;
+	}
+
+	Params->TextureThreshold = max(Params->TextureThreshold, 0);
+	Params->UniquenessRatio = max(Params->UniquenessRatio, 0);
+	Params->SpeckleWindowSize = max(Params->SpeckleWindowSize, 0);
+	Params->SpeckleRange = max(Params->SpeckleRange, 0);
+	Params->WLSLambda = max(Params->WLSLambda, 0.0);
+	Params->WLSSigma = (Params->WLSSigma > 0.0) ? Params->WLSSigma : 1.5;
+	Params->ScaleDispMap = (Params->ScaleDispMap > 0.0) ? Params->ScaleDispMap : 1.0;
+	Params->Stripes = int(LIMIT(Params->Stripes, 0, DISPARITY_MAX_STRIPES));
+	Params->Paths = (Params->Paths <= 4) ? 4 : 8;
+	Params->TemporalPrior = int(LIMIT(Params->TemporalPrior, DISPARITY_PRIOR_OFF, DISPARITY_PRIOR_MOTION));
+	Params->PostFilter = int(LIMIT(Params->PostFilter, DISPARITY_FILTER_WLS, DISPARITY_FILTER_GUIDED));
+	Params->FilterSigmaSpatial = (Params->FilterSigmaSpatial >= 1.0) ? Params->FilterSigmaSpatial : 10.0;
+	Params->FilterSigmaColor = (Params->FilterSigmaColor > 0.0) ? Params->FilterSigmaColor : 20.0;
+	Params->LRCheck = Params->LRCheck && Params->MinDisparity >= 0;
+	Params->HoleFill = int(LIMIT(Params->HoleFill, DISPARITY_HOLE_FILL_OFF, DISPARITY_HOLE_FILL_INTERPOLATE));
+	Params->HoleFillWidth = max(Params->HoleFillWidth, 0);
+	Params->TemporalAlpha = LIMIT(Params->TemporalAlpha, 0.0, 1.0);
+	Params->TemporalPersistence = max(Params->TemporalPersistence, 0);
+	Params->Upsampling = int(LIMIT(Params->Upsampling, DISPARITY_UPSAMPLE_BILINEAR, DISPARITY_UPSAMPLE_GUIDED));
+}
+
+//Selects a preset, applied from the next GetDisparity
+BOOL Disparity::SetDisparityPreset(DisparityPreset Preset)
+{
+	DISPARITYPARAMS_TypeDef lParams;
+
+	if(!GetDisparityPresetParams(Preset, &lParams))
+		return FALSE;
+
+	return SetDisparityParams(lParams);
+}
+
+//Sets the disparity parameters, applied from the next GetDisparity
+BOOL Disparity::SetDisparityParams(const DISPARITYPARAMS_TypeDef &Params)
+{
+	DISPARITYPARAMS_TypeDef lParams = Params;
+
+	ValidateParams(&lParams);
+
+	pthread_mutex_lock(&gParamsLock);
+	gPendingParams = lParams;
+	gParamsPending = true;
+	pthread_mutex_unlock(&gParamsLock);
+
+	return TRUE;
+}
+
+//Gets the disparity parameters, including a change not applied yet
+BOOL Disparity::GetDisparityParams(DISPARITYPARAMS_TypeDef *Params)
+{
+	if(Params == NULL)
+		return FALSE;
+
+	pthread_mutex_lock(&gParamsLock);
+	*Params = gParamsPending ? gPendingParams : gParams;
+	pthread_mutex_unlock(&gParamsLock);
+
+	return TRUE;
+}
+
+//Gets the measured cost of GetDisparity with the current parameters
+BOOL Disparity::GetDisparityTiming(DISPARITYTIMING_TypeDef *Timing)
+{
+	if(Timing == NULL)
+		return FALSE;
+
+	pthread_mutex_lock(&gParamsLock);
+	*Timing = gTiming;
+	pthread_mutex_unlock(&gParamsLock);
+
+	return (Timing->Frames > 0);
+}
+
+//Applies the requested parameters between two frames, the timing restarts with them
+void Disparity::ApplyPendingParams()
+{
+	bool lPending;
+
+	pthread_mutex_lock(&gParamsLock);
+	lPending = gParamsPending;
+	if(lPending)
+	{
+		gParams = gPendingParams;
+		gParamsPending = false;
+		memset(&gTiming, 0x00, sizeof(gTiming));
+		gLastDisparityNs = 0;
+	}
+	pthread_mutex_unlock(&gParamsLock);
+
+	if(lPending)
+	{
+		SetAlgorithmParam();
+	}
+}
+
+//Accumulates the time of one GetDisparity
+void Disparity::UpdateTiming(UINT64 StartNs, UINT64 EndNs)
+{
+	double lLatencyMs = (double)(EndNs - StartNs) / 1e6;
+	double lFps;
+
+	pthread_mutex_lock(&gParamsLock);
+	if(gTiming.Frames == 0)
+		gTiming.LatencyMs = lLatencyMs;
+	else
+		gTiming.LatencyMs += DISPARITY_TIMING_EWMA * (lLatencyMs - gTiming.LatencyMs);
+	gTiming.LatencyMaxMs = max(gTiming.LatencyMaxMs, lLatencyMs);
+
+	if(gLastDisparityNs != 0 && StartNs > gLastDisparityNs)
+	{
+		lFps = 1e9 / (double)(StartNs - gLastDisparityNs);
+		gTiming.Fps = (gTiming.Fps == 0.0) ? lFps : gTiming.Fps + DISPARITY_TIMING_EWMA * (lFps - gTiming.Fps);
+	}
+	gLastDisparityNs = StartNs;
+	gTiming.SearchRatio = (gTiming.Frames == 0) ? gSearchRatio : gTiming.SearchRatio + DISPARITY_TIMING_EWMA * (gSearchRatio - gTiming.SearchRatio);
+	gTiming.Frames++;
+	pthread_mutex_unlock(&gParamsLock);
+}
+
+//Estimates the disparity of the camera
+BOOL Disparity::GetDisparity(cv::Mat LImage, cv::Mat RImage, cv::Mat *mDisparityMap, cv::Mat *FilteredDisparity)
+{
+	if(!GetDisparity(LImage, RImage))
+		return FALSE;
+
+	return ColouriseDisparity(mDisparityMap, FilteredDisparity);
+}
+
+//Estimates the disparity into gDisparityMap, in full resolution, without any visualisation
+BOOL Disparity::GetDisparity(cv::Mat LImage, cv::Mat RImage)
+{
+	cv::Mat RDisparity, disp_filtered, lFullLImage = LImage;
+	UINT64 lStartNs = GetMonotonicTimeNs();
+
+	//Parameters changed while streaming take effect here
+	ApplyPendingParams();
+	gSearchRatio = 1.0;
+	
+	if(e_ScaleImage != 1.0) //Scaling the Input to speed up the process
+	{
+		resize(LImage, LImage, cv::Size(), e_ScaleImage, e_ScaleImage, cv::INTER_AREA);
+		resize(RImage, RImage, cv::Size(), e_ScaleImage, e_ScaleImage, cv::INTER_AREA);
+	}
+	 
+	if(NeedsRightView(gParams) && gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM) //The census matcher gives both views in one pass
+	{
+		census_left.compute(LImage, RImage, gDisparityMap, &RDisparity);
+		FilterSpeckles(&gDisparityMap);
+	}
+	else if(NeedsRightView(gParams)) //WLS filtered disparity, the two matchers run concurrently
+	{
+		ComputeLeftRight((gParams.Matcher == DISPARITY_MATCHER_BM) ? bm_right : sgbm_right, LImage, RImage, &gDisparityMap, &RDisparity);
+		if(gParams.ParallelSpeckle)
+			FilterSpeckles(&gDisparityMap);
+	}
+	else
+	{
+		ComputeLeft(LImage, RImage, &gDisparityMap);
+	}
+
+	if(gParams.LRCheck && !NeedsRightView(gParams)) //Occlusions and mismatches rejected without a right matcher
+	{
+		CheckLeftRight(LImage, RImage, &gDisparityMap);
+	}
+
+	if(gParams.HoleFill != DISPARITY_HOLE_FILL_OFF) //Holes of the matcher, the speckle filter and the LR check
+	{
+		speckle_filter.FillHoles(gDisparityMap, (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE, gParams.HoleFillWidth,
+					gParams.HoleFill == DISPARITY_HOLE_FILL_INTERPOLATE);
+	}
+
+	if(gParams.Filtered && !NeedsRightView(gParams)) //Edge aware filter of the left view
+	{
+		FilterEdgeAware(LImage, &gDisparityMap);
+	}
+	else if(gParams.Filtered) //filtered
+	{
+		//The filter created from a matcher computes its ROI, the generic one of the census matcher filters the whole map
+		cv::Rect lROI;
+		if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM)
+			lROI = cv::Rect(0, 0, gDisparityMap.cols, gDisparityMap.rows);
+
+		wls_filter->filter(gDisparityMap, LImage, disp_filtered, RDisparity, lROI);
+		
+		gDisparityMap = disp_filtered.clone();
+
+	}
+
+	if(gParams.TemporalAlpha > 0.0) //Flicker of a static scene averaged out, moving pixels restart
+	{
+		temporal_filter.Filter(gDisparityMap, (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE, (float)gParams.TemporalAlpha,
+					gParams.TemporalPersistence, (float)(DISPARITY_TEMPORAL_RESET * cv::StereoMatcher::DISP_SCALE));
+	}
+
+	//The interpolation of the scaled back map blends the holes, the validity is read at the matching scale
+	gMatchDisparity = gDisparityMap;
+
+	if(e_ScaleImage != 1.0 && gParams.Upsampling != DISPARITY_UPSAMPLE_BILINEAR) //Edge aware scaling with the full resolution image
+	{
+		UpsampleDisparity(LImage, lFullLImage, gMatchDisparity, &gDisparityMap);
+	}
+	else if(e_ScaleImage  != 1.0) //Scale back the output image
+	{			
+		resize(gDisparityMap, gDisparityMap, cv::Size(ImageSize.width, ImageSize.height));
+	}
+
+	//The region tables of the previous map are stale
+	gDisparityFrames++;
+
+	UpdateTiming(lStartNs, GetMonotonicTimeNs());
+	
+	return TRUE;
+}
+
+//Looks up the colour of each grey level of a range of rows, the colour bar is copied after them
+class ColouriseBody : public cv::ParallelLoopBody
+{
+public:
+	ColouriseBody(const cv::Mat &Grey, const cv::Mat &LUT, cv::Mat &Colour) :
+		gGrey(Grey), gLUT(LUT.ptr<UINT8>()), gColour(Colour)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Rows) const
+	{
+		for(int y = Rows.start; y < Rows.end; y++)
+		{
+			const UINT8 *lGrey = gGrey.ptr<UINT8>(y);
+			UINT8 *lColour = gColour.ptr<UINT8>(y);
+
+			for(int x = 0; x < gGrey.cols; x++, lColour += 3)
+			{
+				const UINT8 *lBGR = gLUT + 3 * lGrey[x];
+				lColour[0] = lBGR[0];
+				lColour[1] = lBGR[1];
+				lColour[2] = lBGR[2];
+			}
+		}
+	}
+
+private:
+	const cv::Mat &gGrey;
+	const UINT8 *gLUT;
+	cv::Mat &gColour;
+};
+
+//Renders the last disparity map, the cost of the visualisation is paid only by the callers displaying it
+BOOL Disparity::ColouriseDisparity(cv::Mat *mDisparityMap, cv::Mat *ColourMap)
+{
+	if(mDisparityMap == NULL || gDisparityMap.empty())
+		return FALSE;
+
+	//Disparity map to view
+	getDisparityVis(gDisparityMap, *mDisparityMap, gParams.ScaleDispMap);
+
+	if(ColourMap == NULL)
+		return TRUE;
+
+	//Same colours as applyColorMap, looked up from a table instead of computed per pixel
+	if(gColourLUT.empty())
+	{
+		cv::Mat lLevels(1, 256, CV_8UC1);
+		for(int Level = 0; Level < 256; Level++)
+			lLevels.at<UINT8>(0, Level) = (UINT8)Level;
+
+		applyColorMap(lLevels, gColourLUT, cv::COLORMAP_JET);
+		applyColorMap(mRange, gColourBar, cv::COLORMAP_JET);
+	}
+
+	ColourMap->create(mDisparityMap->rows, mDisparityMap->cols + gColourBar.cols, CV_8UC3);
+	cv::parallel_for_(cv::Range(0, mDisparityMap->rows), ColouriseBody(*mDisparityMap, gColourLUT, *ColourMap));
+	gColourBar.copyTo(ColourMap->colRange(mDisparityMap->cols, ColourMap->cols));
+
+	return TRUE;
+}
+
+
+//Worker thread, computes the right disparity of each job posted by ComputeLeftRight
+void* Disparity::RightMatcherThread(void *lpParameter)
+{
+	Disparity *lDisparity = (Disparity*)lpParameter;
+	bool lFailed;
+
+	pthread_mutex_lock(&lDisparity->gWorkerLock);
+	while(1)
+	{
+		while(!lDisparity->gJobPending && !lDisparity->gWorkerExit)
+			pthread_cond_wait(&lDisparity->gJobCond, &lDisparity->gWorkerLock);
+
+		if(lDisparity->gWorkerExit)
+			break;
+
+		lDisparity->gJobPending = false;
+		pthread_mutex_unlock(&lDisparity->gWorkerLock);
+
+		//The job members are not touched by the caller until gJobDone is set
+		lFailed = false;
+		try
+		{
+			lDisparity->gJobMatcher->compute(lDisparity->gJobLeft, lDisparity->gJobRight, lDisparity->gJobDisparity);
+		}
+		catch(cv::Exception &e)
+		{
+			cout << "RightMatcherThread : " << e.what() << endl;
+			lFailed = true;
+		}
+		catch(...)
+		{
+			//Anything left uncaught here would terminate the process
+			cout << "RightMatcherThread : Unknown exception\n";
+			lFailed = true;
+		}
+
+		pthread_mutex_lock(&lDisparity->gWorkerLock);
+		lDisparity->gJobFailed = lFailed;
+		lDisparity->gJobDone = true;
+		pthread_cond_signal(&lDisparity->gDoneCond);
+	}
+	pthread_mutex_unlock(&lDisparity->gWorkerLock);
+
+	return NULL;
+}
+
+//Starts the worker on the first filtered frame
+BOOL Disparity::StartRightWorker()
+{
+	if(gWorkerRunning)
+		return TRUE;
+
+	gWorkerExit = false;
+	if(pthread_create(&gRightWorker, NULL, RightMatcherThread, (void*)this) != 0)
+	{
+		cout << "StartRightWorker : Thread creation failed, the right disparity is computed after the left one\n";
+		return FALSE;
+	}
+
+	gWorkerRunning = true;
+	return TRUE;
+}
+
+//Stops the worker
+void Disparity::StopRightWorker()
+{
+	if(!gWorkerRunning)
+		return;
+
+	pthread_mutex_lock(&gWorkerLock);
+	gWorkerExit = true;
+	pthread_cond_signal(&gJobCond);
+	pthread_mutex_unlock(&gWorkerLock);
+
+	pthread_join(gRightWorker, NULL);
+	gWorkerRunning = false;
+}
+
+//Waits for the posted job and releases its images, returns true when the worker failed
+bool Disparity::WaitRightJob()
+{
+	bool lFailed;
+
+	pthread_mutex_lock(&gWorkerLock);
+	while(!gJobDone)
+		pthread_cond_wait(&gDoneCond, &gWorkerLock);
+	lFailed = gJobFailed;
+	gJobLeft.release();
+	gJobRight.release();
+	pthread_mutex_unlock(&gWorkerLock);
+
+	return lFailed;
+}
+
+//Computes the left disparity on the caller thread and the right disparity on the worker
+void Disparity::ComputeLeftRight(cv::Ptr<cv::StereoMatcher> RightMatcher, const cv::Mat &LImage, const cv::Mat &RImage,
+				cv::Mat *LDisparity, cv::Mat *RDisparity)
+{
+	bool lFailed;
+
+	if(!StartRightWorker())
+	{
+		ComputeLeft(LImage, RImage, LDisparity);
+		RightMatcher->compute(RImage, LImage, *RDisparity);
+		return;
+	}
+
+	//The images are only read by both matchers, each matcher keeps its own buffers
+	pthread_mutex_lock(&gWorkerLock);
+	gJobMatcher = RightMatcher;
+	gJobLeft = RImage;
+	gJobRight = LImage;
+	gJobDone = false;
+	gJobPending = true;
+	pthread_cond_signal(&gJobCond);
+	pthread_mutex_unlock(&gWorkerLock);
+
+	//The worker still writes gJobDisparity when ComputeLeft throws, it is waited for before leaving
+	try
+	{
+		ComputeLeft(LImage, RImage, LDisparity);
+	}
+	catch(...)
+	{
+		WaitRightJob();
+		throw;
+	}
+
+	lFailed = WaitRightJob();
+
+	//A failure on the worker is reported on the caller thread like the sequential path
+	if(lFailed)
+	{
+		RightMatcher->compute(RImage, LImage, *RDisparity);
+		return;
+	}
+
+	*RDisparity = gJobDisparity;
+}
+
+//Computes the left disparity with the selected matcher
+void Disparity::ComputeLeft(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity)
+{
+	//The right matcher and the WLS filter keep the full range
+	bool lPrior = ((gParams.TemporalPrior != DISPARITY_PRIOR_OFF || gParams.AutoRange) && !NeedsRightView(gParams));
+
+	if(lPrior)
+	{
+		SetSearchRanges(LImage, RImage);
+	}
+
+	if(gParams.Matcher == DISPARITY_MATCHER_BM)  //STEREO_BM algorithm
+	{
+		bm_left->compute(LImage, RImage, *LDisparity);
+		if(gParams.ParallelSpeckle) //Removed after matching, the regions narrowed by the prior first get the same invalid value
+		{
+			NormalizeInvalid(LDisparity);
+			FilterSpeckles(LDisparity);
+		}
+	}
+	else if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM) //Census transform and SGM
+	{
+		census_left.compute(LImage, RImage, *LDisparity);
+		FilterSpeckles(LDisparity);
+	}
+	else if(gParams.Matcher == DISPARITY_MATCHER_PYRAMID_SGBM) //Coarse to fine STEREO_3WAY
+	{
+		ComputePyramid(LImage, RImage, LDisparity);
+	}
+	else if(gParams.Matcher == DISPARITY_MATCHER_SEMI_DENSE) //Census costs of the textured pixels only
+	{
+		ComputeSemiDense(LImage, RImage, LDisparity);
+		FilterSpeckles(LDisparity);
+	}
+	else if(gStripeMatchers.size() > 1) //STEREO_3WAY algorithm in stripes
+	{
+		ComputeSGBMStripes(LImage, RImage, LDisparity);
+	}
+	else //STEREO_3WAY algorithm
+	{
+		sgbm_left->compute(LImage, RImage, *LDisparity);
+		if(gParams.ParallelSpeckle)
+		{
+			NormalizeInvalid(LDisparity);
+			FilterSpeckles(LDisparity);
+		}
+	}
+
+	if(lPrior)
+	{
+		UpdatePrior(LImage, LDisparity);
+	}
+}
+
+//Narrows the search range of each region from the previous map or the coarse pass
+void Disparity::SetSearchRanges(const cv::Mat &LImage, const cv::Mat &RImage)
+{
+	int lFullMin = gParams.MinDisparity, lFullMax = gParams.MinDisparity + gNumberOfDisparities;
+	int lInvalid = (lFullMin - 1) * cv::StereoMatcher::DISP_SCALE;
+	int lMaxLimit = lFullMax, lFirstCol = 0;
+	size_t lRegions = (gParams.Matcher == DISPARITY_MATCHER_SGBM && gStripeMatchers.size() > 1) ? gStripeMatchers.size() : 1;
+	bool lFull = gPriorDisparity.empty() || gPriorDisparity.size() != LImage.size() || gPriorFrames >= DISPARITY_PRIOR_REFRESH;
+	cv::Mat lPrior, lImage, lValid;
+	double lMin, lMax, lSearched = 0;
+
+	if(gParams.AutoRange)
+	{
+		//The coarse pass searches beyond NumberOfDisparities so that close scenes are not clipped
+		lFirstCol = ComputeCoarse(LImage, RImage, &lPrior);
+		lMaxLimit = lFullMin + DISPARITY_AUTO_RANGE_FACTOR * gNumberOfDisparities;
+		lFull = (lFirstCol >= LImage.cols);
+	}
+	else if(!lFull && gParams.TemporalPrior == DISPARITY_PRIOR_MOTION)
+	{
+		//Shift of the scene since the previous frame, a weak response means a new scene
+		double lResponse = 0;
+		LImage.convertTo(lImage, CV_32F);
+		if(gPriorWindow.size() != LImage.size())
+			cv::createHanningWindow(gPriorWindow, LImage.size(), CV_32F);
+
+		cv::Point2d lShift = cv::phaseCorrelate(gPriorImage, lImage, gPriorWindow, &lResponse);
+		if(lResponse < DISPARITY_PRIOR_MIN_RESPONSE)
+		{
+			lFull = true;
+		}
+		else
+		{
+			cv::Mat lTranslation = (cv::Mat_<double>(2, 3) << 1, 0, lShift.x, 0, 1, lShift.y);
+			cv::warpAffine(gPriorDisparity, lPrior, lTranslation, LImage.size(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(lInvalid));
+		}
+	}
+	else if(!lFull)
+	{
+		//A large change of the image means a new scene
+		cv::Mat lPriorImage, lChange;
+		gPriorImage.convertTo(lPriorImage, CV_8U);
+		cv::absdiff(LImage, lPriorImage, lChange);
+		lFull = cv::mean(lChange).val[0] > DISPARITY_PRIOR_MAX_CHANGE;
+		lPrior = gPriorDisparity;
+	}
+
+	gPriorFrames = lFull ? 0 : gPriorFrames + 1;
+	gSearchRanges.resize(lRegions);
+
+	for(size_t Region = 0; Region < lRegions; Region++)
+	{
+		int lTop = LImage.rows * (int)Region / (int)lRegions, lBottom = LImage.rows * (int)(Region + 1) / (int)lRegions;
+		int lLow = lFullMin, lHigh = lFullMax;
+
+		if(!lFull)
+		{
+			cv::Mat lRows = lPrior(cv::Range(lTop, lBottom), cv::Range(lFirstCol, LImage.cols));
+			lValid = (lRows > lInvalid);
+
+			//Range of the valid disparities of the region with a margin for the motion in depth or the coarse sampling
+			if(cv::countNonZero(lValid) >= DISPARITY_PRIOR_MIN_VALID * lRows.total())
+			{
+				cv::minMaxLoc(lRows, &lMin, &lMax, NULL, NULL, lValid);
+				lLow = max(lFullMin, (int)floor(lMin / cv::StereoMatcher::DISP_SCALE) - DISPARITY_PRIOR_MARGIN);
+				lHigh = min(lMaxLimit, (int)ceil(lMax / cv::StereoMatcher::DISP_SCALE) + DISPARITY_PRIOR_MARGIN + 1);
+			}
+		}
+
+		//The census matcher searches from 0, the matchers take multiples of 16
+		if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM)
+			lLow = lFullMin;
+		int lNum = min((lHigh - lLow + 15) & -16, lMaxLimit - lFullMin);
+		lLow = max(lFullMin, min(lLow, lMaxLimit - lNum));
+
+		gSearchRanges[Region] = cv::Vec2i(lLow, lNum);
+		SetMatcherRange(Region, lLow, lNum);
+		lSearched += (double)lNum * (lBottom - lTop);
+	}
+
+	gSearchRatio = lSearched / ((double)gNumberOfDisparities * LImage.rows);
+}
+
+//Matches the images at DISPARITY_AUTO_SCALE over DISPARITY_AUTO_RANGE_FACTOR times the range
+int Disparity::ComputeCoarse(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *Disparity)
+{
+	int lMinDisparity = (int)floor(gParams.MinDisparity * DISPARITY_AUTO_SCALE);
+	int lNumDisparities = ((int)ceil(DISPARITY_AUTO_RANGE_FACTOR * gNumberOfDisparities * DISPARITY_AUTO_SCALE) + 15) & -16;
+
+	cv::resize(LImage, gCoarseLeft, cv::Size(), DISPARITY_AUTO_SCALE, DISPARITY_AUTO_SCALE, cv::INTER_AREA);
+	cv::resize(RImage, gCoarseRight, cv::Size(), DISPARITY_AUTO_SCALE, DISPARITY_AUTO_SCALE, cv::INTER_AREA);
+
+	if(gCoarseMatcher.empty())
+	{
+		//Small block and no speckle filter, only the range of the map is used
+		gCoarseMatcher = cv::StereoSGBM::create(lMinDisparity, lNumDisparities, 3);
+		gCoarseMatcher->setP1(8 * 3 * 3);
+		gCoarseMatcher->setP2(32 * 3 * 3);
+		gCoarseMatcher->setUniquenessRatio(10);
+		gCoarseMatcher->setDisp12MaxDiff(1);
+		gCoarseMatcher->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);
+	}
+	gCoarseMatcher->setMinDisparity(lMinDisparity);
+	gCoarseMatcher->setNumDisparities(lNumDisparities);
+	gCoarseMatcher->compute(gCoarseLeft, gCoarseRight, gCoarseDisparity);
+
+	//Disparities and size at the matching scale, the invalid value stays below the one of the full range
+	gCoarseDisparity.convertTo(gCoarseDisparity, CV_16S, 1.0 / DISPARITY_AUTO_SCALE);
+	cv::resize(gCoarseDisparity, *Disparity, LImage.size(), 0, 0, cv::INTER_NEAREST);
+
+	//The coarse matcher has no full range left of its maximum disparity
+	return (int)ceil((lMinDisparity + lNumDisparities) / DISPARITY_AUTO_SCALE);
+}
+
+//The right view is matched as a left one on the mirrored images, only DISPARITY_LR_RADIUS disparities around the left
+//map warped to it, which costs a fraction of a right matcher searching the full range
+void Disparity::CheckLeftRight(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity)
+{
+	int lInvalid = (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE;
+	int lTolerance = max(gParams.Disp12MaxDiff, 1) * cv::StereoMatcher::DISP_SCALE;
+
+	//Left map warped to the right view, the closest pixel wins where several land on the same one
+	gCheckPrior.create(LDisparity->size(), CV_16S);
+	gCheckPrior.setTo(cv::Scalar(-cv::StereoMatcher::DISP_SCALE));
+	for(int y = 0; y < LDisparity->rows; y++)
+	{
+		const INT16 *lLeft = LDisparity->ptr<INT16>(y);
+		INT16 *lPrior = gCheckPrior.ptr<INT16>(y);
+
+		for(int x = 0; x < LDisparity->cols; x++)
+		{
+			int xr = x - ((lLeft[x] + cv::StereoMatcher::DISP_SCALE / 2) >> cv::StereoMatcher::DISP_SHIFT);
+			if(lLeft[x] > lInvalid && lLeft[x] >= 0 && xr >= 0 && lLeft[x] > lPrior[xr])
+				lPrior[xr] = lLeft[x];
+		}
+	}
+
+	cv::flip(RImage, gCheckLeft, 1);
+	cv::flip(LImage, gCheckRight, 1);
+	cv::flip(gCheckPrior, gCheckPrior, 1);
+	census_refine.Refine(gCheckLeft, gCheckRight, gCheckPrior, DISPARITY_LR_RADIUS, gCheckDisparity);
+	cv::flip(gCheckDisparity, gCheckDisparity, 1);
+
+	//Occluded pixels lose the warp to a closer one, mismatched ones find another disparity
+	for(int y = 0; y < LDisparity->rows; y++)
+	{
+		INT16 *lLeft = LDisparity->ptr<INT16>(y);
+		const INT16 *lRight = gCheckDisparity.ptr<INT16>(y);
+
+		for(int x = 0; x < LDisparity->cols; x++)
+		{
+			if(lLeft[x] <= lInvalid)
+				continue;
+
+			int xr = x - ((lLeft[x] + cv::StereoMatcher::DISP_SCALE / 2) >> cv::StereoMatcher::DISP_SHIFT);
+			if(lLeft[x] < 0 || xr < 0 || lRight[xr] < 0 || abs(lRight[xr] - lLeft[x]) > lTolerance)
+				lLeft[x] = (INT16)lInvalid;
 		}
+	}
+}
 
-		//Algorithm Parameters
-		SetAlgorithmParam();
-	}	
+//Normalised convolution: the filter of the disparity weighted by its validity divided by the filter of the weights,
+//so the invalid pixels neither pull their neighbours down nor stay holes where enough neighbours are valid
+void Disparity::FilterEdgeAware(const cv::Mat &LImage, cv::Mat *LDisparity)
+{
+	int lInvalid = (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE;
+	cv::Mat lValid = (*LDisparity > lInvalid);
 
-	return TRUE;
+	lValid.convertTo(gFilterWeight, CV_32F, 1.0 / 255);
+	LDisparity->convertTo(gFilterDisparity, CV_32F);
+	cv::multiply(gFilterDisparity, gFilterWeight, gFilterDisparity);
+
+	if(gParams.PostFilter == DISPARITY_FILTER_DOMAIN_TRANSFORM)
+	{
+		//Recursive filter, the guide is transformed once for both
+		cv::Ptr<DTFilter> lFilter = createDTFilter(LImage, gParams.FilterSigmaSpatial, gParams.FilterSigmaColor, DTF_RF, 3);
+		lFilter->filter(gFilterDisparity, gSmoothDisparity);
+		lFilter->filter(gFilterWeight, gSmoothWeight);
+	}
+	else
+	{
+		cv::Ptr<GuidedFilter> lFilter = createGuidedFilter(LImage, cvRound(gParams.FilterSigmaSpatial),
+								gParams.FilterSigmaColor * gParams.FilterSigmaColor);
+		lFilter->filter(gFilterDisparity, gSmoothDisparity);
+		lFilter->filter(gFilterWeight, gSmoothWeight);
+	}
+
+	//Division by zero gives zero, those pixels are below the minimum weight
+	cv::divide(gSmoothDisparity, gSmoothWeight, gSmoothDisparity);
+	gSmoothDisparity.convertTo(*LDisparity, CV_16S);
+	LDisparity->setTo(cv::Scalar(lInvalid), gSmoothWeight < DISPARITY_FILTER_MIN_WEIGHT);
 }
 
-//Setting up the parameters of Disparity Algorithm
-BOOL Disparity::SetAlgorithmParam()
-{	
-	if(DEBUG_ENABLED)
-		cout << "SetAlgorithmParam : Setting Up the Algorithm Parameters\n";
-	int numberOfDisparities;
-	if(!e_DisparityOption)  //STEREO_BM algorithm
+//Weighted mean of the valid neighbours of the matching scale around each full resolution pixel of a range of rows.
+//The spatial weight is the product of the column and row weights of the neighbour, taken from the position of the
+//full resolution pixel between the pixels of the matching scale.
+class JointBilateralBody : public cv::ParallelLoopBody
+{
+public:
+	JointBilateralBody(const cv::Mat &Disparity, const cv::Mat &LowGuide, const cv::Mat &Guide, const std::vector<int> &Columns,
+			const std::vector<int> &Rows, const std::vector<float> &Range, const std::vector<float> &SpatialX,
+			const std::vector<float> &SpatialY, int Invalid, cv::Mat &Output) :
+		gDisparity(Disparity), gLowGuide(LowGuide), gGuide(Guide), gColumns(Columns), gRows(Rows), gRange(Range),
+		gSpatialX(SpatialX), gSpatialY(SpatialY), gInvalid(Invalid), gOutput(Output)
 	{
-		bm_preFilterSize	=	int(LIMIT(bm_preFilterSize, 5, 63));
-		bm_SADWindowSize	=	MAX(5, bm_SADWindowSize);
-		if(bm_SADWindowSize % 2 == 0)
-		{
-			bm_SADWindowSize++;
-		}
+	}
 
-		bm_preFilterCap = int(LIMIT(bm_preFilterCap, 1, 63)); // must be within 1 and 63		
+	virtual void operator()(const cv::Range &Rows) const
+	{
+		const int R = DISPARITY_UPSAMPLE_RADIUS;
 
-		if(bm_preFilterSize % 2 == 0)
+		for(int y = Rows.start; y < Rows.end; y++)
 		{
-			bm_preFilterSize++;
+			const UINT8 *lGuide = gGuide.ptr<UINT8>(y);
+			INT16 *lOut = gOutput.ptr<INT16>(y);
+			const float *lSpatialY = &gSpatialY[y * (2 * R + 1) + R];
+			int cy = gRows[y];
+
+			for(int x = 0; x < gOutput.cols; x++)
+			{
+				const float *lSpatialX = &gSpatialX[x * (2 * R + 1) + R];
+				int cx = gColumns[x], lGrey = lGuide[x];
+				float lWeight = 0, lValidWeight = 0, lSum = 0;
+
+				for(int dy = -R; dy <= R; dy++)
+				{
+					int qy = cy + dy;
+					if(qy < 0 || qy >= gDisparity.rows)
+						continue;
+
+					const INT16 *lDisp = gDisparity.ptr<INT16>(qy);
+					const UINT8 *lLow = gLowGuide.ptr<UINT8>(qy);
+					float wy = lSpatialY[dy];
+
+					for(int dx = -R; dx <= R; dx++)
+					{
+						int qx = cx + dx;
+						if(qx < 0 || qx >= gDisparity.cols)
+							continue;
+
+						float w = wy * lSpatialX[dx] * gRange[abs(lGrey - lLow[qx])];
+						lWeight += w;
+						if(lDisp[qx] > gInvalid)
+						{
+							lValidWeight += w;
+							lSum += w * lDisp[qx];
+						}
+					}
+				}
+
+				//Holes stay holes where the valid neighbours carry too little of the weight
+				lOut[x] = (INT16)((lValidWeight > 0 && lValidWeight >= DISPARITY_FILTER_MIN_WEIGHT * lWeight) ?
+							cvRound(lSum / lValidWeight) : gInvalid);
+			}
 		}
+	}
 
-		numberOfDisparities = bm_numberOfDisparities * 16;
-		numberOfDisparities = numberOfDisparities > 0 ? numberOfDisparities : ((ImageSize.width/8) + 15) & -16;
-	
-		bm_left = cv::StereoBM::create(numberOfDisparities, bm_SADWindowSize > 0 ? bm_SADWindowSize : 9);
+private:
+	const cv::Mat &gDisparity, &gLowGuide, &gGuide;
+	const std::vector<int> &gColumns, &gRows;
+	const std::vector<float> &gRange, &gSpatialX, &gSpatialY;
+	int gInvalid;
+	cv::Mat &gOutput;
+};
+
+//Maps each of the Full pixels of an axis to the nearest of the Low pixels of the matching scale, pixel centres aligned as
+//cv::resize does, and weights the 2 * DISPARITY_UPSAMPLE_RADIUS + 1 pixels around it by their distance to the exact position
+void Disparity::UpsampleAxis(int Full, int Low, std::vector<int> *Nearest, std::vector<float> *Spatial)
+{
+	const int R = DISPARITY_UPSAMPLE_RADIUS;
+	double lPos, lOffset;
 
-		if(gFilteredDisparity) //Gives a Filtered Disparity
+	Nearest->resize(Full);
+	Spatial->resize(Full * (2 * R + 1));
+	for(int i = 0; i < Full; i++)
+	{
+		lPos = (i + 0.5) * Low / Full - 0.5;
+		(*Nearest)[i] = min(max(cvRound(lPos), 0), Low - 1);
+		for(int d = -R; d <= R; d++)
 		{
-			wls_filter = createDisparityWLSFilter(bm_left);//For Filtering Disparity Map
-			bm_right   = createRightMatcher(bm_left);
+			lOffset = (*Nearest)[i] + d - lPos;
+			(*Spatial)[i * (2 * R + 1) + d + R] =
+				(float)exp(-lOffset * lOffset / (2.0 * DISPARITY_UPSAMPLE_SIGMA * DISPARITY_UPSAMPLE_SIGMA));
 		}
+	}
+}
 
-		bm_left->setROI1(cv::Rect(0, 0, ImageSize.width, ImageSize.height)); //CHECk Width
-		bm_left->setROI2(cv::Rect(0, 0, ImageSize.width, ImageSize.height)); //CHECk Width
-		bm_left->setPreFilterCap(bm_preFilterCap);
-		bm_left->setBlockSize(bm_SADWindowSize > 0 ? bm_SADWindowSize : 9);
-		bm_left->setMinDisparity(bm_minDisparity);
-		bm_left->setNumDisparities(numberOfDisparities);
-		bm_left->setTextureThreshold(bm_textureThreshold);
-		bm_left->setUniquenessRatio(bm_uniquenessRatio);
-		bm_left->setSpeckleWindowSize(bm_speckleWindowSize);
-		bm_left->setSpeckleRange(bm_speckleRange);
-		bm_left->setDisp12MaxDiff (bm_disp12MaxDiff);
-		bm_left->setPreFilterType(CV_STEREO_BM_XSOBEL);
+//Scales the map back with the full resolution left image as the guide, the disparities stay in pixels of the matching scale.
+//Disparity must not share the buffer of LDisparity.
+void Disparity::UpsampleDisparity(const cv::Mat &LImage, const cv::Mat &FullLImage, const cv::Mat &LDisparity, cv::Mat *Disparity)
+{
+	int lInvalid = (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE;
+
+	if(gParams.Upsampling == DISPARITY_UPSAMPLE_JOINT_BILATERAL)
+	{
+		//Nearest pixel of the matching scale of each column and row and the spatial weights of its neighbours,
+		//from the distance of the neighbours to the position of the pixel at the matching scale
+		UpsampleAxis(FullLImage.cols, LDisparity.cols, &gUpsampleX, &gUpsampleSpatialX);
+		UpsampleAxis(FullLImage.rows, LDisparity.rows, &gUpsampleY, &gUpsampleSpatialY);
+
+		//Weights of the grey level difference
+		gUpsampleRange.resize(256);
+		for(int i = 0; i < 256; i++)
+			gUpsampleRange[i] = (float)exp(-i * i / (2.0 * gParams.FilterSigmaColor * gParams.FilterSigmaColor));
+
+		Disparity->create(FullLImage.size(), CV_16S);
+		cv::parallel_for_(cv::Range(0, FullLImage.rows), JointBilateralBody(LDisparity, LImage, FullLImage, gUpsampleX, gUpsampleY,
+					gUpsampleRange, gUpsampleSpatialX, gUpsampleSpatialY, lInvalid, *Disparity));
 	}
-	else //STEREO_3WAY
+	else
 	{
-		numberOfDisparities = sgbm_numberOfDisparities * 16;
-		numberOfDisparities = numberOfDisparities 	> 0 ? numberOfDisparities  : ((ImageSize.width/8) + 15) & -16;
+		//Normalised convolution as FilterEdgeAware, on the bilinear upsampling of the valid disparities
+		cv::Mat lValid = (LDisparity > lInvalid);
+		int lRadius = max(cvRound(DISPARITY_UPSAMPLE_RADIUS / e_ScaleImage), 1);
+
+		lValid.convertTo(gFilterWeight, CV_32F, 1.0 / 255);
+		LDisparity.convertTo(gFilterDisparity, CV_32F);
+		cv::multiply(gFilterDisparity, gFilterWeight, gFilterDisparity);
+		cv::resize(gFilterDisparity, gUpsampleDisparity, FullLImage.size(), 0, 0, cv::INTER_LINEAR);
+		cv::resize(gFilterWeight, gUpsampleWeight, FullLImage.size(), 0, 0, cv::INTER_LINEAR);
+
+		//The buffers of the matching scale receive the filtered full resolution ones
+		cv::Ptr<GuidedFilter> lFilter = createGuidedFilter(FullLImage, lRadius, gParams.FilterSigmaColor * gParams.FilterSigmaColor);
+		lFilter->filter(gUpsampleDisparity, gFilterDisparity);
+		lFilter->filter(gUpsampleWeight, gFilterWeight);
+
+		//Division by zero gives zero, those pixels are below the minimum weight
+		cv::divide(gFilterDisparity, gFilterWeight, gFilterDisparity);
+		gFilterDisparity.convertTo(*Disparity, CV_16S);
+		Disparity->setTo(cv::Scalar(lInvalid), gFilterWeight < DISPARITY_FILTER_MIN_WEIGHT);
+	}
+}
 
-		sgbm_left = cv::StereoSGBM::create(0, numberOfDisparities, sgbm_SADWindowSize > 0 ? sgbm_SADWindowSize : 3);
-	
-		if(gFilteredDisparity) //Gives a Filtered Disparity
-		{
-			wls_filter = createDisparityWLSFilter(sgbm_left);
-			sgbm_right = createRightMatcher(sgbm_left);
-		}	
+//Matches the smallest level over the full range, each finer level searches DISPARITY_PYRAMID_RADIUS disparities around
+//the map of the level above
+void Disparity::ComputePyramid(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity)
+{
+	cv::buildPyramid(LImage, gPyramidLeft, DISPARITY_PYRAMID_LEVELS);
+	cv::buildPyramid(RImage, gPyramidRight, DISPARITY_PYRAMID_LEVELS);
 
-		int cn = 1;
-		sgbm_left->setPreFilterCap(sgbm_preFilterCap);
-		sgbm_left->setBlockSize (sgbm_SADWindowSize > 0 ? sgbm_SADWindowSize : 3);
-		sgbm_left->setP1(8 * cn * sgbm_SADWindowSize * sgbm_SADWindowSize);
-		sgbm_left->setP2(32 * cn * sgbm_SADWindowSize * sgbm_SADWindowSize);
-		sgbm_left->setNumDisparities(numberOfDisparities);
-		sgbm_left->setMinDisparity(sgbm_minDisparity);
-		sgbm_left->setUniquenessRatio(sgbm_uniquenessRatio);
-		sgbm_left->setSpeckleWindowSize(sgbm_speckleWindowSize); 
-		sgbm_left->setSpeckleRange(sgbm_speckleRange);
-		sgbm_left->setDisp12MaxDiff(sgbm_disp12MaxDiff);
-	
-		sgbm_left->setMode(cv::StereoSGBM::MODE_SGBM_3WAY);		
-	}
+	gPyramidMatcher->compute(gPyramidLeft[DISPARITY_PYRAMID_LEVELS], gPyramidRight[DISPARITY_PYRAMID_LEVELS], gPyramidDisparity);
 
-	if(gFilteredDisparity) //Gives a Filtered Disparity
+	for(int Level = DISPARITY_PYRAMID_LEVELS - 1; Level >= 0; Level--)
 	{
-		wls_filter->setLambda(e_DWSLFLambda);
-		wls_filter->setSigmaColor(e_DWSLFSigma);		
+		//The holes of the level above would grow at each level, they are refined from their background instead
+		speckle_filter.FillHoles(gPyramidDisparity, -1, 0, false);
+
+		//Twice the disparities at twice the size, the invalid pixels stay negative
+		cv::resize(gPyramidDisparity, gPyramidPrior, gPyramidLeft[Level].size(), 0, 0, cv::INTER_NEAREST);
+		gPyramidPrior *= 2;
+
+		census_refine.Refine(gPyramidLeft[Level], gPyramidRight[Level], gPyramidPrior, DISPARITY_PYRAMID_RADIUS,
+					(Level == 0) ? *LDisparity : gPyramidDisparity);
 	}
 
-	return TRUE;
+	FilterSpeckles(LDisparity);
 }
 
-//Estimates the disparity of the camera
-BOOL Disparity::GetDisparity(cv::Mat LImage, cv::Mat RImage, cv::Mat *mDisparityMap, cv::Mat *FilteredDisparity)
+//The textureless pixels cannot be matched, the cost of the census search follows the textured area of the image
+void Disparity::ComputeSemiDense(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity)
 {
-	cv::Mat LeftDisparity, RDisparity;
-	cv::Mat LScaleImage, RScaleImage;
-	cv::Mat disp_filtered, mDisp_WR, disparity_viz;
-	cv::Mat ScaledDisparityMap_viz, ScaledDisparityMap;
-	
-	//Scale value
-	e_ScaleImage = LIMIT(e_ScaleImage, 0.20, 1);
-	
-	if(e_ScaleImage != 1.0) //Scaling the Input to speed up the process
+	CensusSGM::TextureMask(LImage, gParams.TextureThreshold, gTextureMask);
+	cv::dilate(gTextureMask, gTextureMask, cv::getStructuringElement(cv::MORPH_RECT,
+			cv::Size(2 * DISPARITY_TEXTURE_HALO + 1, 2 * DISPARITY_TEXTURE_HALO + 1)));
+
+	census_left.ComputeMasked(LImage, RImage, gTextureMask, *LDisparity);
+}
+
+//Sets the range of the matcher of a region
+void Disparity::SetMatcherRange(size_t Region, int MinDisparity, int NumDisparities)
+{
+	if(gParams.Matcher == DISPARITY_MATCHER_BM)
 	{
-		resize(LImage, LImage, cv::Size(), e_ScaleImage, e_ScaleImage, cv::INTER_AREA);
-		resize(RImage, RImage, cv::Size(), e_ScaleImage, e_ScaleImage, cv::INTER_AREA);
+		bm_left->setMinDisparity(MinDisparity);
+		bm_left->setNumDisparities(NumDisparities);
 	}
-	 
-	if(!e_DisparityOption)  //STEREO_BM algorithm
+	else if(gParams.Matcher == DISPARITY_MATCHER_CENSUS_SGM)
 	{
-		bm_left->compute(LImage, RImage, gDisparityMap);
-
-		if(gFilteredDisparity) //Filtered disparity
-		{
-			bm_right->compute(RImage, LImage, RDisparity);
-		}
+		if(census_left.GetNumDisparities() != NumDisparities)
+			census_left.SetParams(NumDisparities, gParams.BlockSize, gParams.Paths, gParams.UniquenessRatio, gParams.Disp12MaxDiff);
 	}
-    else //STEREO_3WAY algorithm
+	else if(gStripeMatchers.size() > 1)
 	{
-		sgbm_left->compute(LImage, RImage, gDisparityMap);
-
-		if(gFilteredDisparity) //Filtered disparity
-		{
-			sgbm_right->compute(RImage, LImage, RDisparity);
-		}
+		gStripeMatchers[Region]->setMinDisparity(MinDisparity);
+		gStripeMatchers[Region]->setNumDisparities(NumDisparities);
+	}
+	else
+	{
+		sgbm_left->setMinDisparity(MinDisparity);
+		sgbm_left->setNumDisparities(NumDisparities);
 	}
+}
+
+//The matchers mark the invalid pixels with the minimum disparity of their range minus one
+void Disparity::NormalizeInvalid(cv::Mat *LDisparity)
+{
+	int lInvalid = (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE;
 
-	if(gFilteredDisparity) //filtered
+	for(size_t Region = 0; Region < gSearchRanges.size(); Region++)
 	{
-		wls_filter->setLambda(e_DWSLFLambda);
-		wls_filter->setSigmaColor(e_DWSLFSigma);
-		wls_filter->filter(gDisparityMap, LImage, disp_filtered, RDisparity);
-		
-		gDisparityMap = disp_filtered.clone();
+		if(gSearchRanges[Region][0] == gParams.MinDisparity)
+			continue;
 
+		cv::Mat lRows = LDisparity->rowRange(LDisparity->rows * (int)Region / (int)gSearchRanges.size(),
+							LDisparity->rows * (int)(Region + 1) / (int)gSearchRanges.size());
+		lRows.setTo(cv::Scalar(lInvalid), lRows < gSearchRanges[Region][0] * cv::StereoMatcher::DISP_SCALE);
 	}
+}
 
-	//Disparity map to view
-	getDisparityVis(gDisparityMap, *mDisparityMap, e_ScaleDispMap);
+//Keeps the map and the image of this frame for the next one
+void Disparity::UpdatePrior(const cv::Mat &LImage, cv::Mat *LDisparity)
+{
+	NormalizeInvalid(LDisparity);
 
-	if(e_ScaleImage  != 1.0) //Scale back the output image
-	{			
-		resize(gDisparityMap, gDisparityMap, cv::Size(ImageSize.width, ImageSize.height));
-		resize(*mDisparityMap, *mDisparityMap, cv::Size(ImageSize.width, ImageSize.height));
+	LDisparity->copyTo(gPriorDisparity);
+	LImage.convertTo(gPriorImage, CV_32F);
+}
+
+//Speckle filter of StereoSGBM or SpeckleFilter with ParallelSpeckle, for the matchers which do not run it themselves
+void Disparity::FilterSpeckles(cv::Mat *LDisparity)
+{
+	if(gParams.SpeckleWindowSize > 0 && gParams.ParallelSpeckle)
+	{
+		//StereoBM takes the range in 1/16 pixels, StereoSGBM in pixels
+		int lMaxDiff = (gParams.Matcher == DISPARITY_MATCHER_BM) ? gParams.SpeckleRange : cv::StereoMatcher::DISP_SCALE * gParams.SpeckleRange;
+
+		speckle_filter.Filter(*LDisparity, (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE, gParams.SpeckleWindowSize, lMaxDiff);
+	}
+	else if(gParams.SpeckleWindowSize > 0)
+	{
+		cv::filterSpeckles(*LDisparity, (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE, gParams.SpeckleWindowSize,
+				cv::StereoMatcher::DISP_SCALE * gParams.SpeckleRange, gSpeckleBuffer);
 	}
-		
-	//Color map for the Disparity image
-	hconcat(*mDisparityMap, mRange, mDisp_WR);
-	applyColorMap(mDisp_WR, *FilteredDisparity, cv::COLORMAP_JET);
-	
-	return TRUE;
 }
 
+//Matches one horizontal stripe per call with its own SGBM object and copies the stripe without its overlap
+class SGBMStripeBody : public cv::ParallelLoopBody
+{
+public:
+	SGBMStripeBody(std::vector<cv::Ptr<cv::StereoSGBM> > &Matchers, std::vector<cv::Mat> &Buffers,
+			const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat &Disparity, int Overlap) :
+		gMatchers(Matchers), gBuffers(Buffers), gLImage(LImage), gRImage(RImage), gDisparity(Disparity), gOverlap(Overlap)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Stripes) const
+	{
+		int lCount = (int)gMatchers.size();
+
+		for(int Stripe = Stripes.start; Stripe < Stripes.end; Stripe++)
+		{
+			int y0 = gLImage.rows * Stripe / lCount;
+			int y1 = gLImage.rows * (Stripe + 1) / lCount;
+			int lTop = max(0, y0 - gOverlap);
+			int lBottom = min(gLImage.rows, y1 + gOverlap);
+
+			gMatchers[Stripe]->compute(gLImage.rowRange(lTop, lBottom), gRImage.rowRange(lTop, lBottom), gBuffers[Stripe]);
+			gBuffers[Stripe].rowRange(y0 - lTop, y1 - lTop).copyTo(gDisparity.rowRange(y0, y1));
+		}
+	}
+
+private:
+	std::vector<cv::Ptr<cv::StereoSGBM> > &gMatchers;
+	std::vector<cv::Mat> &gBuffers;
+	const cv::Mat &gLImage, &gRImage;
+	cv::Mat &gDisparity;
+	int gOverlap;
+};
+
+//Matches the stripes in parallel and stitches them
+void Disparity::ComputeSGBMStripes(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity)
+{
+	//The SGBM paths run over the whole image, cutting them after the overlap is an approximation near the seams
+	int lOverlap = gParams.BlockSize / 2 + DISPARITY_STRIPE_OVERLAP;
+
+	LDisparity->create(LImage.size(), CV_16S);
+	cv::parallel_for_(cv::Range(0, (int)gStripeMatchers.size()),
+			SGBMStripeBody(gStripeMatchers, gStripeDisparity, LImage, RImage, *LDisparity, lOverlap),
+			(double)gStripeMatchers.size());
+
+	//Same speckle filter as StereoSGBM, on the whole map so that speckles across a seam are measured in full,
+	//after the stripes matched with a narrowed range are given the same invalid value
+	NormalizeInvalid(LDisparity);
+	FilterSpeckles(LDisparity);
+}
 
 //Estimates the Depth of the point passed.
 BOOL Disparity::EstimateDepth(cv::Point Pt, float *DepthValue)
@@ -584,8 +1744,14 @@ BOOL Disparity::EstimateDepth(cv::Point Pt, float *DepthValue)
 	//Converting to 32 bit 
 	disp_leftCrop.convertTo(disp_32, CV_32FC1, 1.0 / 16); //CHANGES MADE HERE
 
-	//Computing the mean of the selected point
-	cv::Scalar MeanDisp = mean(disp_32);
+	//Computing the mean of the selected point, the holes are not measurements
+	cv::Mat lValid = (disp_32 > 0);
+	if(cv::countNonZero(lValid) == 0)
+	{
+		*DepthValue = -1;
+		return FALSE;
+	}
+	cv::Scalar MeanDisp = mean(disp_32, lValid);
 
 	//Converting to 32 bit 
 	DepthMap.convertTo(Q_32, CV_32FC1);
@@ -609,6 +1775,363 @@ BOOL Disparity::EstimateDepth(cv::Point Pt, float *DepthValue)
 	return TRUE;
 }
 
+//Confidence from what produced the map, at the matching scale, then scaled back with the validity
+BOOL Disparity::GetConfidenceMap(cv::Mat *Confidence, cv::Mat *ValidMask)
+{
+	if(gMatchDisparity.empty())
+		return FALSE;
+
+	int lInvalid = (gParams.MinDisparity - 1) * cv::StereoMatcher::DISP_SCALE;
+	cv::Mat lValid = (gMatchDisparity > lInvalid), lValidFull;
+
+	//Nearest so that no pixel next to a hole is marked valid, the edge aware upsampling keeps the holes in full resolution
+	if(gParams.Upsampling != DISPARITY_UPSAMPLE_BILINEAR && gDisparityMap.size() == ImageSize)
+		lValidFull = (gDisparityMap > lInvalid);
+	else
+		cv::resize(lValid, lValidFull, ImageSize, 0, 0, cv::INTER_NEAREST);
+	if(ValidMask)
+		lValidFull.copyTo(*ValidMask);
+
+	if(Confidence == NULL)
+		return TRUE;
+
+	cv::Mat lConfidence;
+	if(NeedsRightView(gParams))
+	{
+		//Left right consistency and disparity edges measured by the WLS filter, 0 to 255
+		wls_filter->getConfidenceMap().convertTo(lConfidence, CV_32F, 1.0 / 255);
+	}
+	else if(gParams.Filtered && gSmoothWeight.size() == gMatchDisparity.size())
+	{
+		//Share of valid neighbours, along the edges of the image
+		lConfidence = cv::max(gSmoothWeight, 0.0);
+		lConfidence = cv::min(lConfidence, 1.0);
+	}
+	else
+	{
+		//Valid pixels whose valid neighbours agree, 1 / (1 + variance / sigma^2) over the window
+		cv::Mat lWeight, lDisparity, lSquare, lCount, lMean, lMeanSquare;
+		cv::Size lWindow(DISPARITY_CONFIDENCE_WINDOW, DISPARITY_CONFIDENCE_WINDOW);
+
+		lValid.convertTo(lWeight, CV_32F, 1.0 / 255);
+		gMatchDisparity.convertTo(lDisparity, CV_32F, 1.0 / cv::StereoMatcher::DISP_SCALE);
+		cv::multiply(lDisparity, lWeight, lDisparity);
+		cv::multiply(lDisparity, lDisparity, lSquare);
+
+		cv::boxFilter(lWeight, lCount, CV_32F, lWindow, cv::Point(-1, -1), false);
+		cv::boxFilter(lDisparity, lMean, CV_32F, lWindow, cv::Point(-1, -1), false);
+		cv::boxFilter(lSquare, lMeanSquare, CV_32F, lWindow, cv::Point(-1, -1), false);
+		cv::divide(lMean, lCount, lMean);
+		cv::divide(lMeanSquare, lCount, lMeanSquare);
+
+		cv::Mat lVariance = lMeanSquare - lMean.mul(lMean);
+		lVariance = cv::max(lVariance, 0.0) / (DISPARITY_CONFIDENCE_SIGMA * DISPARITY_CONFIDENCE_SIGMA) + 1.0;
+		cv::divide(lWeight, lVariance, lConfidence);
+	}
+
+	cv::resize(lConfidence, *Confidence, ImageSize, 0, 0, cv::INTER_LINEAR);
+	Confidence->setTo(cv::Scalar(0), lValidFull == 0);
+
+	return TRUE;
+}
+
+//Depth of a full resolution disparity, as EstimateDepth computes it, 0 when it has no depth
+static double DisparityToDepth(const cv::Mat_<double> &Q, double FullDisparity)
+{
+	double lW = Q(3, 2) * FullDisparity + Q(3, 3);
+	double lDepth = (FullDisparity > 0 && lW != 0) ? (Q(2, 2) * FullDisparity + Q(2, 3)) / lW : 0;
+
+	return max(lDepth, 0.0);
+}
+
+//Looks up the depth of each disparity of a range of rows
+template <typename T>
+class DepthLUTBody : public cv::ParallelLoopBody
+{
+public:
+	DepthLUTBody(const cv::Mat &Disparity, const cv::Mat &LUT, cv::Mat &Depth) :
+		gDisparity(Disparity), gLUT(LUT.ptr<T>()), gDepth(Depth)
+	{
+	}
+
+	virtual void operator()(const cv::Range &Rows) const
+	{
+		for(int y = Rows.start; y < Rows.end; y++)
+		{
+			const UINT16 *lDisparity = gDisparity.ptr<UINT16>(y);
+			T *lDepth = gDepth.ptr<T>(y);
+
+			for(int x = 0; x < gDisparity.cols; x++)
+				lDepth[x] = gLUT[lDisparity[x]];
+		}
+	}
+
+private:
+	const cv::Mat &gDisparity;
+	const T *gLUT;
+	cv::Mat &gDepth;
+};
+
+//Q is constant, so the depth is a function of the 16 bit disparity only, tabulated once for all its values
+void Disparity::UpdateDepthLUT(int Type)
+{
+	if(gDepthLUT.type() == Type && gDepthLUTScale == e_ScaleImage && gDepthLUTQ.size() == DepthMap.size() &&
+		gDepthLUTQ.type() == DepthMap.type() && cv::norm(gDepthLUTQ, DepthMap, cv::NORM_INF) == 0)
+		return;
+
+	cv::Mat_<double> Q;
+	DepthMap.convertTo(Q, CV_64F);
+
+	gDepthLUT.create(1, 65536, Type);
+	for(int Index = 0; Index < 65536; Index++)
+	{
+		//Full resolution pixels, as EstimateDepth which scales the depth instead
+		double lDepth = DisparityToDepth(Q, (INT16)(UINT16)Index / (cv::StereoMatcher::DISP_SCALE * e_ScaleImage));
+
+		if(Type == CV_16U)
+			gDepthLUT.at<UINT16>(0, Index) = cv::saturate_cast<UINT16>(lDepth);
+		else
+			gDepthLUT.at<float>(0, Index) = (float)(lDepth / 1000.0);
+	}
+
+	DepthMap.copyTo(gDepthLUTQ);
+	gDepthLUTScale = e_ScaleImage;
+}
+
+//Depth of every pixel, one table lookup per pixel
+BOOL Disparity::GetDepthMap(cv::Mat *Depth, int Type)
+{
+	if(Depth == NULL || gDisparityMap.empty() || DepthMap.empty() || (Type != CV_16U && Type != CV_32F))
+		return FALSE;
+
+	UpdateDepthLUT(Type);
+
+	Depth->create(gDisparityMap.size(), Type);
+	if(Type == CV_16U)
+		cv::parallel_for_(cv::Range(0, gDisparityMap.rows), DepthLUTBody<UINT16>(gDisparityMap, gDepthLUT, *Depth));
+	else
+		cv::parallel_for_(cv::Range(0, gDisparityMap.rows), DepthLUTBody<float>(gDisparityMap, gDepthLUT, *Depth));
+
+	return TRUE;
+}
+
+//Integral images for the mean and the valid ratio, and the largest disparity of the squares of side 2^k, each level
+//from two shifted maxima of the level below
+void Disparity::BuildRegionTables()
+{
+	cv::Mat lValidDisparity, lRows;
+
+	gRegionValid = (gDisparityMap > 0);
+	gDisparityMap.copyTo(lValidDisparity);
+	lValidDisparity.setTo(cv::Scalar(0), ~gRegionValid);
+
+	cv::integral(lValidDisparity, gRegionSum, CV_64F);
+	cv::integral(gRegionValid / 255, gRegionCount, CV_32S);
+
+	gRegionMax.resize(1);
+	gRegionMax[0] = gDisparityMap;
+	for(int Level = 1; Level < REGION_DEPTH_LEVELS; Level++)
+	{
+		const cv::Mat &lBelow = gRegionMax[Level - 1];
+		int lHalf = 1 << (Level - 1);
+
+		if(lBelow.cols <= lHalf || lBelow.rows <= lHalf)
+			break;
+
+		cv::Mat lLevel;
+		cv::max(lBelow.colRange(0, lBelow.cols - lHalf), lBelow.colRange(lHalf, lBelow.cols), lRows);
+		cv::max(lRows.rowRange(0, lRows.rows - lHalf), lRows.rowRange(lHalf, lRows.rows), lLevel);
+		gRegionMax.push_back(lLevel);
+	}
+
+	gRegionFrame = gDisparityFrames;
+}
+
+//Mean and valid ratio from four lookups each, the largest disparity from the squares of the largest level not
+//larger than the region which cover it, overlapping at its right and bottom sides. The squares are not combined
+//across levels, a region of w x h walks ceil(w/side)*ceil(h/side) of them.
+BOOL Disparity::GetRegionDepth(const std::vector<cv::Rect> &Regions, std::vector<REGIONDEPTH_TypeDef> *Results)
+{
+	if(Results == NULL || gDisparityMap.empty() || DepthMap.empty())
+		return FALSE;
+
+	if(gRegionMax.empty() || gRegionFrame != gDisparityFrames || gRegionValid.size() != gDisparityMap.size())
+		BuildRegionTables();
+
+	double lScale = cv::StereoMatcher::DISP_SCALE * e_ScaleImage;
+	cv::Rect lImage(0, 0, gDisparityMap.cols, gDisparityMap.rows);
+	cv::Mat_<double> Q;
+	DepthMap.convertTo(Q, CV_64F);
+
+	Results->resize(Regions.size());
+	for(size_t Index = 0; Index < Regions.size(); Index++)
+	{
+		REGIONDEPTH_TypeDef &Result = (*Results)[Index];
+		cv::Rect lRegion = Regions[Index] & lImage;
+
+		Result.Region = lRegion;
+		Result.Disparity = -1;
+		Result.Depth = -1;
+		Result.MinDepth = -1;
+		Result.ValidRatio = 0;
+
+		if(lRegion.area() <= 0)
+			continue;
+
+		int x0 = lRegion.x, y0 = lRegion.y, x1 = lRegion.x + lRegion.width, y1 = lRegion.y + lRegion.height;
+		int lCount = gRegionCount.at<int>(y1, x1) - gRegionCount.at<int>(y0, x1) - gRegionCount.at<int>(y1, x0) + gRegionCount.at<int>(y0, x0);
+
+		Result.ValidRatio = (float)lCount / lRegion.area();
+		if(lCount == 0)
+			continue;
+
+		double lSum = gRegionSum.at<double>(y1, x1) - gRegionSum.at<double>(y0, x1) - gRegionSum.at<double>(y1, x0) + gRegionSum.at<double>(y0, x0);
+		Result.Disparity = (float)(lSum / lCount / lScale);
+		Result.Depth = (float)DisparityToDepth(Q, Result.Disparity);
+
+		int lLevel = 0;
+		while(lLevel + 1 < (int)gRegionMax.size() && (2 << lLevel) <= min(lRegion.width, lRegion.height))
+			lLevel++;
+
+		int lSide = 1 << lLevel, lMax = 0;
+		const cv::Mat &lTable = gRegionMax[lLevel];
+		for(int y = y0; ; y = min(y + lSide, y1 - lSide))
+		{
+			const INT16 *lRow = lTable.ptr<INT16>(y);
+			for(int x = x0; ; x = min(x + lSide, x1 - lSide))
+			{
+				lMax = max(lMax, (int)lRow[x]);
+				if(x == x1 - lSide)
+					break;
+			}
+			if(y == y1 - lSide)
+				break;
+		}
+
+		Result.MinDepth = (float)DisparityToDepth(Q, lMax / lScale);
+	}
+
+	return TRUE;
+}
+
+//Matches only the regions passed along their epipolar line
+BOOL Disparity::GetSparseDepth(const cv::Mat &LImage, const cv::Mat &RImage, const std::vector<cv::Rect> &Regions,
+				std::vector<SPARSEDEPTH_TypeDef> *Results)
+{
+	DISPARITYPARAMS_TypeDef lParams;
+	cv::Mat_<float> vec(4, 1);
+	cv::Mat Q_32, lScores;
+	cv::Scalar lMean, lStdDev;
+	int lNumDisparities, lMinDisparity, lMaxDisparity;
+
+	if(Results == NULL || LImage.empty() || LImage.type() != CV_8UC1 || RImage.type() != CV_8UC1 || LImage.size() != RImage.size())
+		return FALSE;
+
+	//Disparity range of the dense matchers, in full resolution pixels
+	GetDisparityParams(&lParams);
+	lNumDisparities = (lParams.NumberOfDisparities > 0) ? lParams.NumberOfDisparities : ((ImageSize.width / 8) + 15) & -16;
+	lMinDisparity = (int)floor(lParams.MinDisparity / lParams.ScaleImage);
+	lMaxDisparity = (int)ceil((lParams.MinDisparity + lNumDisparities) / lParams.ScaleImage);
+
+	DepthMap.convertTo(Q_32, CV_32FC1);
+
+	Results->resize(Regions.size());
+	for(size_t Region = 0; Region < Regions.size(); Region++)
+	{
+		SPARSEDEPTH_TypeDef &Result = (*Results)[Region];
+
+		Result.Region = Regions[Region] & cv::Rect(0, 0, LImage.cols, LImage.rows);
+		Result.Disparity = -1;
+		Result.Depth = -1;
+		Result.Confidence = 0;
+
+		if(Result.Region.area() == 0)
+			continue;
+
+		//The region shifted by the disparity has to stay within the right image
+		int lMax = min(lMaxDisparity, Result.Region.x);
+		int lMin = max(lMinDisparity, Result.Region.x + Result.Region.width - LImage.cols);
+		if(lMax - lMin < 2)
+			continue;
+
+		//Flat regions have no correlation peak
+		cv::Mat lPatch = LImage(Result.Region);
+		cv::meanStdDev(lPatch, lMean, lStdDev);
+		if(lStdDev.val[0] < SPARSE_DEPTH_MIN_STDDEV)
+			continue;
+
+		//Normalised correlation is not affected by a gain or offset between the sensors,
+		//the score of the disparity d is at the column lMax - d
+		cv::Rect lStrip(Result.Region.x - lMax, Result.Region.y, Result.Region.width + lMax - lMin, Result.Region.height);
+		cv::matchTemplate(RImage(lStrip), lPatch, lScores, cv::TM_CCOEFF_NORMED);
+
+		const float *lScore = lScores.ptr<float>(0);
+		int lCount = lScores.cols, lBest = 0;
+		for(int Col = 1; Col < lCount; Col++)
+		{
+			if(lScore[Col] > lScore[lBest])
+				lBest = Col;
+		}
+
+		//The confidence is the margin of the peak over the best score outside its lobe
+		int lLeft = lBest, lRight = lBest;
+		while(lLeft > 0 && lScore[lLeft - 1] < lScore[lLeft])
+			lLeft--;
+		while(lRight < lCount - 1 && lScore[lRight + 1] < lScore[lRight])
+			lRight++;
+
+		float lSecond = min(lScore[lLeft], lScore[lRight]);
+		for(int Col = 0; Col < lCount; Col++)
+		{
+			if(Col < lLeft || Col > lRight)
+				lSecond = max(lSecond, lScore[Col]);
+		}
+
+		//Parabolic subpixel refinement
+		float lOffset = 0;
+		if(lBest > 0 && lBest < lCount - 1)
+		{
+			float lDenom = lScore[lBest - 1] + lScore[lBest + 1] - 2 * lScore[lBest];
+			if(lDenom < 0)
+				lOffset = 0.5f * (lScore[lBest - 1] - lScore[lBest + 1]) / lDenom;
+		}
+
+		Result.Disparity = lMax - (lBest + lOffset);
+		Result.Confidence = (lScore[lBest] > 0) ? float(LIMIT(lScore[lBest] - lSecond, 0, 1)) : 0;
+
+		// Discard points with 0 disparity
+		if(Result.Disparity > 0)
+		{
+			vec(0) = 0;
+			vec(1) = 0;
+			vec(2) = Result.Disparity;
+			vec(3) = 1.0;
+			vec = Q_32 * vec;
+			vec /= vec(3);
+
+			//Full resolution disparity, no scaling
+			Result.Depth = vec(2);
+		}
+	}
+
+	return TRUE;
+}
+
+//Same as above on square regions centred on the points
+BOOL Disparity::GetSparseDepth(const cv::Mat &LImage, const cv::Mat &RImage, const std::vector<cv::Point> &Points,
+				std::vector<SPARSEDEPTH_TypeDef> *Results)
+{
+	std::vector<cv::Rect> lRegions(Points.size());
+
+	for(size_t Pt = 0; Pt < Points.size(); Pt++)
+	{
+		lRegions[Pt] = cv::Rect(Points[Pt].x - SPARSE_DEPTH_PATCH / 2, Points[Pt].y - SPARSE_DEPTH_PATCH / 2,
+					SPARSE_DEPTH_PATCH, SPARSE_DEPTH_PATCH);
+	}
+
+	return GetSparseDepth(LImage, RImage, lRegions, Results);
+}
+
 //Range Selection
 double Disparity::LIMIT(double n, double lower, double upper) 
 {
@@ -719,6 +2242,18 @@ BOOL Disparity::GetStreamMode(UINT32 *StreamMode)
 	return TRUE;
 }
 
+//Gets the latency and error counters of a HID command
+BOOL Disparity::GetHIDStatistics(HIDCommand Command, HIDSTATS_TypeDef *Stats)
+{
+	return ::GetHIDStatistics(Command, Stats);
+}
+
+//Clears the HID command counters
+BOOL Disparity::ResetHIDStatistics()
+{
+	return ::ResetHIDStatistics();
+}
+
 //Constructor
 CameraEnumeration::CameraEnumeration(int *DeviceID, cv::Size *SelectedResolution)
 {
@@ -1040,4 +2575,48 @@ int xioctl(int fd, int IOCTL_X, void *arg)
 	return (ret);
 }
 
+//Parameters of the disparity presets, in the order of DisparityPreset
+static const DISPARITYPARAMS_TypeDef DisparityPresets[DISPARITY_PRESET_COUNT] =
+{
+	//Matcher		Scale	Filtered Lambda	Sigma	VisScale NumDisp MinDisp Block PreCap PreSize Texture Unique SpeckleWin SpeckleRange Disp12 Stripes Paths Prior AutoRange PostFilter SigmaSpatial SigmaColor LRCheck ParallelSpeckle HoleFill HoleFillWidth TemporalAlpha TemporalPersistence Upsampling
+	{ DISPARITY_MATCHER_BM,	0.60,	false,	8000.0,	1.5,	5.0,	64,	0,	21,	25,	9,	5,	1,	350,	31,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR },
+	{ DISPARITY_MATCHER_SGBM, 0.60,	false,	8000.0,	1.5,	5.0,	64,	0,	8,	61,	9,	0,	0,	200,	31,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR },
+	{ DISPARITY_MATCHER_SGBM, 1.00,	true,	8000.0,	1.5,	3.0,	112,	0,	7,	61,	9,	0,	5,	200,	32,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR },
+	{ DISPARITY_MATCHER_CENSUS_SGM, 0.60, false, 8000.0, 1.5,	5.0,	64,	0,	5,	61,	9,	0,	5,	200,	2,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR },
+	{ DISPARITY_MATCHER_PYRAMID_SGBM, 1.00, false, 8000.0, 1.5,	3.0,	112,	0,	3,	61,	9,	0,	5,	200,	2,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR },
+	{ DISPARITY_MATCHER_SEMI_DENSE, 0.60, false, 8000.0, 1.5,	5.0,	64,	0,	9,	61,	9,	10,	10,	20,	2,	1,	0,	8,	0,	false,	DISPARITY_FILTER_WLS,	10.0,	20.0,	false,	false,	DISPARITY_HOLE_FILL_OFF,	0,	0.0,	0,	DISPARITY_UPSAMPLE_BILINEAR }
+};
+
+//Returns the parameters of a preset
+BOOL GetDisparityPresetParams(DisparityPreset Preset, DISPARITYPARAMS_TypeDef *Params)
+{
+	if(Params == NULL || Preset < 0 || Preset >= DISPARITY_PRESET_COUNT)
+		return FALSE;
+
+	*Params = DisparityPresets[Preset];
+	return TRUE;
+}
+
+//Name of a preset
+const char* DisparityPresetStr(DisparityPreset Preset)
+{
+	switch(Preset)
+	{
+		case DISPARITY_PRESET_FAST_BM:
+			return "Fast BM";
+		case DISPARITY_PRESET_BALANCED_SGBM:
+			return "Balanced SGBM";
+		case DISPARITY_PRESET_QUALITY_SGBM_WLS:
+			return "Quality SGBM + WLS";
+		case DISPARITY_PRESET_CENSUS_SGM:
+			return "Census SGM";
+		case DISPARITY_PRESET_PYRAMID_SGBM:
+			return "Pyramid SGBM";
+		case DISPARITY_PRESET_SEMI_DENSE:
+			return "Semi dense census";
+		default:
+			return "Unknown";
+	}
+}
+
 }
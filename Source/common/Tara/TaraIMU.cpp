@@ -0,0 +1,757 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+/**********************************************************************
+	TaraIMU.cpp : Defines the IMU processing classes of the shared library.
+	OrientationFilter: Madgwick gradient descent filter estimating the
+				attitude of the camera from the gyro and the
+				accelerometer, using the timestamps of the samples.
+	IMUPreintegrator: Preintegrates the IMU samples on the rotation
+				manifold (Forster et al.) with covariance and bias
+				Jacobians, for stereo-inertial odometry.
+	IMUDecimator: Windowed sinc low pass and decimation of the six
+				axes at once, with SSE2 when available.
+**********************************************************************/
+#include "Tara.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define IMU_DEG2RAD			(3.14159265358979323846f / 180.0f)
+#define IMU_RAD2DEG			(180.0 / 3.14159265358979323846)
+#define IMU_DEG2RAD_D			(3.14159265358979323846 / 180.0)
+
+namespace Tara
+{
+//Constructor
+OrientationFilter::OrientationFilter(float Beta)
+{
+	gBeta = Beta;
+	gRunning = false;
+	gAbort = false;
+	gConsumer = 0;
+	gSequence = 0;
+	gUpdateNs = 0;
+	gUpdateSamples = 0;
+	memset(&gPublished, 0x00, sizeof(gPublished));
+	gPublished.Q[0] = 1.0f;
+
+	Reset();
+}
+
+//Destructor
+OrientationFilter::~OrientationFilter()
+{
+	Stop();
+}
+
+//Restarts the estimation from the next sample
+void OrientationFilter::Reset()
+{
+	q0 = 1.0f;
+	q1 = q2 = q3 = 0.0f;
+	gLastTimestampNs = 0;
+	gSampleCount = 0;
+	gResetPending = true;
+}
+
+//Sets the gain of the accelerometer correction
+void OrientationFilter::SetBeta(float Beta)
+{
+	gBeta = Beta;
+}
+
+//Initial attitude from the gravity direction, yaw is not observable and starts at 0
+void OrientationFilter::InitFromAccel(float ax, float ay, float az)
+{
+	float lRoll = atan2f(ay, az);
+	float lPitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+	float cr = cosf(lRoll * 0.5f), sr = sinf(lRoll * 0.5f);
+	float cp = cosf(lPitch * 0.5f), sp = sinf(lPitch * 0.5f);
+
+	q0 = cr * cp;
+	q1 = sr * cp;
+	q2 = cr * sp;
+	q3 = -sr * sp;
+}
+
+//One step of the filter, gyro in rad/s, accelerometer in any unit
+void OrientationFilter::Step(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+	float recipNorm;
+	float s0, s1, s2, s3;
+	float qDot1, qDot2, qDot3, qDot4;
+	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+	//Rate of change of the quaternion from the gyro
+	qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+	qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+	qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+	qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+	//Gradient descent correction towards the measured gravity, skipped in free fall
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)))
+	{
+		recipNorm = 1.0f / sqrtf(ax * ax + ay * ay + az * az);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;
+
+		_2q0 = 2.0f * q0;
+		_2q1 = 2.0f * q1;
+		_2q2 = 2.0f * q2;
+		_2q3 = 2.0f * q3;
+		_4q0 = 4.0f * q0;
+		_4q1 = 4.0f * q1;
+		_4q2 = 4.0f * q2;
+		_8q1 = 8.0f * q1;
+		_8q2 = 8.0f * q2;
+		q0q0 = q0 * q0;
+		q1q1 = q1 * q1;
+		q2q2 = q2 * q2;
+		q3q3 = q3 * q3;
+
+		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+		recipNorm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+		if(recipNorm > 0.0f)
+		{
+			recipNorm = 1.0f / sqrtf(recipNorm);
+			qDot1 -= gBeta * s0 * recipNorm;
+			qDot2 -= gBeta * s1 * recipNorm;
+			qDot3 -= gBeta * s2 * recipNorm;
+			qDot4 -= gBeta * s3 * recipNorm;
+		}
+	}
+
+	q0 += qDot1 * dt;
+	q1 += qDot2 * dt;
+	q2 += qDot3 * dt;
+	q3 += qDot4 * dt;
+
+	recipNorm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
+}
+
+//Publishes the current attitude, readers retry while the sequence is odd or has changed
+void OrientationFilter::Publish()
+{
+	__atomic_store_n(&gSequence, gSequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	gPublished.Q[0] = q0;
+	gPublished.Q[1] = q1;
+	gPublished.Q[2] = q2;
+	gPublished.Q[3] = q3;
+	gPublished.TimestampNs = gLastTimestampNs;
+	gPublished.SampleCount = gSampleCount;
+
+	__atomic_store_n(&gSequence, gSequence + 1, __ATOMIC_RELEASE);
+}
+
+//Applies raw samples in time order
+void OrientationFilter::Update(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues)
+{
+	IMUAXESFLOAT_TypeDef lAxes = { gAccX, gAccY, gAccZ, gGyroX, gGyroY, gGyroZ, NULL };
+	UINT64 lStartNs = GetMonotonicTimeNs();
+	UINT32 lChunk, index;
+	float dt;
+
+	if(Samples == NULL || NumValues == 0)
+		return;
+
+	for(UINT32 lOffset = 0; lOffset < NumValues; lOffset += lChunk)
+	{
+		lChunk = NumValues - lOffset;
+		if(lChunk > ORIENTATION_BATCH_VALUES)
+			lChunk = ORIENTATION_BATCH_VALUES;
+
+		//Scales the whole chunk at once with the vectorised converter
+		ConvertIMURawToFloat(Samples + lOffset, lChunk, &lAxes);
+
+		for(index = 0; index < lChunk; index++)
+		{
+			UINT64 lTimestampNs = Samples[lOffset + index].TimestampNs;
+
+			if(gResetPending)
+			{
+				InitFromAccel(gAccX[index], gAccY[index], gAccZ[index]);
+				gResetPending = false;
+			}
+			else if(lTimestampNs > gLastTimestampNs && (lTimestampNs - gLastTimestampNs) < ORIENTATION_MAX_INTERVAL_NS)
+			{
+				dt = (float)(lTimestampNs - gLastTimestampNs) * 1e-9f;
+				Step(gGyroX[index] * IMU_DEG2RAD, gGyroY[index] * IMU_DEG2RAD, gGyroZ[index] * IMU_DEG2RAD,
+					gAccX[index], gAccY[index], gAccZ[index], dt);
+			}
+
+			gLastTimestampNs = lTimestampNs;
+			gSampleCount++;
+		}
+	}
+
+	//Published once per call, the readers do not need every sample
+	Publish();
+
+	gUpdateNs += GetMonotonicTimeNs() - lStartNs;
+	gUpdateSamples += NumValues;
+}
+
+//Filter thread, feeds the filter from its own IMU ring
+void* OrientationFilter::FilterThread(void *lpParameter)
+{
+	OrientationFilter *lFilter = (OrientationFilter*)lpParameter;
+	UINT32 lNumValues = 0;
+
+	while(!lFilter->gAbort && PopIMURawBatchFrom(lFilter->gConsumer, lFilter->gBatch, ORIENTATION_BATCH_VALUES, ORIENTATION_BATCH_TIMEOUT, &lNumValues))
+	{
+		lFilter->Update(lFilter->gBatch, lNumValues);
+	}
+	return NULL;
+}
+
+//Starts the filter thread on a subscription of its own, so that the other readers of the IMU keep all their samples
+BOOL OrientationFilter::Start()
+{
+	if(gRunning)
+		return FALSE;
+
+	if(!SubscribeIMU(&gConsumer))
+	{
+		printf("OrientationFilter::Start : IMU subscription failed\n");
+		return FALSE;
+	}
+
+	gAbort = false;
+	if(pthread_create(&gThread, NULL, FilterThread, (void*)this) != 0)
+	{
+		printf("OrientationFilter::Start : Thread creation failed\n");
+		UnsubscribeIMU(gConsumer);
+		return FALSE;
+	}
+
+	gRunning = true;
+	return TRUE;
+}
+
+//Stops the filter thread, ending the subscription wakes it at once
+BOOL OrientationFilter::Stop()
+{
+	if(!gRunning)
+		return TRUE;
+
+	gAbort = true;
+	UnsubscribeIMU(gConsumer);
+	pthread_join(gThread, NULL);
+	gRunning = false;
+
+	return TRUE;
+}
+
+//Reads the latest attitude, can be called from any thread
+BOOL OrientationFilter::GetOrientation(ORIENTATION_TypeDef *Orientation)
+{
+	UINT32 lSequence;
+
+	if(Orientation == NULL)
+		return FALSE;
+
+	do
+	{
+		while((lSequence = __atomic_load_n(&gSequence, __ATOMIC_ACQUIRE)) & 1)
+			;
+		memcpy(Orientation, (const void*)&gPublished, sizeof(ORIENTATION_TypeDef));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&gSequence, __ATOMIC_RELAXED) != lSequence);
+
+	return (Orientation->SampleCount > 0);
+}
+
+//Reads the latest attitude as roll, pitch and yaw in degrees
+BOOL OrientationFilter::GetEulerAngles(double *Roll, double *Pitch, double *Yaw)
+{
+	ORIENTATION_TypeDef lOrientation;
+	double w, x, y, z, lSinPitch;
+
+	if(!GetOrientation(&lOrientation))
+		return FALSE;
+
+	w = lOrientation.Q[0];
+	x = lOrientation.Q[1];
+	y = lOrientation.Q[2];
+	z = lOrientation.Q[3];
+
+	lSinPitch = 2.0 * (w * y - z * x);
+	lSinPitch = (lSinPitch > 1.0) ? 1.0 : ((lSinPitch < -1.0) ? -1.0 : lSinPitch);
+
+	*Roll = atan2(2.0 * (w * x + y * z), 1.0 - 2.0 * (x * x + y * y)) * IMU_RAD2DEG;
+	*Pitch = asin(lSinPitch) * IMU_RAD2DEG;
+	*Yaw = atan2(2.0 * (w * z + x * y), 1.0 - 2.0 * (y * y + z * z)) * IMU_RAD2DEG;
+
+	return TRUE;
+}
+
+//Mean processing time of one sample in nano seconds
+double OrientationFilter::GetAverageUpdateNs()
+{
+	return (gUpdateSamples > 0) ? (double)gUpdateNs / (double)gUpdateSamples : 0.0;
+}
+
+//Skew symmetric matrix of a vector
+static inline cv::Matx33d Skew(const cv::Vec3d &v)
+{
+	return cv::Matx33d(   0.0, -v[2],  v[1],
+			   v[2],   0.0, -v[0],
+			  -v[1],  v[0],   0.0);
+}
+
+//Exponential map of SO(3) and its right Jacobian
+static void ExpSO3(const cv::Vec3d &Phi, cv::Matx33d *R, cv::Matx33d *Jr)
+{
+	double lTheta2 = Phi.dot(Phi);
+	double lTheta = sqrt(lTheta2);
+	cv::Matx33d K = Skew(Phi);
+	cv::Matx33d K2 = K * K;
+
+	if(lTheta < 1e-5)
+	{
+		//Second order expansions near the identity
+		*R = cv::Matx33d::eye() + K + 0.5 * K2;
+		*Jr = cv::Matx33d::eye() - 0.5 * K + (1.0 / 6.0) * K2;
+		return;
+	}
+
+	*R = cv::Matx33d::eye() + (sin(lTheta) / lTheta) * K + ((1.0 - cos(lTheta)) / lTheta2) * K2;
+	*Jr = cv::Matx33d::eye() - ((1.0 - cos(lTheta)) / lTheta2) * K + ((lTheta - sin(lTheta)) / (lTheta2 * lTheta)) * K2;
+}
+
+//Copies a 3x3 block into a 9x9 matrix
+static inline void SetBlock(cv::Matx<double, 9, 9> &M, int Row, int Col, const cv::Matx33d &B)
+{
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++)
+			M(Row + r, Col + c) = B(r, c);
+}
+
+//Constructor
+IMUPreintegrator::IMUPreintegrator()
+{
+	//Noise densities of the LSM6DS3 datasheet
+	SetNoise(4.0e-3 * IMU_DEG2RAD_D, 90.0e-6 * IMU_GRAVITY);
+	SetBias(cv::Vec3d(0, 0, 0), cv::Vec3d(0, 0, 0));
+	Reset();
+}
+
+//Sets the continuous time noise densities
+void IMUPreintegrator::SetNoise(double GyroNoiseDensity, double AccNoiseDensity)
+{
+	gGyroNoiseVar = GyroNoiseDensity * GyroNoiseDensity;
+	gAccNoiseVar = AccNoiseDensity * AccNoiseDensity;
+}
+
+//Sets the biases used while integrating
+void IMUPreintegrator::SetBias(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias)
+{
+	BiasGyro = GyroBias;
+	BiasAcc = AccBias;
+}
+
+//Clears the preintegrated values
+void IMUPreintegrator::Reset()
+{
+	DeltaR = cv::Matx33d::eye();
+	DeltaV = cv::Vec3d(0, 0, 0);
+	DeltaP = cv::Vec3d(0, 0, 0);
+	DeltaT = 0;
+	Covariance = cv::Matx<double, 9, 9>::zeros();
+	JRg = JVg = JVa = JPg = JPa = cv::Matx33d::zeros();
+}
+
+//Integrates one measurement held for dt seconds
+void IMUPreintegrator::IntegrateMeasurement(const cv::Vec3d &Gyro, const cv::Vec3d &Acc, double dt)
+{
+	cv::Matx33d dRi, Jr;
+	cv::Vec3d w = Gyro - BiasGyro;
+	cv::Vec3d a = Acc - BiasAcc;
+	double dt2 = dt * dt;
+
+	if(dt <= 0)
+		return;
+
+	ExpSO3(w * dt, &dRi, &Jr);
+
+	cv::Matx33d lRa = DeltaR * Skew(a);
+	cv::Vec3d lAcc = DeltaR * a;
+
+	//Error propagation of [rotation, velocity, position], A = I except for the blocks below
+	cv::Matx<double, 9, 9> A = cv::Matx<double, 9, 9>::eye();
+	SetBlock(A, 0, 0, dRi.t());
+	SetBlock(A, 3, 0, -dt * lRa);
+	SetBlock(A, 6, 0, -0.5 * dt2 * lRa);
+	SetBlock(A, 6, 3, dt * cv::Matx33d::eye());
+
+	cv::Matx33d Bg = dt * Jr;
+	cv::Matx33d Bv = dt * DeltaR;
+	cv::Matx33d Bp = 0.5 * dt2 * DeltaR;
+	double lGyroVar = gGyroNoiseVar / dt, lAccVar = gAccNoiseVar / dt;
+
+	Covariance = A * Covariance * A.t();
+
+	//Noise terms, the gyro only drives the rotation block and the accelerometer the velocity and position blocks
+	cv::Matx33d Qg = lGyroVar * (Bg * Bg.t());
+	cv::Matx33d Qvv = lAccVar * (Bv * Bv.t());
+	cv::Matx33d Qvp = lAccVar * (Bv * Bp.t());
+	cv::Matx33d Qpp = lAccVar * (Bp * Bp.t());
+	for(int r = 0; r < 3; r++)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			Covariance(r, c) += Qg(r, c);
+			Covariance(3 + r, 3 + c) += Qvv(r, c);
+			Covariance(3 + r, 6 + c) += Qvp(r, c);
+			Covariance(6 + r, 3 + c) += Qvp(c, r);
+			Covariance(6 + r, 6 + c) += Qpp(r, c);
+		}
+	}
+
+	//Bias Jacobians, position first as it uses the previous velocity terms
+	JPa = JPa + dt * JVa - 0.5 * dt2 * DeltaR;
+	JPg = JPg + dt * JVg - 0.5 * dt2 * lRa * JRg;
+	JVa = JVa - dt * DeltaR;
+	JVg = JVg - dt * lRa * JRg;
+	JRg = dRi.t() * JRg - dt * Jr;
+
+	//Preintegrated values
+	DeltaP += dt * DeltaV + 0.5 * dt2 * lAcc;
+	DeltaV += dt * lAcc;
+	DeltaR = DeltaR * dRi;
+	DeltaT += dt;
+}
+
+//Integrates the raw samples between two frame timestamps
+BOOL IMUPreintegrator::IntegrateInterval(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues, UINT64 StartNs, UINT64 EndNs)
+{
+	IMUAXESDOUBLE_TypeDef lAxes = { gAccX, gAccY, gAccZ, gGyroX, gGyroY, gGyroZ, NULL };
+	const double lAccScale = IMU_GRAVITY * 1e-3;
+	UINT64 lFrom, lTo;
+	UINT32 lChunk, index;
+	BOOL lIntegrated = FALSE;
+
+	if(Samples == NULL || NumValues == 0 || EndNs <= StartNs)
+		return FALSE;
+
+	for(UINT32 lOffset = 0; lOffset < NumValues; lOffset += lChunk)
+	{
+		lChunk = NumValues - lOffset;
+		if(lChunk > PREINTEGRATION_BATCH_VALUES)
+			lChunk = PREINTEGRATION_BATCH_VALUES;
+
+		ConvertIMURawToDouble(Samples + lOffset, lChunk, &lAxes);
+
+		for(index = 0; index < lChunk; index++)
+		{
+			UINT32 lSample = lOffset + index;
+
+			//Sample held from its timestamp (or StartNs for the first one) to the next sample (or EndNs for the last one)
+			lFrom = (lSample == 0) ? StartNs : std::max(Samples[lSample].TimestampNs, StartNs);
+			lTo = (lSample + 1 == NumValues) ? EndNs : std::min(Samples[lSample + 1].TimestampNs, EndNs);
+			if(lTo <= lFrom)
+				continue;
+
+			IntegrateMeasurement(cv::Vec3d(gGyroX[index], gGyroY[index], gGyroZ[index]) * IMU_DEG2RAD_D,
+						cv::Vec3d(gAccX[index], gAccY[index], gAccZ[index]) * lAccScale,
+						(lTo - lFrom) * 1e-9);
+			lIntegrated = TRUE;
+		}
+	}
+
+	return lIntegrated;
+}
+
+//Preintegrated rotation corrected to GyroBias
+cv::Matx33d IMUPreintegrator::GetDeltaRotation(const cv::Vec3d &GyroBias) const
+{
+	cv::Matx33d dR, Jr;
+
+	ExpSO3(JRg * (GyroBias - BiasGyro), &dR, &Jr);
+	return DeltaR * dR;
+}
+
+//Preintegrated velocity corrected to the biases
+cv::Vec3d IMUPreintegrator::GetDeltaVelocity(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias) const
+{
+	return DeltaV + JVg * (GyroBias - BiasGyro) + JVa * (AccBias - BiasAcc);
+}
+
+//Preintegrated position corrected to the biases
+cv::Vec3d IMUPreintegrator::GetDeltaPosition(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias) const
+{
+	return DeltaP + JPg * (GyroBias - BiasGyro) + JPa * (AccBias - BiasAcc);
+}
+
+//Predicts the state at the end of the interval from the state at its start
+void IMUPreintegrator::Predict(const cv::Matx33d &Ri, const cv::Vec3d &Vi, const cv::Vec3d &Pi, const cv::Vec3d &Gravity,
+				cv::Matx33d *Rj, cv::Vec3d *Vj, cv::Vec3d *Pj) const
+{
+	*Rj = Ri * DeltaR;
+	*Vj = Vi + Gravity * DeltaT + Ri * DeltaV;
+	*Pj = Pi + Vi * DeltaT + 0.5 * DeltaT * DeltaT * Gravity + Ri * DeltaP;
+}
+
+//Constructor
+IMUDecimator::IMUDecimator(UINT32 Factor, UINT32 Taps)
+{
+	gFactor = 1;
+	gTaps = 1;
+	gCoeffs[0] = 1.0f;
+	gValueId = 0;
+	gConsumer = 0;
+	gAttached = false;
+
+	if(!Configure(Factor, Taps))
+		Reset();
+}
+
+//Destructor
+IMUDecimator::~IMUDecimator()
+{
+	Detach();
+}
+
+//Subscribes to the IMU samples, Pop reads them from a ring of its own
+BOOL IMUDecimator::Attach()
+{
+	if(gAttached)
+		return TRUE;
+
+	if(!SubscribeIMU(&gConsumer))
+	{
+		printf("IMUDecimator::Attach : IMU subscription failed\n");
+		return FALSE;
+	}
+
+	gAttached = true;
+	return TRUE;
+}
+
+//Ends the subscription taken by Attach
+BOOL IMUDecimator::Detach()
+{
+	if(!gAttached)
+		return TRUE;
+
+	gAttached = false;
+	return UnsubscribeIMU(gConsumer);
+}
+
+//Designs the low pass FIR for the decimation factor
+BOOL IMUDecimator::Configure(UINT32 Factor, UINT32 Taps)
+{
+	double lCutoff, lSum = 0.0, lWindow, x;
+	double lCoeffs[DECIMATOR_MAX_TAPS];
+	UINT32 index;
+
+	if(Factor == 0 || Factor > DECIMATOR_BATCH_VALUES)
+		return FALSE;
+
+	if(Taps == 0)
+		Taps = (Factor == 1) ? 1 : DECIMATOR_TAPS_PER_FACTOR * Factor + 1;
+	if(Taps > DECIMATOR_MAX_TAPS)
+		Taps = DECIMATOR_MAX_TAPS;
+	Taps |= 1;
+
+	//Hamming windowed sinc normalised to a unit gain at DC, cutoff in cycles per input sample
+	lCutoff = DECIMATOR_CUTOFF * 0.5 / Factor;
+	for(index = 0; index < Taps; index++)
+	{
+		x = (double)index - (double)(Taps - 1) / 2.0;
+		lWindow = (Taps == 1) ? 1.0 : 0.54 - 0.46 * cos(2.0 * M_PI * index / (Taps - 1));
+		lCoeffs[index] = ((x == 0.0) ? 2.0 * lCutoff : sin(2.0 * M_PI * lCutoff * x) / (M_PI * x)) * lWindow;
+		lSum += lCoeffs[index];
+	}
+	for(index = 0; index < Taps; index++)
+		gCoeffs[index] = (float)(lCoeffs[index] / lSum);
+
+	gFactor = Factor;
+	gTaps = Taps;
+	Reset();
+
+	return TRUE;
+}
+
+//Selects the factor from the measured ODR
+BOOL IMUDecimator::ConfigureRate(double OutputHz, UINT32 Taps)
+{
+	IMUTIMING_TypeDef lTiming;
+	UINT32 lFactor;
+
+	if(OutputHz <= 0.0 || !GetIMUTimingStats(&lTiming) || lTiming.OdrHz <= 0.0)
+		return FALSE;
+
+	lFactor = (UINT32)(lTiming.OdrHz / OutputHz);
+	return Configure((lFactor < 1) ? 1 : lFactor, Taps);
+}
+
+//Clears the filter history
+void IMUDecimator::Reset()
+{
+	memset(gHistory, 0x00, sizeof(gHistory));
+	memset(gTimestamps, 0x00, sizeof(gTimestamps));
+	gPos = 0;
+	gPhase = 0;
+	gPrimed = false;
+}
+
+//Appends one scaled sample to the history
+void IMUDecimator::Push(const float *Axes, UINT64 TimestampNs)
+{
+	UINT32 index;
+
+	//The first sample fills the history so that the output starts without a transient
+	if(!gPrimed)
+	{
+		for(index = 0; index < 2 * gTaps; index++)
+			memcpy(gHistory[index], Axes, sizeof(gHistory[0]));
+		for(index = 0; index < gTaps; index++)
+			gTimestamps[index] = TimestampNs;
+		gPrimed = true;
+	}
+
+	memcpy(gHistory[gPos], Axes, sizeof(gHistory[0]));
+	memcpy(gHistory[gPos + gTaps], Axes, sizeof(gHistory[0]));
+	gTimestamps[gPos] = TimestampNs;
+
+	gPos++;
+	if(gPos == gTaps)
+		gPos = 0;
+}
+
+//Filter output over the current history, the oldest sample is at gPos
+void IMUDecimator::Filter(IMUDATAOUTPUT_TypeDef *Output)
+{
+	const float *lRow = gHistory[gPos];
+	float lSum[DECIMATOR_LANES];
+	UINT32 index;
+
+#if defined(__SSE2__)
+	__m128 lSumLo = _mm_setzero_ps(), lSumHi = _mm_setzero_ps(), lCoeff;
+
+	for(index = 0; index < gTaps; index++, lRow += DECIMATOR_LANES)
+	{
+		lCoeff = _mm_set1_ps(gCoeffs[index]);
+		lSumLo = _mm_add_ps(lSumLo, _mm_mul_ps(_mm_loadu_ps(lRow), lCoeff));
+		lSumHi = _mm_add_ps(lSumHi, _mm_mul_ps(_mm_loadu_ps(lRow + 4), lCoeff));
+	}
+	_mm_storeu_ps(lSum, lSumLo);
+	_mm_storeu_ps(lSum + 4, lSumHi);
+#else
+	UINT32 lane;
+
+	memset(lSum, 0x00, sizeof(lSum));
+	for(index = 0; index < gTaps; index++, lRow += DECIMATOR_LANES)
+	{
+		for(lane = 0; lane < 6; lane++)
+			lSum[lane] += gCoeffs[index] * lRow[lane];
+	}
+#endif
+
+	//IMU_VALUE_ID rolls over from 1 to IMU_AXES_VALUES_MAX like the library values
+	gValueId = (gValueId % IMU_AXES_VALUES_MAX) + 1;
+	Output->IMU_VALUE_ID = gValueId;
+	Output->accX = lSum[0];
+	Output->accY = lSum[1];
+	Output->accZ = lSum[2];
+	Output->gyroX = lSum[3];
+	Output->gyroY = lSum[4];
+	Output->gyroZ = lSum[5];
+
+	//Linear phase FIR, the output belongs to the centre sample of the window
+	Output->TimestampNs = gTimestamps[(gPos + (gTaps - 1) / 2) % gTaps];
+}
+
+//Filters the raw samples, writes one value per Factor samples
+UINT32 IMUDecimator::Process(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues, IMUDATAOUTPUT_TypeDef *Output, UINT32 MaxOutput)
+{
+	IMUAXESFLOAT_TypeDef lAxes = { gAccX, gAccY, gAccZ, gGyroX, gGyroY, gGyroZ, NULL };
+	float lSample[DECIMATOR_LANES] = { 0 };
+	UINT32 lChunk, lOutput = 0, index;
+
+	if(Samples == NULL || (Output == NULL && MaxOutput > 0))
+		return 0;
+
+	for(UINT32 lOffset = 0; lOffset < NumValues; lOffset += lChunk)
+	{
+		lChunk = NumValues - lOffset;
+		if(lChunk > DECIMATOR_BATCH_VALUES)
+			lChunk = DECIMATOR_BATCH_VALUES;
+
+		ConvertIMURawToFloat(Samples + lOffset, lChunk, &lAxes);
+
+		for(index = 0; index < lChunk; index++)
+		{
+			lSample[0] = gAccX[index];
+			lSample[1] = gAccY[index];
+			lSample[2] = gAccZ[index];
+			lSample[3] = gGyroX[index];
+			lSample[4] = gGyroY[index];
+			lSample[5] = gGyroZ[index];
+			Push(lSample, Samples[lOffset + index].TimestampNs);
+
+			//Only the kept outputs are computed, values beyond MaxOutput are dropped
+			if(++gPhase < gFactor)
+				continue;
+			gPhase = 0;
+			if(lOutput < MaxOutput)
+				Filter(&Output[lOutput++]);
+		}
+	}
+
+	return lOutput;
+}
+
+//Same as PopIMUValueBatch at the reduced rate, from the subscription of the decimator
+BOOL IMUDecimator::Pop(IMUDATAOUTPUT_TypeDef *Output, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues)
+{
+	UINT32 lNeeded, lPopped = 0;
+	BOOL lRet;
+
+	if(Output == NULL || NumValues == NULL || MaxValues == 0)
+		return FALSE;
+
+	*NumValues = 0;
+	if(!Attach())
+		return FALSE;
+
+	//Raw samples completing exactly MaxValues outputs, the consumer wakes once per batch
+	if(MaxValues > DECIMATOR_BATCH_VALUES / gFactor)
+		MaxValues = DECIMATOR_BATCH_VALUES / gFactor;
+	lNeeded = MaxValues * gFactor - gPhase;
+
+	lRet = PopIMURawBatchFrom(gConsumer, gBatch, lNeeded, TimeoutMs, &lPopped);
+	if(lPopped > 0)
+		*NumValues = Process(gBatch, lPopped, Output, MaxValues);
+
+	return lRet;
+}
+
+}
+
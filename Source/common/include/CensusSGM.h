@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+/**********************************************************************
+	CensusSGM.h : 	Declares the census transform and semi global
+				matching stereo matcher of the shared library.
+**********************************************************************/
+#ifndef _CENSUS_SGM_H
+#define _CENSUS_SGM_H
+
+#include <vector>
+
+//Extension unit header
+#include "xunit_lib_tara.h"
+
+//OpenCV headers
+#include "opencv2/core.hpp"
+
+#define CENSUS_MAX_DISPARITIES		256	// Multiple of 16
+#define CENSUS_DISP_SHIFT		4	// Disparities in 1/16 pixel like cv::StereoSGBM
+#define CENSUS_DISP_SCALE		(1 << CENSUS_DISP_SHIFT)
+#define CENSUS_REFINE_WINDOW		5	// Side of the box aggregating the costs of Refine and ComputeMasked
+
+namespace Tara
+{
+
+class CensusSGM
+{
+public:
+
+	//Constructor
+	CensusSGM();
+
+	//Window 5 selects the 5x5 census and 9 the 9x7 census, Paths 4 or 8, NumDisparities a multiple of 16
+	void SetParams(int NumDisparities, int Window, int Paths, int UniquenessRatio, int Disp12MaxDiff);
+
+	//Penalties of a disparity change of one and of more than one, in Hamming distance units
+	void SetPenalties(int P1, int P2);
+
+	//Disparity of the left view in 1/16 pixels (CV_16S) like cv::StereoSGBM with a minimum disparity of 0,
+	//the right view disparity is in the convention of the ximgproc right matcher for the WLS filter
+	void compute(const cv::Mat &Left, const cv::Mat &Right, cv::Mat &LeftDisparity, cv::Mat *RightDisparity = NULL);
+
+	//Same as above on 8 bit buffers, strides in elements, RightDisparity may be NULL
+	void Compute(const UINT8 *Left, int LeftStride, const UINT8 *Right, int RightStride, int Width, int Height,
+			INT16 *LeftDisparity, INT16 *RightDisparity, int DispStride);
+
+	//Searches Radius disparities on both sides of a prior of the same size (CV_16S, 1/16 pixels) with the census
+	//costs aggregated over CENSUS_REFINE_WINDOW, pixels with an invalid prior or no clear minimum are invalid (-16)
+	void Refine(const cv::Mat &Left, const cv::Mat &Right, const cv::Mat &Prior, int Radius, cv::Mat &Disparity);
+
+	//Sets the pixels of Mask (CV_8U) whose horizontal gradient, the difference of both neighbours, reaches Threshold
+	static void TextureMask(const cv::Mat &Image, int Threshold, cv::Mat &Mask);
+
+	//Searches the full range for the pixels set in Mask only, with the census costs aggregated over CENSUS_REFINE_WINDOW
+	//and computed within that window of them, so the cost follows the masked area. The other pixels are invalid (-16).
+	void ComputeMasked(const cv::Mat &Left, const cv::Mat &Right, const cv::Mat &Mask, cv::Mat &LeftDisparity);
+
+	//Current parameters
+	int GetNumDisparities() const { return gNumDisparities; }
+	int GetWindow() const { return gWindow; }
+
+private:
+
+	int gNumDisparities, gWindow, gPaths, gUniquenessRatio, gDisp12MaxDiff;
+	int gP1, gP2;
+
+	//Buffers kept between frames, only grown
+	std::vector<UINT8> gPadded;			//Image with replicated borders for the census window
+	std::vector<UINT64> gCensusLeft, gCensusRight;	//Census of each pixel
+	std::vector<UINT64> gReversed;			//Right census of one row in reverse order
+	std::vector<UINT8> gCost;			//Hamming distance per pixel and disparity
+	std::vector<UINT16> gSum;			//Aggregated cost of all the paths
+	std::vector<UINT8> gPath;			//Path costs of the previous and current rows
+	std::vector<UINT8> gPathMin;			//Minimum of each path cost
+	std::vector<int> gRightCost, gRightDisp;	//Best left match of each right pixel
+	std::vector<cv::Mat> gRefineCost;		//Cost of each offset from the prior, before and after the box
+	std::vector<cv::Mat> gRefineSum;
+	cv::Mat gSupport;				//Pixels within the window of a pixel of the mask of ComputeMasked
+	std::vector<UINT16> gMaskedSum;			//Aggregated cost of one masked pixel
+
+	//Census of one image
+	void Census(const UINT8 *Image, int Width, int Height, int Stride, UINT64 *Census);
+
+	//Reverses the right census of one row into gReversed
+	void ReverseRow(const UINT64 *Right, int Width);
+
+	//Hamming distances of one left pixel to the reversed right row
+	void PixelCost(UINT64 Left, int x, int Width, UINT8 *Out);
+
+	//Hamming distances of one row
+	void RowCost(const UINT64 *Left, const UINT64 *Right, int Width, UINT8 *Cost);
+
+	//Aggregation along the paths, Forward runs top to bottom and left to right,
+	//the backward pass completes the sums and selects the disparities row by row
+	void Aggregate(int Width, int Height, bool Forward, INT16 *LeftDisparity, INT16 *RightDisparity, int DispStride);
+
+	//Winner takes all, uniqueness, subpixel and left right check of one row
+	void SelectRow(const UINT16 *Sum, int Width, INT16 *LeftDisparity, INT16 *RightDisparity);
+};
+
+}
+
+#endif
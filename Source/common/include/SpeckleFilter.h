@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+/**********************************************************************
+	SpeckleFilter.h : Declares the post processing of the disparity
+				map of the shared library: speckle removal in
+				parallel tiles, scanline hole filling and the
+				temporal filter of a static camera.
+**********************************************************************/
+#ifndef _SPECKLE_FILTER_H
+#define _SPECKLE_FILTER_H
+
+#include <vector>
+
+//Extension unit header
+#include "xunit_lib_tara.h"
+
+//OpenCV headers
+#include "opencv2/core.hpp"
+
+#define SPECKLE_MIN_TILE_ROWS		16	// Fewer tiles on small maps, the seams are merged serially
+
+namespace Tara
+{
+
+class SpeckleFilter
+{
+public:
+
+	//Constructor
+	SpeckleFilter();
+
+	//Same result as cv::filterSpeckles on a CV_16S map: the regions of 4 connected pixels differing by at most MaxDiff
+	//with at most MaxSpeckleSize pixels are set to NewVal, the pixels equal to NewVal are invalid.
+	//The rows are labelled in one tile per thread and the labels are merged across the tile seams.
+	void Filter(cv::Mat &Disparity, int NewVal, int MaxSpeckleSize, int MaxDiff);
+
+	//Fills the runs of invalid pixels (not above Invalid) of each row of at most MaxWidth pixels, or all of them with 0,
+	//with the smaller disparity of both ends, the background of an occlusion, or interpolated between them.
+	//The runs at the ends of a row take the disparity of their only end, the rows without a valid pixel stay invalid.
+	void FillHoles(cv::Mat &Disparity, int Invalid, int MaxWidth, bool Interpolate);
+
+private:
+
+	//Union find of the pixels, only grown, the parent and the size of the region of each root
+	std::vector<int> gParent, gSize;
+};
+
+class TemporalFilter
+{
+public:
+
+	//Constructor
+	TemporalFilter();
+
+	//Exponential average of the valid disparities of a CV_16S map with the previous frames, Alpha the weight of the new frame.
+	//A pixel whose disparity changes by more than ResetDiff (1/16 pixels) restarts from the new disparity, a pixel which turns
+	//invalid (not above Invalid) keeps its average for Persistence frames. The map is overwritten with the filtered disparity.
+	void Filter(cv::Mat &Disparity, int Invalid, float Alpha, int Persistence, float ResetDiff);
+
+	//Forgets the previous frames, the next map is taken as it is
+	void Reset();
+
+private:
+
+	cv::Mat gAverage;	//Filtered disparity in 1/16 pixels, CV_32F
+	cv::Mat gAge;		//Frames since the last valid disparity of each pixel, CV_32S, Persistence + 1 without an average
+	int gPersistence;
+};
+
+}
+
+#endif
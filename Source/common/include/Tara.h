@@ -34,16 +34,28 @@
 
 #include <iostream>
 #include <limits>
+#include <deque>
+#include <algorithm>
 
 //Extension unit header
 #include "xunit_lib_tara.h"
 
+//IMU processing classes
+#include "TaraIMU.h"
+
+//Census transform and semi global matching
+#include "CensusSGM.h"
+
+//Speckle removal and hole filling of the disparity map
+#include "SpeckleFilter.h"
+
 //OpenCV headers
 #include "opencv2/highgui.hpp"
 #include "opencv2/videoio.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/objdetect.hpp"
 #include "opencv2/ximgproc/disparity_filter.hpp"
+#include "opencv2/ximgproc/edge_filter.hpp"
 
 #define SDK_VERSION			"2.0.6"
 #define FRAMERATE 			60
@@ -55,6 +67,31 @@
 #define AUTOEXPOSURE 			1 
 #define DISPARITY_OPTION 		1 // 1 - Best Quality Depth Map and Lower Frame Rate
 					  // 0 - Low  Quality Depth Map and High  Frame Rate
+#define DISPARITY_TIMING_EWMA		(1.0/16.0) // Smoothing of the disparity timing
+#define DISPARITY_STRIPE_OVERLAP	16 // Rows matched beyond each SGBM stripe on top of the half block, shorter than the SGM paths so the seams are not bit exact
+#define DISPARITY_MAX_STRIPES		32
+#define DISPARITY_PRIOR_MARGIN		8 // Disparities searched beyond the range of the previous map, at the matching scale
+#define DISPARITY_PRIOR_MIN_VALID	0.5 // Share of valid pixels a region of the previous map needs to narrow the search
+#define DISPARITY_PRIOR_MAX_CHANGE	12.0 // Mean grey level change between frames treated as a new scene
+#define DISPARITY_PRIOR_MIN_RESPONSE	0.1 // Phase correlation response below which the motion is not trusted
+#define DISPARITY_PRIOR_REFRESH		30 // Frames between two full searches, finds objects entering the range
+#define DISPARITY_AUTO_SCALE		0.25 // Scale of the coarse pass of the auto range, from the matching scale
+#define DISPARITY_AUTO_RANGE_FACTOR	2 // The coarse pass searches this many times NumberOfDisparities
+#define DISPARITY_PYRAMID_LEVELS	2 // Halvings of the images before the full range pass of the pyramid matcher
+#define DISPARITY_PYRAMID_RADIUS	2 // Disparities searched on both sides of the upsampled map at each finer level
+#define DISPARITY_FILTER_MIN_WEIGHT	0.1 // Share of valid neighbours the edge aware filters need to give a pixel a disparity
+#define DISPARITY_LR_RADIUS		2 // Disparities searched by the right pass of the LR check on both sides of the warped left map
+#define DISPARITY_CONFIDENCE_SIGMA	1.0 // Local disparity deviation, in pixels, which halves the confidence without a filter
+#define DISPARITY_CONFIDENCE_WINDOW	5 // Side of the window of that deviation
+#define DISPARITY_TEXTURE_HALO		2 // Pixels matched around the textured ones by the semi dense matcher
+#define DISPARITY_UPSAMPLE_RADIUS	1 // Neighbours of the matching scale on each side weighted by the edge aware upsampling
+#define DISPARITY_UPSAMPLE_SIGMA	1.0 // Spatial sigma of the joint bilateral upsampling, in pixels of the matching scale
+#define DISPARITY_TEMPORAL_RESET	2.0 // Disparity change, in pixels of the matching scale, restarting the temporal average of a pixel
+#define REGION_DEPTH_LEVELS		6 // Square sizes 1 to 32 of the largest disparity table of GetRegionDepth
+#define SPARSE_DEPTH_PATCH		21 // Side of the region matched around a point by GetSparseDepth
+#define SPARSE_DEPTH_MIN_STDDEV		2.0 // Regions flatter than this grey level deviation are not matched
+#define IMU_HISTORY_NS			60000000000ULL // Raw IMU samples kept by Disparity for frame association, 2 MB at 1666 Hz
+#define IMU_BATCH_VALUES		1024 // IMU samples read from the ring at once
 
 namespace Tara
 {
@@ -64,6 +101,127 @@ int DisplayText(cv::Mat Image, cv::String Text, cv::Point Location);
 //ioctl with a number of retries in the case of failure
 int xioctl(int fd, int IOCTL_X, void *arg);
 
+//Stereo matchers of the disparity engine
+enum DisparityMatcher
+{
+	DISPARITY_MATCHER_BM = 0,	//cv::StereoBM, local block matching
+	DISPARITY_MATCHER_SGBM = 1,	//cv::StereoSGBM in the 3 way mode
+	DISPARITY_MATCHER_CENSUS_SGM = 2, //CensusSGM, robust to exposure differences, gives the right disparity in the same pass
+	DISPARITY_MATCHER_PYRAMID_SGBM = 3, //SGBM at 1/4 of the images over the full range, refined around it at 1/2 and full size, without the WLS filter
+	DISPARITY_MATCHER_SEMI_DENSE = 4 //Census costs of the textured pixels only, the other pixels are invalid, without the WLS filter
+};
+
+//Search range of each frame from the previous disparity map
+enum DisparityPrior
+{
+	DISPARITY_PRIOR_OFF = 0,	//Full range every frame
+	DISPARITY_PRIOR_STATIC = 1,	//Range of the previous map, for a static camera
+	DISPARITY_PRIOR_MOTION = 2	//Previous map shifted by the image motion measured with phase correlation
+};
+
+//Post filters of the disparity map
+enum DisparityFilter
+{
+	DISPARITY_FILTER_WLS = 0,		//cv::ximgproc::DisparityWLSFilter, needs the right disparity
+	DISPARITY_FILTER_DOMAIN_TRANSFORM = 1,	//cv::ximgproc::DTFilter on the left image, left disparity only
+	DISPARITY_FILTER_GUIDED = 2		//cv::ximgproc::GuidedFilter on the left image, left disparity only
+};
+
+//Scaling of the disparity map back to the image size when ScaleImage is below 1
+enum DisparityUpsampling
+{
+	DISPARITY_UPSAMPLE_BILINEAR = 0,	//cv::resize, blends the depth edges and the holes
+	DISPARITY_UPSAMPLE_JOINT_BILATERAL = 1,	//Valid neighbours weighted by their grey level difference to the full resolution left pixel
+	DISPARITY_UPSAMPLE_GUIDED = 2		//Guided filter of the full resolution left image on the upsampled valid disparities
+};
+
+//Scanline filling of the invalid runs of the disparity map
+enum DisparityHoleFill
+{
+	DISPARITY_HOLE_FILL_OFF = 0,		//Holes stay invalid
+	DISPARITY_HOLE_FILL_BACKGROUND = 1,	//Smaller disparity of both ends of the run, the background of an occlusion
+	DISPARITY_HOLE_FILL_INTERPOLATE = 2	//Linear between both ends of the run
+};
+
+//Named parameter sets of the disparity engine
+enum DisparityPreset
+{
+	DISPARITY_PRESET_FAST_BM = 0,		//BM on the 0.6 scaled images, DISPARITY_OPTION 0
+	DISPARITY_PRESET_BALANCED_SGBM,		//SGBM on the 0.6 scaled images, DISPARITY_OPTION 1
+	DISPARITY_PRESET_QUALITY_SGBM_WLS,	//SGBM on the full resolution images with the WLS filter
+	DISPARITY_PRESET_CENSUS_SGM,		//Census SGM on the 0.6 scaled images
+	DISPARITY_PRESET_PYRAMID_SGBM,		//Coarse to fine SGBM on the full resolution images
+	DISPARITY_PRESET_SEMI_DENSE,		//Textured pixels only on the 0.6 scaled images
+	DISPARITY_PRESET_COUNT
+};
+
+//Parameters of the disparity engine, can be changed while streaming
+typedef struct {
+	int Matcher;			//DisparityMatcher
+	double ScaleImage;		//Scale of the input images, 0.2 to 1
+	bool Filtered;			//Post filter selected by PostFilter
+	double WLSLambda;
+	double WLSSigma;
+	double ScaleDispMap;		//Scale of the disparity visualisation
+	int NumberOfDisparities;	//Multiple of 16, 0 selects from the image width
+	int MinDisparity;
+	int BlockSize;			//Census SGM: 5 selects the 5x5 census and 9 the 9x7 census, pyramid: block of the coarse SGBM
+	int PreFilterCap;
+	int PreFilterSize;		//BM only
+	int TextureThreshold;		//BM, semi dense: horizontal gradient of the textured pixels in grey levels
+	int UniquenessRatio;
+	int SpeckleWindowSize;
+	int SpeckleRange;
+	int Disp12MaxDiff;
+	int Stripes;			//SGBM only, horizontal stripes matched in parallel, 0 or 1 matches the whole image at once
+	int Paths;			//Census SGM only, 4 or 8 aggregation paths
+	int TemporalPrior;		//DisparityPrior, without the WLS filter only
+	bool AutoRange;			//Range of each region from a coarse pass of the frame, replaces TemporalPrior, without the WLS filter only
+	int PostFilter;			//DisparityFilter used when Filtered
+	double FilterSigmaSpatial;	//Domain transform: spatial sigma, guided: radius, in pixels of the matching scale
+	double FilterSigmaColor;	//Domain transform and upsampling: colour sigma, guided: square root of eps, in grey levels
+	bool LRCheck;			//Rejects the left pixels which a right disparity searched around the warped left map does not
+					//confirm within Disp12MaxDiff, without the WLS filter and with MinDisparity from 0 only
+	bool ParallelSpeckle;		//Speckles of BM and SGBM removed by SpeckleFilter after matching instead of inside the matcher
+	int HoleFill;			//DisparityHoleFill, after the LR check and before the post filter
+	int HoleFillWidth;		//Longest run filled in pixels of the matching scale, 0 fills all of them
+	double TemporalAlpha;		//Weight of the new frame in the temporal filter of a static camera, 0 turns it off
+	int TemporalPersistence;	//Frames a pixel turned invalid keeps its temporal average
+	int Upsampling;			//DisparityUpsampling, when ScaleImage is below 1
+} DISPARITYPARAMS_TypeDef;
+
+//Measured cost of GetDisparity since the parameters were last applied
+typedef struct {
+	double LatencyMs;		//Mean time of GetDisparity
+	double LatencyMaxMs;		//Longest GetDisparity
+	double Fps;			//Rate of the GetDisparity calls
+	UINT32 Frames;			//Frames computed with the current parameters
+	double SearchRatio;		//Mean disparities searched relative to NumberOfDisparities, the saving of the prior or the auto range
+} DISPARITYTIMING_TypeDef;
+
+//Result of GetSparseDepth for one region
+typedef struct {
+	cv::Rect Region;		//Region matched, clipped to the image
+	float Disparity;		//Full resolution pixels, -1 when the region could not be matched
+	float Depth;			//Same unit as EstimateDepth, -1 when the region could not be matched
+	float Confidence;		//0 to 1, margin of the correlation peak over the best other match
+} SPARSEDEPTH_TypeDef;
+
+//Result of GetRegionDepth for one region
+typedef struct {
+	cv::Rect Region;		//Region queried, clipped to the image
+	float Disparity;		//Mean of the valid disparities in full resolution pixels, -1 without any
+	float Depth;			//Depth of the mean disparity, same unit as EstimateDepth, -1 without any
+	float MinDepth;			//Depth of the largest disparity, the closest point of the region, -1 without any
+	float ValidRatio;		//Share of the pixels with a positive disparity
+} REGIONDEPTH_TypeDef;
+
+//Returns the parameters of a preset
+BOOL GetDisparityPresetParams(DisparityPreset Preset, DISPARITYPARAMS_TypeDef *Params);
+
+//Name of a preset
+const char* DisparityPresetStr(DisparityPreset Preset);
+
 class TaraCamParameters
 {
 public:
@@ -123,11 +281,67 @@ public:
 	//Grabs the frame, converts it to 8 bit, splits the left and right frame and returns the rectified frame
 	BOOL GrabFrame(cv::Mat *LeftImage, cv::Mat *RightImage);
 
+	//Same as above, also returns the CLOCK_MONOTONIC capture time of the frame
+	BOOL GrabFrame(cv::Mat *LeftImage, cv::Mat *RightImage, UINT64 *TimestampNs);
+
+	//Returns the IMU samples received in [StartNs, EndNs), IMU capture must be started with StartIMUCapture.
+	//IMU_VALUE_ID is the position of each sample in the stream drained by Disparity
+	BOOL GetIMUBundle(UINT64 StartNs, UINT64 EndNs, std::vector<IMUDATAOUTPUT_TypeDef> *Samples, int TimeoutMs);
+
+	//Same as above, the samples are returned unscaled
+	BOOL GetIMURawBundle(UINT64 StartNs, UINT64 EndNs, std::vector<IMURAWSAMPLE_TypeDef> *Samples, int TimeoutMs);
+
+	//Returns the IMU sample interpolated at TimestampNs. IMU_VALUE_ID is not read from the device, it is the position
+	//of the nearest sample in the stream drained by Disparity, rolling over like the one of PopIMUValueBatch
+	BOOL GetIMUValueAt(UINT64 TimestampNs, IMUDATAOUTPUT_TypeDef *Sample, int TimeoutMs);
+
 	//Estimates the disparity of the camera
 	BOOL GetDisparity(cv::Mat LImage, cv::Mat RImage, cv::Mat *mDisparityMap, cv::Mat *disp_filtered);
 
-	//Estimates the Depth of the point passed.
+	//Estimates the disparity into gDisparityMap without any visualisation, for the consumers which do not display it
+	BOOL GetDisparity(cv::Mat LImage, cv::Mat RImage);
+
+	//Renders the last gDisparityMap: the grey visualisation and, when ColourMap is not NULL, its JET colours with the colour bar
+	BOOL ColouriseDisparity(cv::Mat *mDisparityMap, cv::Mat *ColourMap);
+
+	//Estimates the Depth of the point passed from the valid disparities around it, FALSE with -1 when there is none.
 	BOOL EstimateDepth(cv::Point Pt, float *DepthValue);
+
+	//Confidence of the last gDisparityMap, CV_32F 0 to 1, and the mask of its valid pixels, CV_8U 255 or 0, in full resolution.
+	//The confidence is the one of the WLS filter, the share of valid neighbours of the edge aware filters, otherwise it
+	//falls with the local deviation of the disparity. Either output can be NULL.
+	BOOL GetConfidenceMap(cv::Mat *Confidence, cv::Mat *ValidMask);
+
+	//Depth of every pixel of the last gDisparityMap, CV_16U in millimetres (the unit of EstimateDepth) or CV_32F in metres,
+	//0 where the disparity is invalid
+	BOOL GetDepthMap(cv::Mat *Depth, int Type = CV_16U);
+
+	//Depth of rectangles of the last gDisparityMap, the pixels without a positive disparity are excluded. The tables are
+	//built by the first call after each GetDisparity. The mean costs a few lookups whatever the size of the region, the
+	//largest disparity about ceil(w/s)*ceil(h/s) lookups with s the side of the squares, the power of two not above the
+	//shorter side of the region and 2^(REGION_DEPTH_LEVELS-1) at most, so elongated and large regions cost more.
+	BOOL GetRegionDepth(const std::vector<cv::Rect> &Regions, std::vector<REGIONDEPTH_TypeDef> *Results);
+
+	//Matches only the regions passed along their epipolar line of the rectified images, no disparity map is computed.
+	//The disparity range is the one of the current parameters in full resolution pixels.
+	BOOL GetSparseDepth(const cv::Mat &LImage, const cv::Mat &RImage, const std::vector<cv::Rect> &Regions,
+				std::vector<SPARSEDEPTH_TypeDef> *Results);
+
+	//Same as above on SPARSE_DEPTH_PATCH square regions centred on the points
+	BOOL GetSparseDepth(const cv::Mat &LImage, const cv::Mat &RImage, const std::vector<cv::Point> &Points,
+				std::vector<SPARSEDEPTH_TypeDef> *Results);
+
+	//Selects a preset, applied from the next GetDisparity
+	BOOL SetDisparityPreset(DisparityPreset Preset);
+
+	//Sets the disparity parameters, applied from the next GetDisparity without recreating the matchers where possible
+	BOOL SetDisparityParams(const DISPARITYPARAMS_TypeDef &Params);
+
+	//Gets the disparity parameters, including a change not applied yet
+	BOOL GetDisparityParams(DISPARITYPARAMS_TypeDef *Params);
+
+	//Gets the measured cost of GetDisparity with the current parameters
+	BOOL GetDisparityTiming(DISPARITYTIMING_TypeDef *Timing);
 	
 	//Sets the exposure of the camera
 	BOOL SetExposure(int ExposureVal);
@@ -147,6 +361,12 @@ public:
 	//Gets the Stream Mode of the camera
 	BOOL GetStreamMode(UINT32 *StreamMode);
 
+	//Gets the latency and error counters of a HID command
+	BOOL GetHIDStatistics(HIDCommand Command, HIDSTATS_TypeDef *Stats);
+
+	//Clears the HID command counters
+	BOOL ResetHIDStatistics();
+
 private:
 	//Disparity algorithm
 	cv::Ptr<cv::StereoBM> bm_left;
@@ -155,39 +375,152 @@ private:
 	cv::Ptr<cv::StereoSGBM> sgbm_left;
 	cv::Ptr<cv::StereoMatcher> sgbm_right;
 	cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_filter;
+
+	//Census matcher, gives the right disparity for the WLS filter with the left one
+	CensusSGM census_left;
 	
-	//BM method Parameters for computing Disparity Map
-	int bm_preFilterSize;
-	int bm_preFilterCap;
-	int bm_SADWindowSize;
-	int bm_minDisparity;
-	int bm_numberOfDisparities;
-	int bm_textureThreshold;
-	int bm_uniquenessRatio;
-	int bm_speckleWindowSize;
-	int bm_speckleRange;
-	int bm_disp12MaxDiff;
-
-	//SGBM method Parameters for computing Disparity Map
-	int sgbm_preFilterCap;
-	int sgbm_SADWindowSize;
-	int sgbm_minDisparity;
-	int sgbm_numberOfDisparities;
-	int sgbm_uniquenessRatio;
-	int sgbm_speckleWindowSize;
-	int sgbm_speckleRange;
-	int sgbm_disp12MaxDiff;
-
-	double e_DWSLFLambda;
-	double e_DWSLFSigma;
-	double e_ScaleDispMap;
+	//Parameters in use and the change requested by SetDisparityParams
+	DISPARITYPARAMS_TypeDef gParams, gPendingParams;
+	bool gParamsPending;
+	pthread_mutex_t gParamsLock;
+
+	//Parameters the right matcher and the WLS filter were created with
+	DISPARITYPARAMS_TypeDef gFilterParams;
+	bool gFilterCreated;
+
 	double e_ScaleImage;
 
+	//Cost of GetDisparity
+	DISPARITYTIMING_TypeDef gTiming;
+	UINT64 gLastDisparityNs;
+
 	//Range Selection
 	double LIMIT(double n, double lower, double upper);
 
-	//disparity option Selected
-	int e_DisparityOption; //{ 0 - Stereo_BM, 1 - Stereo_SGBM }
+	//Clamps the parameters to the values the matchers accept
+	void ValidateParams(DISPARITYPARAMS_TypeDef *Params);
+
+	//Applies the requested parameters, called by GetDisparity
+	void ApplyPendingParams();
+
+	//Accumulates the time of one GetDisparity
+	void UpdateTiming(UINT64 StartNs, UINT64 EndNs);
+
+	//Persistent worker computing the right disparity while the caller computes the left one
+	pthread_t gRightWorker;
+	pthread_mutex_t gWorkerLock;
+	pthread_cond_t gJobCond, gDoneCond;
+	bool gWorkerRunning, gWorkerExit, gJobPending, gJobDone, gJobFailed;
+	cv::Ptr<cv::StereoMatcher> gJobMatcher;
+	cv::Mat gJobLeft, gJobRight, gJobDisparity;	//gJobDisparity is kept between frames as the worker output buffer
+
+	//Worker thread
+	static void* RightMatcherThread(void *lpParameter);
+
+	//Starts the worker on the first filtered frame
+	BOOL StartRightWorker();
+
+	//Stops the worker, called from the destructor
+	void StopRightWorker();
+
+	//Waits for the posted job and releases its images, returns true when the worker failed
+	bool WaitRightJob();
+
+	//Computes the left disparity on the caller thread and the right disparity on the worker
+	void ComputeLeftRight(cv::Ptr<cv::StereoMatcher> RightMatcher, const cv::Mat &LImage, const cv::Mat &RImage,
+				cv::Mat *LDisparity, cv::Mat *RDisparity);
+
+	//Computes the left disparity with the selected matcher
+	void ComputeLeft(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity);
+
+	//SGBM matchers of the stripes, the speckle filter runs once on the stitched map
+	std::vector<cv::Ptr<cv::StereoSGBM> > gStripeMatchers;
+	std::vector<cv::Mat> gStripeDisparity;
+	cv::Mat gSpeckleBuffer;
+
+	//Matches the stripes in parallel and stitches them
+	void ComputeSGBMStripes(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity);
+
+	//Speckle removal in parallel tiles and hole filling
+	SpeckleFilter speckle_filter;
+
+	//Per pixel average over the frames, last stage at the matching scale
+	TemporalFilter temporal_filter;
+
+	//Speckle filter of StereoSGBM or SpeckleFilter with ParallelSpeckle, for the matchers which do not run it themselves
+	void FilterSpeckles(cv::Mat *LDisparity);
+
+	//Full search range, the number of disparities resolved from the image width when the parameter is 0
+	int gNumberOfDisparities;
+
+	//Temporal prior: previous map and left image at the matching scale, search range of each region for the current frame
+	cv::Mat gPriorDisparity, gPriorImage, gPriorWindow;
+	UINT32 gPriorFrames;
+	std::vector<cv::Vec2i> gSearchRanges;
+
+	//Pyramid matcher: full range SGBM of the smallest level and the census refinement of the finer ones,
+	//the refinement also gives the right disparity of the LR check
+	cv::Ptr<cv::StereoSGBM> gPyramidMatcher;
+	CensusSGM census_refine;
+	std::vector<cv::Mat> gPyramidLeft, gPyramidRight;
+	cv::Mat gPyramidDisparity, gPyramidPrior;
+
+	//Matches the smallest level of the pyramid and refines the map up to the matching scale
+	void ComputePyramid(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity);
+
+	//Semi dense matcher: textured pixels of the left image and their halo
+	cv::Mat gTextureMask;
+
+	//Matches only the textured pixels with the census costs of census_left
+	void ComputeSemiDense(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity);
+
+	//Edge aware filters: disparity weighted by its validity and the weights, before and after the filter
+	cv::Mat gFilterDisparity, gFilterWeight, gSmoothDisparity, gSmoothWeight;
+
+	//Filters the left disparity with the domain transform or guided filter of the left image, fills the holes
+	void FilterEdgeAware(const cv::Mat &LImage, cv::Mat *LDisparity);
+
+	//Edge aware upsampling: nearest pixel of the matching scale of each full resolution column and row, weights of the grey
+	//level difference and of the neighbours of each column and row, bilinear upsampling of the weighted disparity and the
+	//weights before the guided filter
+	std::vector<int> gUpsampleX, gUpsampleY;
+	std::vector<float> gUpsampleRange, gUpsampleSpatialX, gUpsampleSpatialY;
+	cv::Mat gUpsampleDisparity, gUpsampleWeight;
+
+	//Nearest pixel of the matching scale and spatial weights of its neighbours for each full resolution pixel of an axis
+	void UpsampleAxis(int Full, int Low, std::vector<int> *Nearest, std::vector<float> *Spatial);
+
+	//Scales the map of the matching scale back to the size of FullLImage with the joint bilateral or guided upsampling
+	void UpsampleDisparity(const cv::Mat &LImage, const cv::Mat &FullLImage, const cv::Mat &LDisparity, cv::Mat *Disparity);
+
+	//LR check: mirrored images, left map warped to the right view and the right disparity
+	cv::Mat gCheckLeft, gCheckRight, gCheckPrior, gCheckDisparity;
+
+	//Invalidates the pixels of the left map which the right disparity refined around the warped map does not confirm
+	void CheckLeftRight(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *LDisparity);
+
+	//Coarse pass of the auto range
+	cv::Ptr<cv::StereoSGBM> gCoarseMatcher;
+	cv::Mat gCoarseLeft, gCoarseRight, gCoarseDisparity;
+
+	//Disparities searched in the current frame relative to the full range
+	double gSearchRatio;
+
+	//Narrows the search range of each region (stripe) from the previous map or the coarse pass,
+	//full range where they do not hold
+	void SetSearchRanges(const cv::Mat &LImage, const cv::Mat &RImage);
+
+	//Matches the images at DISPARITY_AUTO_SCALE, returns the map at the matching scale and the first column with a full range
+	int ComputeCoarse(const cv::Mat &LImage, const cv::Mat &RImage, cv::Mat *Disparity);
+
+	//Sets the range of the matcher of a region
+	void SetMatcherRange(size_t Region, int MinDisparity, int NumDisparities);
+
+	//Gives the invalid pixels of the narrowed regions the value of the full range
+	void NormalizeInvalid(cv::Mat *LDisparity);
+
+	//Keeps the map and the image of this frame for the next one
+	void UpdatePrior(const cv::Mat &LImage, cv::Mat *LDisparity);
 
 	//Image Resolution
 	cv::Size ImageSize;	
@@ -197,9 +530,40 @@ private:
 
 	//Range map to convert to color
 	cv::Mat mRange;
+
+	//COLORMAP_JET of each grey level and the coloured range map, computed on the first ColouriseDisparity
+	cv::Mat gColourLUT, gColourBar;
+
+	//Last map at the matching scale, before gDisparityMap is scaled back, a header only
+	cv::Mat gMatchDisparity;
+
+	//Depth of each of the 65536 disparity values, with the Q matrix and the scale it was computed for
+	cv::Mat gDepthLUT, gDepthLUTQ;
+	double gDepthLUTScale;
+
+	//Recomputes the depth table when the type, the matching scale or Q changed
+	void UpdateDepthLUT(int Type);
+
+	//Region queries: integral images of the valid disparities and of their count, largest disparity of the squares of
+	//side 2^k at each position, built for the map of frame gRegionFrame
+	cv::Mat gRegionSum, gRegionCount, gRegionValid;
+	std::vector<cv::Mat> gRegionMax;
+	UINT32 gDisparityFrames, gRegionFrame;
+
+	//Builds the tables of the region queries for the current map
+	void BuildRegionTables();
+
 	std::vector<cv::Mat> StereoFrames;
 	cv::Mat InputFrame10bit, InterleavedFrame;
 
+	//Raw IMU samples drained from the library ring, ordered by time
+	std::deque<IMURAWSAMPLE_TypeDef> IMUHistory;
+	std::vector<IMURAWSAMPLE_TypeDef> IMUBatch;
+	UINT64 IMUHistoryFirst;		//Position of the first sample of the history in the drained stream
+
+	//Moves the IMU samples from the ring to the history until EndNs is covered
+	BOOL UpdateIMUHistory(UINT64 EndNs, int TimeoutMs);
+
 	//DeviceID to stream the camera
 	int DeviceID;
 	
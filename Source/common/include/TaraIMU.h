@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+/**********************************************************************
+	TaraIMU.h : 	Declares the IMU processing classes of the shared library.
+	OrientationFilter: Declares the quaternion orientation filter
+				which runs on the IMU samples of the library ring.
+	IMUPreintegrator: Declares the on-manifold preintegration of the
+				IMU samples between two camera frames.
+	IMUDecimator: Declares the anti-aliasing FIR decimator which reads
+				the IMU ring at a reduced rate.
+**********************************************************************/
+#ifndef _TARA_IMU_H
+#define _TARA_IMU_H
+
+#include <pthread.h>
+
+//Extension unit header
+#include "xunit_lib_tara.h"
+
+//OpenCV headers
+#include "opencv2/core.hpp"
+
+#define ORIENTATION_BATCH_VALUES	256	// IMU samples processed per wakeup of the filter thread
+#define ORIENTATION_BATCH_TIMEOUT	20	// Milli seconds
+#define ORIENTATION_DEFAULT_BETA	0.1f	// Gain of the accelerometer correction
+#define ORIENTATION_MAX_INTERVAL_NS	100000000ULL // Larger gaps between samples are not integrated
+
+#define PREINTEGRATION_BATCH_VALUES	256	// IMU samples scaled at once by the preintegrator
+#define IMU_GRAVITY			9.80665	// m/s^2, the accelerometer sensitivity is in mg
+
+#define DECIMATOR_MAX_TAPS		127	// Longest FIR, odd so that the delay is a whole sample
+#define DECIMATOR_TAPS_PER_FACTOR	10	// Default FIR length per unit of decimation
+#define DECIMATOR_CUTOFF		0.8	// Cutoff as a fraction of the output Nyquist frequency
+#define DECIMATOR_LANES			8	// Six axes padded to two SIMD registers
+#define DECIMATOR_BATCH_VALUES		1024	// Input samples read from the ring at once
+
+namespace Tara
+{
+
+//Attitude estimated by the orientation filter
+typedef struct {
+	float Q[4];			//Quaternion w, x, y, z rotating the sensor frame into the world frame
+	UINT64 TimestampNs;		//Timestamp of the last sample applied
+	UINT32 SampleCount;		//Samples applied since the last reset
+} ORIENTATION_TypeDef;
+
+class OrientationFilter
+{
+public:
+
+	//Constructor
+	OrientationFilter(float Beta = ORIENTATION_DEFAULT_BETA);
+
+	//Destructor
+	~OrientationFilter();
+
+	//Restarts the estimation from the next sample
+	void Reset();
+
+	//Sets the gain of the accelerometer correction
+	void SetBeta(float Beta);
+
+	//Applies raw samples in time order, can be used without the filter thread
+	void Update(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues);
+
+	//Starts a thread which feeds the filter from an IMU subscription of its own, IMU capture must be started with StartIMUCapture.
+	//The default ring read by PopIMUValueBatch and Disparity is left to its reader.
+	BOOL Start();
+
+	//Stops the filter thread
+	BOOL Stop();
+
+	//Reads the latest attitude, can be called from any thread
+	BOOL GetOrientation(ORIENTATION_TypeDef *Orientation);
+
+	//Reads the latest attitude as roll, pitch and yaw in degrees
+	BOOL GetEulerAngles(double *Roll, double *Pitch, double *Yaw);
+
+	//Mean processing time of one sample in nano seconds
+	double GetAverageUpdateNs();
+
+private:
+
+	//Filter state, only touched by the thread calling Update
+	float q0, q1, q2, q3;
+	float gBeta;
+	UINT64 gLastTimestampNs;
+	UINT32 gSampleCount;
+	bool gResetPending;
+
+	//Latest attitude, published through a sequence counter
+	volatile UINT32 gSequence;
+	ORIENTATION_TypeDef gPublished;
+
+	//Processing time
+	UINT64 gUpdateNs, gUpdateSamples;
+
+	//Scratch buffers for the scaled samples, no allocation while running
+	float gAccX[ORIENTATION_BATCH_VALUES], gAccY[ORIENTATION_BATCH_VALUES], gAccZ[ORIENTATION_BATCH_VALUES];
+	float gGyroX[ORIENTATION_BATCH_VALUES], gGyroY[ORIENTATION_BATCH_VALUES], gGyroZ[ORIENTATION_BATCH_VALUES];
+	IMURAWSAMPLE_TypeDef gBatch[ORIENTATION_BATCH_VALUES];
+
+	//Filter thread and its IMU subscription
+	pthread_t gThread;
+	volatile bool gRunning, gAbort;
+	UINT32 gConsumer;
+	static void* FilterThread(void *lpParameter);
+
+	//One step of the filter
+	void Step(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+	//Initial attitude from the gravity direction
+	void InitFromAccel(float ax, float ay, float az);
+
+	//Publishes the current attitude
+	void Publish();
+};
+
+class IMUPreintegrator
+{
+public:
+
+	//Constructor
+	IMUPreintegrator();
+
+	//Sets the continuous time noise densities, gyro in rad/s/sqrt(Hz) and accelerometer in m/s^2/sqrt(Hz)
+	void SetNoise(double GyroNoiseDensity, double AccNoiseDensity);
+
+	//Sets the biases used while integrating, gyro in rad/s and accelerometer in m/s^2
+	void SetBias(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias);
+
+	//Clears the preintegrated values, the biases are kept
+	void Reset();
+
+	//Integrates one measurement held for dt seconds, gyro in rad/s and accelerometer in m/s^2
+	void IntegrateMeasurement(const cv::Vec3d &Gyro, const cv::Vec3d &Acc, double dt);
+
+	//Integrates the raw samples between two frame timestamps, each sample is held until the next one
+	BOOL IntegrateInterval(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues, UINT64 StartNs, UINT64 EndNs);
+
+	//Preintegrated values with the biases first order corrected to the ones passed
+	cv::Matx33d GetDeltaRotation(const cv::Vec3d &GyroBias) const;
+	cv::Vec3d GetDeltaVelocity(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias) const;
+	cv::Vec3d GetDeltaPosition(const cv::Vec3d &GyroBias, const cv::Vec3d &AccBias) const;
+
+	//Predicts the state at the end of the interval from the state at its start, Gravity in the world frame
+	void Predict(const cv::Matx33d &Ri, const cv::Vec3d &Vi, const cv::Vec3d &Pi, const cv::Vec3d &Gravity,
+			cv::Matx33d *Rj, cv::Vec3d *Vj, cv::Vec3d *Pj) const;
+
+	//Preintegrated values at the integration biases
+	cv::Matx33d DeltaR;
+	cv::Vec3d DeltaV, DeltaP;
+	double DeltaT;
+
+	//Covariance of [rotation, velocity, position] errors
+	cv::Matx<double, 9, 9> Covariance;
+
+	//Jacobians with respect to the gyro (bg) and accelerometer (ba) biases
+	cv::Matx33d JRg, JVg, JVa, JPg, JPa;
+
+	//Biases used while integrating
+	cv::Vec3d BiasGyro, BiasAcc;
+
+private:
+
+	//Discrete noise of one second, divided by dt per measurement
+	double gGyroNoiseVar, gAccNoiseVar;
+
+	//Scratch buffers for the scaled samples, no allocation while integrating
+	double gAccX[PREINTEGRATION_BATCH_VALUES], gAccY[PREINTEGRATION_BATCH_VALUES], gAccZ[PREINTEGRATION_BATCH_VALUES];
+	double gGyroX[PREINTEGRATION_BATCH_VALUES], gGyroY[PREINTEGRATION_BATCH_VALUES], gGyroZ[PREINTEGRATION_BATCH_VALUES];
+};
+
+class IMUDecimator
+{
+public:
+
+	//Constructor, Factor 1 passes the samples through
+	IMUDecimator(UINT32 Factor = 1, UINT32 Taps = 0);
+
+	//Destructor, ends the IMU subscription
+	~IMUDecimator();
+
+	//Designs the low pass FIR for the decimation factor, Taps 0 selects DECIMATOR_TAPS_PER_FACTOR taps per factor
+	BOOL Configure(UINT32 Factor, UINT32 Taps = 0);
+
+	//Selects the factor giving the closest rate not below OutputHz, from the ODR measured by GetIMUTimingStats
+	BOOL ConfigureRate(double OutputHz, UINT32 Taps = 0);
+
+	//Clears the filter history, the next sample fills it
+	void Reset();
+
+	//Filters the raw samples, writes one value per Factor samples and returns the number of values written
+	UINT32 Process(const IMURAWSAMPLE_TypeDef *Samples, UINT32 NumValues, IMUDATAOUTPUT_TypeDef *Output, UINT32 MaxOutput);
+
+	//Subscribes to the IMU samples with SubscribeIMU, so that Pop does not take them from the other readers.
+	//Samples captured before the subscription are not seen. Pop attaches on its first call.
+	BOOL Attach();
+
+	//Ends the subscription, a Pop blocked in another thread returns
+	BOOL Detach();
+
+	//Same as PopIMUValueBatch at the reduced rate, waits for Factor raw samples per value requested
+	BOOL Pop(IMUDATAOUTPUT_TypeDef *Output, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues);
+
+	//Current configuration
+	UINT32 GetFactor() const { return gFactor; }
+	UINT32 GetTaps() const { return gTaps; }
+
+private:
+
+	UINT32 gFactor, gTaps;
+	float gCoeffs[DECIMATOR_MAX_TAPS];
+
+	//History of the scaled axes, each sample is stored twice so that the last gTaps samples are contiguous
+	float gHistory[2 * DECIMATOR_MAX_TAPS][DECIMATOR_LANES];
+	UINT64 gTimestamps[DECIMATOR_MAX_TAPS];
+	UINT32 gPos, gPhase;
+	UINT16 gValueId;
+	bool gPrimed;
+
+	//IMU subscription read by Pop
+	UINT32 gConsumer;
+	bool gAttached;
+
+	//Scratch buffers, no allocation while running
+	float gAccX[DECIMATOR_BATCH_VALUES], gAccY[DECIMATOR_BATCH_VALUES], gAccZ[DECIMATOR_BATCH_VALUES];
+	float gGyroX[DECIMATOR_BATCH_VALUES], gGyroY[DECIMATOR_BATCH_VALUES], gGyroZ[DECIMATOR_BATCH_VALUES];
+	IMURAWSAMPLE_TypeDef gBatch[DECIMATOR_BATCH_VALUES];
+
+	//Appends one scaled sample to the history
+	void Push(const float *Axes, UINT64 TimestampNs);
+
+	//Filter output over the current history
+	void Filter(IMUDATAOUTPUT_TypeDef *Output);
+};
+
+}
+
+#endif
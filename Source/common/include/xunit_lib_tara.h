@@ -21,6 +21,7 @@
 #define XUNIT_LIB_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <libudev.h>
 #include <pthread.h>
 
@@ -34,6 +35,7 @@ typedef int32_t   		 INT32;
 typedef unsigned char		 UINT8;
 typedef unsigned short int   	 UINT16;
 typedef unsigned int		 UINT32;
+typedef uint64_t		 UINT64;
 
 /* Stereo IMU */
 typedef struct {
@@ -64,8 +66,85 @@ typedef struct {
 	double gyroX;
 	double gyroY;
 	double gyroZ;
+	UINT64 TimestampNs;		//CLOCK_MONOTONIC time at which the sample was received, the samples queued before
+					//the same wakeup of the capture thread are dated back by the estimated interval
 } IMUDATAOUTPUT_TypeDef;
 
+/* Raw IMU sample as stored in the IMU ring, scaled only when it is read */
+typedef struct __attribute__((packed)) {
+	INT16 accX;
+	INT16 accY;
+	INT16 accZ;
+	INT16 gyroX;
+	INT16 gyroY;
+	INT16 gyroZ;
+	UINT64 TimestampNs;		//CLOCK_MONOTONIC time of the sample, see IMUDATAOUTPUT_TypeDef
+} IMURAWSAMPLE_TypeDef;
+
+/* Scaled IMU samples, one array per axis */
+typedef struct {
+	float *accX;
+	float *accY;
+	float *accZ;
+	float *gyroX;
+	float *gyroY;
+	float *gyroZ;
+	UINT64 *TimestampNs;		//Optional, may be NULL
+} IMUAXESFLOAT_TypeDef;
+
+typedef struct {
+	double *accX;
+	double *accY;
+	double *accZ;
+	double *gyroX;
+	double *gyroY;
+	double *gyroZ;
+	UINT64 *TimestampNs;		//Optional, may be NULL
+} IMUAXESDOUBLE_TypeDef;
+
+typedef struct {
+	double OdrHz;			//Estimated output data rate of the IMU
+	double IntervalUs;		//Mean interval between two samples, measured between the wakeups of the capture thread
+	double JitterUs;		//Mean deviation of the interval
+	UINT64 LastTimestampNs;		//Timestamp of the latest sample
+	UINT32 SampleCount;		//Samples received since StartIMUCapture
+} IMUTIMING_TypeDef;
+
+/* HID command telemetry */
+enum HIDCommand
+{
+	HID_CMD_READ_FIRMWARE_VERSION = 0,
+	HID_CMD_GET_CAMERA_UNIQUE_ID,
+	HID_CMD_GET_EXPOSURE,
+	HID_CMD_SET_EXPOSURE,
+	HID_CMD_SET_AUTO_EXPOSURE,
+	HID_CMD_GET_IMU_CONFIG,
+	HID_CMD_SET_IMU_CONFIG,
+	HID_CMD_CONTROL_IMU_CAPTURE,
+	HID_CMD_IMU_VALUE_BUFFER,
+	HID_CMD_READ_CALIB_REQUEST,
+	HID_CMD_READ_CALIB_DATA,
+	HID_CMD_GET_STREAM_MODE,
+	HID_CMD_SET_STREAM_MODE,
+	HID_CMD_SET_HDR_MODE,
+	HID_CMD_GET_HDR_MODE,
+	HID_CMD_GET_IMU_TEMPERATURE,
+	HID_CMD_GET_REVISION,
+	HID_CMD_COUNT
+};
+
+typedef struct {
+	UINT32 Issued;			//Completed transactions (sum of the outcomes below)
+	UINT32 Success;			//Device answered with a SUCCESS status
+	UINT32 Fail;			//Device answered with a FAIL status
+	UINT32 Timeout;			//No matching report before the timeout
+	UINT32 WriteError;		//Report could not be written to the device
+	UINT32 StrayPackets;		//Reports read and discarded while waiting for the answer
+	UINT32 LatencyP50Us;		//Latency of the answered transactions in micro seconds
+	UINT32 LatencyP99Us;
+	UINT32 LatencyMaxUs;
+} HIDSTATS_TypeDef;
+
 /* Report Numbers */
 #define SET_FAIL				0x00
 #define SET_SUCCESS				0x01
@@ -148,6 +227,11 @@ typedef struct {
 #define IMU_AXES_VALUES_MIN			(1)
 #define IMU_AXES_VALUES_MAX			(65535)
 
+/* IMU RING */
+#define IMU_RING_CAPACITY			(65536)		/* Power of two */
+#define IMU_RING_CONSUMERS			(4)		/* Rings fed by the capture, including the default one */
+#define IMU_CONSUMER_DEFAULT			(0)		/* Ring read by PopIMUValueBatch and PopIMURawBatch */
+
 /* Range of Gyro for Rev A*/
 #define LSM6DS0_G_FS_245                   		(UINT8)(0x00) /* Full scale: 245 dps  */
 #define LSM6DS0_G_FS_500                    	(UINT8)(0x08) /* Full scale: 500 dps  */
@@ -203,6 +287,39 @@ BOOL ControlIMUCapture (IMUDATAINPUT_TypeDef *lIMUInput);	//Configures the IMU t
 BOOL GetIMUValueBuffer (pthread_mutex_t *lIMUDataReadyEvent, IMUDATAOUTPUT_TypeDef *lIMUAxes);	
 								//Reads the IMU values
 
+BOOL StartIMUCapture (void);					//Starts reading the IMU values into the library ring
+
+BOOL StopIMUCapture (void);					//Stops the IMU capture thread
+
+BOOL PopIMUValueBatch (IMUDATAOUTPUT_TypeDef *lIMUAxes, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues);
+								//Waits for and reads a batch of IMU values from the ring
+
+BOOL PopIMURawBatch (IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues);
+								//Waits for and reads a batch of raw IMU samples from the ring
+
+BOOL SubscribeIMU (UINT32 *Consumer);				//Claims a ring of its own fed with every IMU sample
+
+BOOL UnsubscribeIMU (UINT32 Consumer);				//Releases a ring claimed with SubscribeIMU
+
+BOOL PopIMURawBatchFrom (UINT32 Consumer, IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues);
+								//Waits for and reads a batch of raw IMU samples from a subscribed ring
+
+BOOL ConvertIMURawToValues (const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUDATAOUTPUT_TypeDef *lIMUAxes);
+								//Scales raw IMU samples to IMU values
+
+BOOL ConvertIMURawToFloat (const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUAXESFLOAT_TypeDef *Axes);
+								//Scales raw IMU samples to one float array per axis
+
+BOOL ConvertIMURawToDouble (const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUAXESDOUBLE_TypeDef *Axes);
+								//Scales raw IMU samples to one double array per axis
+
+BOOL GetIMURingStatus (UINT32 *Available, UINT32 *Overruns);	//Reads the fill level and the dropped samples of the ring
+
+BOOL GetIMUConsumerStatus (UINT32 Consumer, UINT32 *Available, UINT32 *Overruns);
+								//Reads the fill level and the dropped samples of a subscribed ring
+
+BOOL GetIMUTimingStats (IMUTIMING_TypeDef *Timing);		//Reads the estimated ODR and jitter of the IMU samples
+
 BOOL StereoCalibRead (unsigned char **IntrinsicBuffer, unsigned char **ExtrinsicBuffer, int *lIntFileLength, int *lExtFileLength);
 								//Reads back the Intrinsic and Extrinsic values of the camera from the flash
 
@@ -218,12 +335,21 @@ BOOL GetIMUTemperatureData (UINT8 *iMSBTemp, UINT8 *iLSBTemp);	//Reads the tempe
 
 BOOL GetRevision(TaraRev *eRev);					//Get Revision
 
+BOOL GetHIDStatistics (HIDCommand Command, HIDSTATS_TypeDef *Stats);
+								//Reads the counters and latency percentiles of a HID command
+
+BOOL ResetHIDStatistics (void);					//Clears the counters of all the HID commands
+
 /* Function Declarations */
 
 const char *bus_str (int);
 
+const char *HIDCommandStr (int);
+
 unsigned int GetTickCount (void);
 
+UINT64 GetMonotonicTimeNs (void);
+
 int find_hid_device (char *);
 
 #endif
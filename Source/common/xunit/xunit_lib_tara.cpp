@@ -20,11 +20,20 @@
 **********************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <linux/input.h>
 #include <linux/hidraw.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "xunit_lib_tara.h"
 
@@ -86,6 +95,111 @@ unsigned char 					g_in_packet_buf[BUFFER_LENGTH];
 const char					*hid_device;
 const char					*hid_device_array[2];
 
+//HID command telemetry, updated with atomic builtins so that it can be read from any thread.
+#define HID_LATENCY_BUCKETS			96
+
+enum HIDOutcome
+{
+	HID_OUTCOME_SUCCESS = 0,
+	HID_OUTCOME_FAIL,
+	HID_OUTCOME_TIMEOUT,
+	HID_OUTCOME_WRITE_ERROR
+};
+
+typedef struct {
+	UINT32 Issued;
+	UINT32 Success;
+	UINT32 Fail;
+	UINT32 Timeout;
+	UINT32 WriteError;
+	UINT32 StrayPackets;
+	UINT32 LatencyMaxUs;
+	UINT32 LatencyHist[HID_LATENCY_BUCKETS];
+} HIDTelemetry;
+
+HIDTelemetry					glHIDTelemetry[HID_CMD_COUNT];
+
+//IMU sample rings, one per consumer. The capture thread copies every sample to each active ring,
+//so that each ring has a single producer and a single consumer and a slow consumer only overruns its own.
+//The capture thread never waits for a consumer, a ring which is full drops the new samples and counts them.
+//Head and tail are kept on separate cache lines so that the two threads do not share a line.
+#define IMU_RING_MASK				(IMU_RING_CAPACITY - 1)
+#define IMU_RING_CACHE_LINE			64
+
+//A consumer is the index of its ring and the generation of its subscription, so that a released one is refused
+#define IMU_CONSUMER_SHIFT			8
+#define IMU_CONSUMER_INDEX(Consumer)		((Consumer) & ((1 << IMU_CONSUMER_SHIFT) - 1))
+
+typedef struct {
+	volatile UINT32 Head;			//Written by the producer only
+	UINT8 HeadPad[IMU_RING_CACHE_LINE - sizeof(UINT32)];
+	volatile UINT32 Tail;			//Written by the consumer only
+	UINT8 TailPad[IMU_RING_CACHE_LINE - sizeof(UINT32)];
+	volatile UINT32 Active;			//Fed by the capture thread
+	volatile UINT32 Waiting;		//Consumer is blocked and needs a wakeup
+	volatile UINT32 Threshold;		//Number of samples the consumer waits for
+	volatile UINT32 Ended;			//Producer has stopped, no more samples will arrive
+	volatile UINT32 Overruns;		//Samples dropped because the ring was full
+	volatile UINT32 Generation;		//Subscriptions of the ring released so far
+	volatile UINT32 Readers;		//Readers inside a pop, the ring is not given to a new subscriber meanwhile
+	int DataEvent;				//Wakes the consumer of this ring only
+	IMURAWSAMPLE_TypeDef *Samples;		//Raw samples, scaled only when they are read
+} IMURing;
+
+//Ring IMU_CONSUMER_DEFAULT is always active, the others are claimed with SubscribeIMU
+IMURing						glIMURings[IMU_RING_CONSUMERS];
+
+//Serializes the subscriptions with the start and the release of the capture
+pthread_mutex_t					glIMURingLock = PTHREAD_MUTEX_INITIALIZER;
+
+//Set by the capture thread while it copies samples to the rings, so that a ring is not reused under it
+volatile UINT32					glIMUPushing = 0;
+
+//Readers inside a pop, the rings and their events are only reset or freed while the gate is closed and no reader is inside
+volatile UINT32					glIMURingReaders = 0;
+volatile UINT32					glIMURingClosed = 0;
+
+//Timing of the IMU samples, published by the capture thread through a sequence counter
+#define IMU_TIMING_EWMA_SHIFT			6	//Smoothing of 1/64
+#define IMU_TIMING_GAP_FACTOR			4	//Intervals this many times longer or shorter than the estimate are not measured
+#define IMU_TIMING_SEED_WAKEUPS			8	//Wakeups whose median interval seeds the estimate
+#define IMU_TIMING_FALLBACK_HZ			1666	//Rate assumed when the configured ODR is not known
+#define IMU_CAPTURE_BURST			64	//Reports read at most per wakeup, the queue of a hidraw device
+
+typedef struct {
+	volatile UINT32 Sequence;		//Odd while the capture thread is updating
+	IMUTIMING_TypeDef Timing;
+	double SeedUs[IMU_TIMING_SEED_WAKEUPS];	//Intervals of the first wakeups, only read by the capture thread
+	UINT32 SeedCount;
+} IMUTimingState;
+
+IMUTimingState					glIMUTiming;
+
+//Sensitivities of the IMU over time, so that the raw samples are scaled with the range they were captured with.
+//Epochs are appended by the thread configuring the IMU and read through a sequence counter, the samples older
+//than the oldest epoch kept take its sensitivity.
+#define IMU_SENS_EPOCHS				16	//Range changes remembered
+
+typedef struct {
+	UINT64 StartNs;				//Time from which the sensitivity applies
+	float AccSensMult;
+	float GyroSensMult;
+} IMUSensEpoch;
+
+typedef struct {
+	volatile UINT32 Sequence;		//Odd while an epoch is being appended
+	UINT32 Count;				//Epochs appended since the start, the last IMU_SENS_EPOCHS are kept
+	IMUSensEpoch Epochs[IMU_SENS_EPOCHS];
+} IMUSensHistory;
+
+IMUSensHistory					glIMUSens;
+pthread_t					glIMUCaptureThread;
+BOOL						glIMUCaptureJoinable = FALSE;	//Thread created and not joined yet
+volatile BOOL					glIMUCaptureRunning = FALSE;	//Cleared by the capture thread when it ends
+int						glIMUStopEvent = -1;
+
+static void ReleaseIMURing(void);
+
 
 //Auxiliary Functions
 void Sleep(unsigned int TimeInMilli)
@@ -106,6 +220,146 @@ void Sleep(unsigned int TimeInMilli)
 }
 
 
+//Maps a latency to a log-linear bucket, 4 buckets for every power of two
+static int HIDLatencyBucket(UINT32 LatencyUs)
+{
+	int msb;
+
+	if(LatencyUs < 4)
+		return LatencyUs;
+
+	msb = 31 - __builtin_clz(LatencyUs);
+	msb = ((msb - 1) * 4) + ((LatencyUs >> (msb - 2)) & 0x03);
+
+	return (msb < HID_LATENCY_BUCKETS) ? msb : (HID_LATENCY_BUCKETS - 1);
+}
+
+//Upper bound of the latency held in a bucket
+static UINT32 HIDBucketLatency(int Bucket)
+{
+	int msb;
+
+	if(Bucket < 4)
+		return Bucket;
+
+	msb = (Bucket / 4) + 1;
+	return (UINT32)(((4 + (Bucket % 4) + 1) << (msb - 2)) - 1);
+}
+
+//Records the outcome of a HID transaction started at StartNs
+static void HIDTelemetryRecord(HIDCommand Command, UINT64 StartNs, HIDOutcome Outcome)
+{
+	HIDTelemetry *lTelemetry = &glHIDTelemetry[Command];
+	UINT64 lLatencyUs = (GetMonotonicTimeNs() - StartNs) / 1000;
+	UINT32 lLatency = (lLatencyUs > 0xFFFFFFFF) ? 0xFFFFFFFF : (UINT32)lLatencyUs;
+	UINT32 lMax;
+
+	__atomic_fetch_add(&lTelemetry->Issued, 1, __ATOMIC_RELAXED);
+
+	switch(Outcome)
+	{
+		case HID_OUTCOME_SUCCESS:
+			__atomic_fetch_add(&lTelemetry->Success, 1, __ATOMIC_RELAXED);
+			break;
+
+		case HID_OUTCOME_FAIL:
+			__atomic_fetch_add(&lTelemetry->Fail, 1, __ATOMIC_RELAXED);
+			break;
+
+		case HID_OUTCOME_TIMEOUT:
+			__atomic_fetch_add(&lTelemetry->Timeout, 1, __ATOMIC_RELAXED);
+			return;
+
+		case HID_OUTCOME_WRITE_ERROR:
+			__atomic_fetch_add(&lTelemetry->WriteError, 1, __ATOMIC_RELAXED);
+			return;
+	}
+
+	//Latency is tracked only for the transactions answered by the device
+	__atomic_fetch_add(&lTelemetry->LatencyHist[HIDLatencyBucket(lLatency)], 1, __ATOMIC_RELAXED);
+
+	lMax = __atomic_load_n(&lTelemetry->LatencyMaxUs, __ATOMIC_RELAXED);
+	while(lLatency > lMax)
+	{
+		if(__atomic_compare_exchange_n(&lTelemetry->LatencyMaxUs, &lMax, lLatency, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+//Counts a report which was read but not the answer of the pending command
+static void HIDTelemetryStray(HIDCommand Command)
+{
+	__atomic_fetch_add(&glHIDTelemetry[Command].StrayPackets, 1, __ATOMIC_RELAXED);
+}
+
+
+//Starts a sensitivity epoch when the sensitivity has changed, the first one covers all the earlier samples
+static void IMUSensitivityAppend(float AccSensMult, float GyroSensMult)
+{
+	IMUSensEpoch *lLast = &glIMUSens.Epochs[(glIMUSens.Count + IMU_SENS_EPOCHS - 1) % IMU_SENS_EPOCHS];
+	IMUSensEpoch *lEpoch = &glIMUSens.Epochs[glIMUSens.Count % IMU_SENS_EPOCHS];
+
+	if(glIMUSens.Count > 0 && lLast->AccSensMult == AccSensMult && lLast->GyroSensMult == GyroSensMult)
+		return;
+
+	__atomic_store_n(&glIMUSens.Sequence, glIMUSens.Sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	lEpoch->StartNs = (glIMUSens.Count > 0) ? GetMonotonicTimeNs() : 0;
+	lEpoch->AccSensMult = AccSensMult;
+	lEpoch->GyroSensMult = GyroSensMult;
+	glIMUSens.Count++;
+
+	__atomic_store_n(&glIMUSens.Sequence, glIMUSens.Sequence + 1, __ATOMIC_RELEASE);
+}
+
+//Finds the sensitivity of the first sample and the number of the following samples captured in the same epoch
+static UINT32 IMUSensitivityRun(const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, float *AccSensMult, float *GyroSensMult)
+{
+	UINT64 lStartNs = 0, lEndNs = ~0ULL, lTimestampNs = lIMURaw[0].TimestampNs;
+	UINT32 lSequence, lCount, lOldest, index;
+
+	//Retry while an epoch is being appended
+	do
+	{
+		while((lSequence = __atomic_load_n(&glIMUSens.Sequence, __ATOMIC_ACQUIRE)) & 1)
+			;
+
+		lCount = glIMUSens.Count;
+		lOldest = (lCount > IMU_SENS_EPOCHS) ? (lCount - IMU_SENS_EPOCHS) : 0;
+		*AccSensMult = glAccSensMult;
+		*GyroSensMult = glGyroSensMult;
+		lStartNs = 0;
+		lEndNs = ~0ULL;
+
+		for(index = lCount; index > lOldest; index--)
+		{
+			const IMUSensEpoch &lEpoch = glIMUSens.Epochs[(index - 1) % IMU_SENS_EPOCHS];
+			if(lEpoch.StartNs <= lTimestampNs || index - 1 == lOldest)
+			{
+				*AccSensMult = lEpoch.AccSensMult;
+				*GyroSensMult = lEpoch.GyroSensMult;
+				lStartNs = (index - 1 == lOldest) ? 0 : lEpoch.StartNs;
+				break;
+			}
+			lEndNs = lEpoch.StartNs;
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&glIMUSens.Sequence, __ATOMIC_RELAXED) != lSequence);
+
+	//A single epoch covers every sample
+	if(lStartNs == 0 && lEndNs == ~0ULL)
+		return NumValues;
+
+	for(index = 1; index < NumValues; index++)
+	{
+		if(lIMURaw[index].TimestampNs < lStartNs || lIMURaw[index].TimestampNs >= lEndNs)
+			break;
+	}
+	return index;
+}
+
+
 /*
   **********************************************************************************************************
  *  MODULE TYPE	:	LIBRAY API 							    *
@@ -238,6 +492,7 @@ BOOL ReadFirmwareVersion (UINT8 *pMajorVersion, UINT8 *pMinorVersion1, UINT16 *p
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 	unsigned short int sdk_ver=0, svn_ver=0;
 	
 	//Initialize the buffer
@@ -247,9 +502,11 @@ BOOL ReadFirmwareVersion (UINT8 *pMajorVersion, UINT8 *pMinorVersion1, UINT16 *p
 	g_out_packet_buf[1] = READFIRMWAREVERSION; 	/* Report Number */
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-ReadFirmwareVersion : write failed");
+		HIDTelemetryRecord(HID_CMD_READ_FIRMWARE_VERSION, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -273,13 +530,17 @@ BOOL ReadFirmwareVersion (UINT8 *pMajorVersion, UINT8 *pMinorVersion1, UINT16 *p
 				*pMinorVersion2 = sdk_ver;
 				*pMinorVersion3 = svn_ver;
 
+				HIDTelemetryRecord(HID_CMD_READ_FIRMWARE_VERSION, lTxStart, HID_OUTCOME_SUCCESS);
 				timeout = FALSE;
+			} else {
+				HIDTelemetryStray(HID_CMD_READ_FIRMWARE_VERSION);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_READ_FIRMWARE_VERSION, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}		
@@ -305,6 +566,7 @@ BOOL GetCameraUniqueID (char *UniqueID)
 	int ret = 0;
 	int i,k,tmp = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 	UniqueID[BUFFER_LENGTH] = '\0';
 	
 	//Initialize the buffer
@@ -315,9 +577,11 @@ BOOL GetCameraUniqueID (char *UniqueID)
 	g_out_packet_buf[1] = GETCAMERA_UNIQUEID; 	/* Report Number */
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-GetCameraUniqueID : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_CAMERA_UNIQUE_ID, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -337,13 +601,17 @@ BOOL GetCameraUniqueID (char *UniqueID)
 					tmp |= g_in_packet_buf[i]<<(k*8);
 				sprintf(UniqueID,"%X",tmp);
 				//printf("\n\nUnique ID is : %s\n", UniqueID);
+				HIDTelemetryRecord(HID_CMD_GET_CAMERA_UNIQUE_ID, lTxStart, HID_OUTCOME_SUCCESS);
 				timeout = FALSE;
+			} else {
+				HIDTelemetryStray(HID_CMD_GET_CAMERA_UNIQUE_ID);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_CAMERA_UNIQUE_ID, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}		
@@ -363,6 +631,11 @@ BOOL GetCameraUniqueID (char *UniqueID)
 BOOL DeinitExtensionUnit()
 {
 	int ret=0;
+
+	/* Stop the IMU capture thread before the device goes away, the ring is freed once the readers have left */
+	StopIMUCapture();
+	ReleaseIMURing();
+
 	/* Close the hid fd */
 	if(hid_fd > 0)
 	{
@@ -391,6 +664,7 @@ BOOL GetManualExposureStereo(INT32 *ExposureValue)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -400,9 +674,11 @@ BOOL GetManualExposureStereo(INT32 *ExposureValue)
 	g_out_packet_buf[2] = GET_EXPOSURE_VALUE; 	/* Report Number */
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-GetManualExposureValue_Stereo : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_EXPOSURE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -426,16 +702,21 @@ BOOL GetManualExposureStereo(INT32 *ExposureValue)
 								+ ((g_in_packet_buf[4] & 0xFF) << 8)
 								+ (g_in_packet_buf[5] & 0xFF)
 								);
+						HIDTelemetryRecord(HID_CMD_GET_EXPOSURE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[10] == GET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_GET_EXPOSURE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_GET_EXPOSURE);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_EXPOSURE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -459,6 +740,7 @@ BOOL SetManualExposureStereo(INT32 ExposureValue)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	if((ExposureValue > SEE3CAM_STEREO_EXPOSURE_MAX) || (ExposureValue < SEE3CAM_STEREO_EXPOSURE_MIN))
 	{
@@ -479,9 +761,11 @@ BOOL SetManualExposureStereo(INT32 ExposureValue)
 	g_out_packet_buf[6] = (UINT8)(ExposureValue & 0xFF);
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-SetManualExposureValue_Stereo : write failed");
+		HIDTelemetryRecord(HID_CMD_SET_EXPOSURE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -500,16 +784,21 @@ BOOL SetManualExposureStereo(INT32 ExposureValue)
 			if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
 							g_in_packet_buf[1] == SET_EXPOSURE_VALUE){
 					if(g_in_packet_buf[10] == SET_SUCCESS) {
+						HIDTelemetryRecord(HID_CMD_SET_EXPOSURE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[10] == SET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_SET_EXPOSURE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_SET_EXPOSURE);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_SET_EXPOSURE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -531,6 +820,7 @@ BOOL SetAutoExposureStereo()
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 	INT32 ExposureValue = 1;
 
 	//Initialize the buffer
@@ -546,9 +836,11 @@ BOOL SetAutoExposureStereo()
 	g_out_packet_buf[6] = (UINT8)(ExposureValue & 0xFF);
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-SetAutoExposureStereo : write failed");
+		HIDTelemetryRecord(HID_CMD_SET_AUTO_EXPOSURE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -567,16 +859,21 @@ BOOL SetAutoExposureStereo()
 			if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
 							g_in_packet_buf[1] == SET_AUTO_EXPOSURE){
 					if(g_in_packet_buf[10] == SET_SUCCESS) {
+						HIDTelemetryRecord(HID_CMD_SET_AUTO_EXPOSURE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[10] == SET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_SET_AUTO_EXPOSURE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_SET_AUTO_EXPOSURE);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_SET_AUTO_EXPOSURE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -683,6 +980,9 @@ void IMUSensitivityConfig(IMUCONFIG_TypeDef lIMUConfig)
 		}		
 	}	
 	//printf("IMUSensitivityConfig: A = %f G = %f\r\n",glAccSensMult,glGyroSensMult);
+
+	//The samples already captured keep the sensitivity of their range
+	IMUSensitivityAppend(glAccSensMult, glGyroSensMult);
 }
 
 
@@ -700,6 +1000,7 @@ BOOL GetIMUConfig(IMUCONFIG_TypeDef *lIMUConfig)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -709,9 +1010,11 @@ BOOL GetIMUConfig(IMUCONFIG_TypeDef *lIMUConfig)
 	g_out_packet_buf[2] = GET_IMU_CONFIG; 		/* Report Number */
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-GetIMUConfig : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_IMU_CONFIG, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -741,16 +1044,21 @@ BOOL GetIMUConfig(IMUCONFIG_TypeDef *lIMUConfig)
 						IMUSensitivityConfig(glIMUConfig);
 						g_IsIMUConfigured	= TRUE;
 
+						HIDTelemetryRecord(HID_CMD_GET_IMU_CONFIG, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[25] == GET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_GET_IMU_CONFIG, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_GET_IMU_CONFIG);
 			}
 		}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_IMU_CONFIG, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -763,6 +1071,7 @@ BOOL GetRevision(TaraRev *eRev)
 {
 	BOOL timeout = TRUE;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 	UINT8 uStatus = 0;
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
 
@@ -771,11 +1080,13 @@ BOOL GetRevision(TaraRev *eRev)
 	g_out_packet_buf[2] = REVISIONID;
 
 
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 
 	if (ret < 0) 
 	{
 		perror("eCAMFwSw: GetRevision: Write File Failed\r\n");
+		HIDTelemetryRecord(HID_CMD_GET_REVISION, lTxStart, HID_OUTCOME_WRITE_ERROR);
 	    return FALSE;
     }
  	else 
@@ -799,23 +1110,32 @@ BOOL GetRevision(TaraRev *eRev)
 		{
 	       	//PrintMessage(L"eCAMFwSw: GetRevision: Revision = %d \r\n", g_in_packet_buf[3]);
 
-			if ( g_in_packet_buf[3] == 1)
+			if(g_in_packet_buf[0] == CAMERACONTROL_STEREO && g_in_packet_buf[1] == REVISIONID)
 			{
-	        	*eRev = g_eTaraRev=  REVISION_B;
-				uStatus = TRUE;
-		        timeout = FALSE;
+				if ( g_in_packet_buf[3] == 1)
+				{
+		        	*eRev = g_eTaraRev=  REVISION_B;
+					uStatus = TRUE;
+			        timeout = FALSE;
+				}
+				else
+				{
+		        	*eRev = g_eTaraRev = REVISION_A;
+					uStatus = TRUE;
+			        timeout = FALSE;
+				}
+				HIDTelemetryRecord(HID_CMD_GET_REVISION, lTxStart, HID_OUTCOME_SUCCESS);
 			}
 			else
 			{
-	        	*eRev = g_eTaraRev = REVISION_A;
-				uStatus = TRUE;
-		        timeout = FALSE;
+				HIDTelemetryStray(HID_CMD_GET_REVISION);
 			}
         }
        	end = GetTickCount();
-        if(end - start > TIMEOUT)
+        if(timeout && (end - start > TIMEOUT))
        	{
        		printf("GetRevision(): Timeout occurred\n");
+			HIDTelemetryRecord(HID_CMD_GET_REVISION, lTxStart, HID_OUTCOME_TIMEOUT);
 	        timeout = FALSE;
 	        return FALSE;
         }
@@ -838,6 +1158,7 @@ BOOL SetIMUConfig(IMUCONFIG_TypeDef lIMUConfig)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer
 	memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
@@ -935,9 +1256,11 @@ BOOL SetIMUConfig(IMUCONFIG_TypeDef lIMUConfig)
 
 SKIP_IMU_CONFIG_ACC_GYRO_DISABLE:
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-SetIMUConfig : write failed");
+		HIDTelemetryRecord(HID_CMD_SET_IMU_CONFIG, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -959,16 +1282,21 @@ SKIP_IMU_CONFIG_ACC_GYRO_DISABLE:
 						glIMUConfig			= lIMUConfig;
 						IMUSensitivityConfig(glIMUConfig);
 						g_IsIMUConfigured	= TRUE;
+						HIDTelemetryRecord(HID_CMD_SET_IMU_CONFIG, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[25] == SET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_SET_IMU_CONFIG, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_SET_IMU_CONFIG);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_SET_IMU_CONFIG, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -991,6 +1319,7 @@ BOOL ControlIMUCapture(IMUDATAINPUT_TypeDef *lIMUInput)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 	IMUCONFIG_TypeDef lIMUConfig;
 
 	if(glIMUConfig.IMU_MODE == IMU_ACC_GYRO_DISABLE)
@@ -1019,9 +1348,11 @@ BOOL ControlIMUCapture(IMUDATAINPUT_TypeDef *lIMUInput)
 	g_out_packet_buf[8] = 0x00;//(INT8)(lIMUInput.IMU_NUM_OF_VALUES & 0xFF);
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-ControlIMUCapture : write failed");
+		HIDTelemetryRecord(HID_CMD_CONTROL_IMU_CAPTURE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1049,18 +1380,23 @@ BOOL ControlIMUCapture(IMUDATAINPUT_TypeDef *lIMUInput)
 							}
 							Sleep(10);
 						}
+						HIDTelemetryRecord(HID_CMD_CONTROL_IMU_CAPTURE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[19] == SET_FAIL) {
 						glIMUInput.IMU_UPDATE_MODE = lIMUInput->IMU_UPDATE_MODE = IMU_CONT_UPDT_DIS;	
 						glIMUInput.IMU_NUM_OF_VALUES = lIMUInput->IMU_NUM_OF_VALUES = IMU_AXES_VALUES_MIN;
+						HIDTelemetryRecord(HID_CMD_CONTROL_IMU_CAPTURE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_CONTROL_IMU_CAPTURE);
 			}
 		}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_CONTROL_IMU_CAPTURE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1085,6 +1421,7 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 	int ret = 0;
 	unsigned int start, end = 0;
 
+	UINT64 lTxStart = 0;
 	UINT16 lIDofValues = 0;
 	IMUDATAOUTPUT_TypeDef *lIMUAxesInitAdd = lIMUAxes;
 
@@ -1094,15 +1431,23 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 		return FALSE;
 	}
 
+	if(__atomic_load_n(&glIMUCaptureRunning, __ATOMIC_ACQUIRE))
+	{
+		printf("GetIMUValueBuffer: IMU values are being read by StartIMUCapture\r\n");
+		return FALSE;
+	}
+
 	//Initialize the buffer
 	memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
 	g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
 	g_out_packet_buf[2] = SEND_IMU_VAL_BUFF;
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-GetIMUValueBuffer : write failed");
+		HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1110,9 +1455,10 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 
 	for(lIDofValues = 0;((glIMUInput.IMU_UPDATE_MODE != IMU_CONT_UPDT_DIS) || (glIMUInput.IMU_NUM_OF_VALUES >= IMU_AXES_VALUES_MIN));)
 	{
-		/* Read the status from the device */
+		/* Read the status from the device, every report is tracked as one transaction */
 		timeout = TRUE;
 		start = GetTickCount();
+		lTxStart = GetMonotonicTimeNs();
 		while(timeout)
 		{
 			/* Get a report from the device */
@@ -1128,6 +1474,7 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 						if(g_in_packet_buf[48] == SET_SUCCESS) {
 
 							lIMUAxes->IMU_VALUE_ID = ++lIDofValues;
+							lIMUAxes->TimestampNs = GetMonotonicTimeNs();
 
 							if(g_in_packet_buf[4] == IMU_ACC_VAL)
 							{
@@ -1161,16 +1508,21 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 
 							//Setting the event to tell the application the buffer is full.
 							pthread_mutex_unlock(IMUDataReadyEvent);
+							HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_SUCCESS);
 							timeout = FALSE;
 						} else if(g_in_packet_buf[48] == SET_FAIL) {
+							HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_FAIL);
 							return FALSE;
 						}
+				} else {
+					HIDTelemetryStray(HID_CMD_IMU_VALUE_BUFFER);
 				}
 			}
 			end = GetTickCount();
-			if((end - start) > (2500))
+			if(timeout && (end - start > 2500))
 			{
 				printf("%s(): Timeout occurred\n", __func__);
+				HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_TIMEOUT);
 				timeout = FALSE;
 				return FALSE;
 			}
@@ -1185,146 +1537,1303 @@ BOOL GetIMUValueBuffer(pthread_mutex_t *IMUDataReadyEvent, IMUDATAOUTPUT_TypeDef
 }
 
 
-/*
-  **********************************************************************************************************
- *  MODULE TYPE	:	LIBRAY API 					*
- *  Name	:	StereoCalibRead					*
- *  Parameter1	:	unsigned char (**in_buffer)			*
- *  Parameter2	:	unsigned char (**ex_buffer)			*
- *  Parameter3	:	int *intFileLength				*
- *  Parameter4	:	int *extFileLength				*
- *  Returns	:	BOOL (TRUE or FALSE)				*
- *  Description	:  	Sends the extension unit command to read the calibration files stored in the flash. *
-  **********************************************************************************************************
-*/
-BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *intFileLength, int *extFileLength)
+//Decodes the raw axes of an IMU report, the axes missing in the report keep their last value
+static void DecodeIMUReport(const unsigned char *Report, IMURAWSAMPLE_TypeDef *lIMURaw)
 {
-	BOOL timeout = TRUE;
-	int ret = 0;
-	unsigned int start, end = 0;
+	if(Report[4] == IMU_ACC_VAL)
+	{
+		lIMURaw->accX = (INT16)((Report[6]) | (Report[5]<<8));
+		lIMURaw->accY = (INT16)((Report[8]) | (Report[7]<<8));
+		lIMURaw->accZ = (INT16)((Report[10]) | (Report[9]<<8));
+	}
 
-	int lIntFileLength = 0,lExtFileLength = 0;
-	int lIntPckCnt = 0,lExtPckCnt = 0;
-	int lLoopCount = 1;
-	
-	
-	//1. Issue a Read request - Intrinsic file
-	memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
+	if(Report[15] == IMU_GYRO_VAL)
+	{
+		lIMURaw->gyroX = (INT16)((Report[17]) | (Report[16]<<8));
+		lIMURaw->gyroY = (INT16)((Report[19]) | (Report[18]<<8));
+		lIMURaw->gyroZ = (INT16)((Report[21]) | (Report[20]<<8));
+	}
+}
 
-	g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
-	g_out_packet_buf[2] = READ_CALIB_REQUEST;
-	g_out_packet_buf[3] = INTRINSIC_FILEID;
+//Consumer handed out for the current subscription of a ring, IMU_CONSUMER_DEFAULT for the default ring
+static UINT32 IMUConsumerId(IMURing *Ring, UINT32 Index)
+{
+	return (__atomic_load_n(&Ring->Generation, __ATOMIC_SEQ_CST) << IMU_CONSUMER_SHIFT) | Index;
+}
 
-	/* Send a Report to the Device */
-	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
-	if (ret < 0) {
-		perror("xunit-StereoCalibRead : write failed");
+//Leaves a pop entered with IMURingEnter
+static void IMURingLeave(IMURing *Ring)
+{
+	__atomic_fetch_sub(&Ring->Readers, 1, __ATOMIC_RELEASE);
+	__atomic_fetch_sub(&glIMURingReaders, 1, __ATOMIC_RELEASE);
+}
+
+//Enters a pop on the ring of a consumer. Fails while the rings are being reset or freed, and for a subscription
+//which has been released: its slot may already belong to another subscriber.
+static IMURing* IMURingEnter(UINT32 Consumer)
+{
+	UINT32 lIndex = IMU_CONSUMER_INDEX(Consumer);
+	IMURing *lRing;
+
+	if(lIndex >= IMU_RING_CONSUMERS)
+		return NULL;
+	lRing = &glIMURings[lIndex];
+
+	__atomic_fetch_add(&glIMURingReaders, 1, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&lRing->Readers, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&glIMURingClosed, __ATOMIC_SEQ_CST) || IMUConsumerId(lRing, lIndex) != Consumer ||
+		lRing->Samples == NULL)
+	{
+		IMURingLeave(lRing);
+		return NULL;
+	}
+	return lRing;
+}
+
+//Closes the gate and waits until the readers have left. The capture must be stopped, so that the
+//readers blocked in IMURingWait see the stop event or the end of their ring and leave.
+static void IMURingExclude(void)
+{
+	__atomic_store_n(&glIMURingClosed, 1, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&glIMURingReaders, __ATOMIC_ACQUIRE) != 0)
+		usleep(1000);
+}
+
+//Opens the gate closed by IMURingExclude
+static void IMURingAdmit(void)
+{
+	__atomic_store_n(&glIMURingClosed, 0, __ATOMIC_SEQ_CST);
+}
+
+//Allocates the samples and the wakeup event of a ring, both are kept until ReleaseIMURing
+static BOOL IMURingAlloc(IMURing *Ring)
+{
+	if(Ring->Samples != NULL)
+		return TRUE;
+
+	Ring->DataEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(Ring->DataEvent < 0)
+	{
+		perror("xunit-IMURingAlloc : eventfd failed");
 		return FALSE;
-	} else {
-		//printf("%s(): wrote %d bytes\n", __func__,ret);
 	}
 
-	/* Read the status from the device */
-	start = GetTickCount();
-	while(timeout)
+	Ring->Samples = (IMURAWSAMPLE_TypeDef*)malloc(IMU_RING_CAPACITY * sizeof(IMURAWSAMPLE_TypeDef));
+	if(Ring->Samples == NULL)
 	{
-		/* Get a report from the device */
-		ret = read(hid_fd, g_in_packet_buf, BUFFER_LENGTH);
-		if (ret < 0) {
-			//perror("read");
-		} else {
-			//printf("%s(): read %d bytes:\n", __func__,ret);
-			if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
-				g_in_packet_buf[1] == READ_CALIB_REQUEST) {
-					if(g_in_packet_buf[15] == SEE3CAM_STEREO_HID_SUCCESS) {
+		printf("IMURingAlloc: Memory allocation for the IMU ring failed\r\n");
+		close(Ring->DataEvent);
+		return FALSE;
+	}
 
-						lIntFileLength = (UINT32)(((g_in_packet_buf[7] << 8 ) & 0xFF00) | (g_in_packet_buf[8] & 0xFF));
+	return TRUE;
+}
 
-						lIntPckCnt = lIntFileLength / PCK_SIZE;
-						if(lIntFileLength % PCK_SIZE != 0)
-							lIntPckCnt++;
-						timeout = FALSE;
-					} else if(g_in_packet_buf[15] == SEE3CAM_STEREO_HID_FAIL) {
-						printf("StereoCalibRead: Return Status Failed 1\r\n");
-						return FALSE;
-					}
-			}
-		}
-		end = GetTickCount();
-		if(end - start > CALIB_TIMEOUT)
-		{
-			printf("%s(): Timeout occurred\n", __func__);
-			timeout = FALSE;
-			return FALSE;
-		}
+//Empties a ring which is not fed and clears its pending wakeup
+static void IMURingReset(IMURing *Ring, BOOL Ended)
+{
+	UINT64 lSignal = 0;
+
+	if(read(Ring->DataEvent, &lSignal, sizeof(lSignal)) < 0 && errno != EAGAIN)
+		perror("xunit-IMURingReset : eventfd read failed");
+
+	Ring->Head = Ring->Tail = 0;
+	Ring->Waiting = Ring->Threshold = 0;
+	Ring->Overruns = 0;
+	__atomic_store_n(&Ring->Ended, Ended, __ATOMIC_SEQ_CST);
+}
+
+//Frees the IMU rings and their events once no reader is inside a pop, the capture thread must not be running.
+//The subscriptions end with the rings.
+static void ReleaseIMURing(void)
+{
+	IMURing *lRing;
+	int index;
+
+	pthread_mutex_lock(&glIMURingLock);
+	IMURingExclude();
+
+	if(glIMUStopEvent >= 0)
+		close(glIMUStopEvent);
+	glIMUStopEvent = -1;
+
+	for(index = 0; index < IMU_RING_CONSUMERS; index++)
+	{
+		lRing = &glIMURings[index];
+		lRing->Active = FALSE;
+		if(lRing->Samples == NULL)
+			continue;
+
+		close(lRing->DataEvent);
+		free(lRing->Samples);
+		lRing->Samples = NULL;
 	}
-	Sleep(10);
-	//Allocating the in buffer
-	*in_buffer = (unsigned char*)calloc(lIntPckCnt * PCK_SIZE, sizeof(unsigned char));
-	*intFileLength = lIntFileLength;
-	
-	if(*in_buffer == NULL)	
+
+	IMURingAdmit();
+	pthread_mutex_unlock(&glIMURingLock);
+}
+
+//Wakes the consumer of a ring when it is blocked and enough samples are available
+static void IMURingNotify(IMURing *Ring, UINT32 Head)
+{
+	UINT64 lSignal = 1;
+	UINT32 lTail;
+
+	if(!__atomic_load_n(&Ring->Waiting, __ATOMIC_SEQ_CST))
+		return;
+
+	lTail = __atomic_load_n(&Ring->Tail, __ATOMIC_RELAXED);
+	if((Head - lTail) < __atomic_load_n(&Ring->Threshold, __ATOMIC_RELAXED) &&
+		!__atomic_load_n(&Ring->Ended, __ATOMIC_RELAXED))
+		return;
+
+	if(__atomic_exchange_n(&Ring->Waiting, 0, __ATOMIC_SEQ_CST))
 	{
-		printf("Memory Allocation failed Intrinsic file\n");
-		return FALSE;
+		if(write(Ring->DataEvent, &lSignal, sizeof(lSignal)) < 0)
+			perror("xunit-IMUCaptureThread : eventfd write failed");
 	}
-	
+}
 
-	//2.Issue a read data - Intrinsic file
-	Sleep(10);
-	
-	for(lLoopCount = 1; lLoopCount < lIntPckCnt; )
+//Copies a burst of samples to a ring and publishes them at once.
+//The newest samples are dropped when the consumer has fallen a full ring behind.
+static void IMURingPush(IMURing *Ring, const IMURAWSAMPLE_TypeDef *Burst, UINT32 Count)
+{
+	UINT32 lHead = Ring->Head, lFree, lFirst;
+
+	//The tail only moves forward, so the room seen here can only grow until the copy is done
+	lFree = IMU_RING_CAPACITY - (lHead - __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE));
+	if(Count > lFree)
 	{
-		memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
-		g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
-		g_out_packet_buf[2] = READ_CALIB_DATA;
-		g_out_packet_buf[3] = INTRINSIC_FILEID;
+		__atomic_fetch_add(&Ring->Overruns, Count - lFree, __ATOMIC_RELAXED);
+		Count = lFree;
+	}
 
-		/* Send a Report to the Device */
-		ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
-		if (ret < 0) {
-			perror("write");
-			return FALSE;
-		} else {
-			//printf("%s(): wrote %d bytes\n", __func__,ret);
-		}
+	lFirst = IMU_RING_CAPACITY - (lHead & IMU_RING_MASK);
+	if(lFirst > Count)
+		lFirst = Count;
+	memcpy(&Ring->Samples[lHead & IMU_RING_MASK], Burst, lFirst * sizeof(IMURAWSAMPLE_TypeDef));
+	if(Count > lFirst)
+		memcpy(Ring->Samples, Burst + lFirst, (Count - lFirst) * sizeof(IMURAWSAMPLE_TypeDef));
 
-		/* Read the status from the device */
-		timeout = TRUE;
-		start = GetTickCount();
-		while(timeout)
+	lHead += Count;
+	__atomic_store_n(&Ring->Head, lHead, __ATOMIC_SEQ_CST);
+	IMURingNotify(Ring, lHead);
+}
+
+//Copies a burst to every active ring, or marks them ended. glIMUPushing is held meanwhile,
+//UnsubscribeIMU waits for it so that a ring is never reset while it is fed.
+static void IMURingFanOut(const IMURAWSAMPLE_TypeDef *Burst, UINT32 Count, BOOL Ended)
+{
+	IMURing *lRing;
+	int index;
+
+	__atomic_store_n(&glIMUPushing, 1, __ATOMIC_SEQ_CST);
+	for(index = 0; index < IMU_RING_CONSUMERS; index++)
+	{
+		lRing = &glIMURings[index];
+		if(!__atomic_load_n(&lRing->Active, __ATOMIC_SEQ_CST))
+			continue;
+
+		if(Ended)
 		{
-			/* Get a report from the device */
-			ret = read(hid_fd, g_in_packet_buf, BUFFER_LENGTH);
-			if (ret < 0) {
-				//perror("read");
-			} else {
-				//printf("%s(): read %d bytes:\n", __func__,ret);
-				if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
-					g_in_packet_buf[1] == READ_CALIB_DATA) {
-						if(g_in_packet_buf[7] == SEE3CAM_STEREO_HID_SUCCESS) {
+			__atomic_store_n(&lRing->Ended, TRUE, __ATOMIC_SEQ_CST);
+			IMURingNotify(lRing, lRing->Head);
+		}
+		else
+			IMURingPush(lRing, Burst, Count);
+	}
+	__atomic_store_n(&glIMUPushing, 0, __ATOMIC_RELEASE);
+}
 
-							lLoopCount = (UINT32)(((g_in_packet_buf[5] << 8 ) & 0xFF00) | (g_in_packet_buf[6] & 0xFF));		
-							
-							if(lLoopCount == lIntPckCnt)
-							{
-								memcpy(*in_buffer + ((lLoopCount - 1)*PCK_SIZE),&g_in_packet_buf[8],(lIntFileLength % PCK_SIZE));
-								//printf("StereoCalibRead: Write File Passed 2\r\n");
-							}
-							else
-							{
-								memcpy(*in_buffer + ((lLoopCount - 1)*PCK_SIZE),&g_in_packet_buf[8],PCK_SIZE);
-							}
-							timeout = FALSE;
-						} else if(g_in_packet_buf[7] == SEE3CAM_STEREO_HID_FAIL) {
-							return FALSE;
-						}
+//Output data rate configured with SetIMUConfig, with the gyroscope rates of revision A
+static double IMUConfiguredOdrHz(void)
+{
+	static const double lOdrRevA[] = { 14.9, 59.9, 119, 238, 476, 952 };
+	static const double lOdrRevB[] = { 12.5, 26, 52, 104, 208, 416, 833, 1666 };
+	int lOdr = glIMUConfig.IMU_ODR_CONFIG;
+
+	if(g_eTaraRev == REVISION_A && lOdr >= IMU_ODR_10_14_9HZ && lOdr <= IMU_ODR_952HZ)
+		return lOdrRevA[lOdr - IMU_ODR_10_14_9HZ];
+	if(g_eTaraRev == REVISION_B && lOdr >= IMU_ODR_12_5HZ && lOdr <= IMU_ODR_1666HZ)
+		return lOdrRevB[lOdr - IMU_ODR_12_5HZ];
+
+	return IMU_TIMING_FALLBACK_HZ;
+}
+
+//Median of the intervals of the first wakeups, an early or a late one does not bias it
+static double IMUTimingSeedMedian(void)
+{
+	double lSorted[IMU_TIMING_SEED_WAKEUPS], lValue;
+	int index, pos;
+
+	for(index = 0; index < IMU_TIMING_SEED_WAKEUPS; index++)
+	{
+		lValue = glIMUTiming.SeedUs[index];
+		for(pos = index; pos > 0 && lSorted[pos - 1] > lValue; pos--)
+			lSorted[pos] = lSorted[pos - 1];
+		lSorted[pos] = lValue;
+	}
+
+	return lSorted[IMU_TIMING_SEED_WAKEUPS / 2];
+}
+
+//Updates the interval and jitter estimates with Count samples read at the wakeup at WakeNs.
+//The interval is measured between two wakeups over the samples of the second one, each sample weighs the same.
+//The estimate is seeded with the median of the first IMU_TIMING_SEED_WAKEUPS intervals, then the intervals
+//IMU_TIMING_GAP_FACTOR times longer (stalls) or shorter (a wakeup catching up) than the estimate are not measured.
+//Returns the spacing of the timestamps of the samples, which fits them after the previous wakeup. It is the configured
+//ODR period until the estimate is seeded, and never 0 so that the timestamps keep increasing.
+static UINT64 IMUTimingUpdate(UINT64 WakeNs, UINT32 Count)
+{
+	IMUTIMING_TypeDef *lTiming = &glIMUTiming.Timing;
+	double lIntervalUs, lSpacingUs, lAlpha = (double)Count / (1 << IMU_TIMING_EWMA_SHIFT);
+	UINT64 lSpacingNs;
+
+	__atomic_store_n(&glIMUTiming.Sequence, glIMUTiming.Sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if(lAlpha > 1.0)
+		lAlpha = 1.0;
+
+	lSpacingUs = (lTiming->IntervalUs > 0) ? lTiming->IntervalUs : (1000000.0 / IMUConfiguredOdrHz());
+	if(lTiming->SampleCount > 0)
+	{
+		lIntervalUs = (WakeNs - lTiming->LastTimestampNs) / (1000.0 * Count);
+		if(lTiming->IntervalUs == 0)
+		{
+			glIMUTiming.SeedUs[glIMUTiming.SeedCount++] = lIntervalUs;
+			if(glIMUTiming.SeedCount == IMU_TIMING_SEED_WAKEUPS)
+				lTiming->IntervalUs = IMUTimingSeedMedian();
+		}
+		else if(lIntervalUs < IMU_TIMING_GAP_FACTOR * lTiming->IntervalUs &&
+			lIntervalUs * IMU_TIMING_GAP_FACTOR > lTiming->IntervalUs)
+		{
+			lTiming->JitterUs += lAlpha * (fabs(lIntervalUs - lTiming->IntervalUs) - lTiming->JitterUs);
+			lTiming->IntervalUs += lAlpha * (lIntervalUs - lTiming->IntervalUs);
+		}
+		lTiming->OdrHz = (lTiming->IntervalUs > 0) ? (1000000.0 / lTiming->IntervalUs) : 0;
+
+		//A late wakeup spreads the samples at the estimated interval, an early one between the two wakeups
+		if(lIntervalUs < lSpacingUs)
+			lSpacingUs = lIntervalUs;
+	}
+	lTiming->LastTimestampNs = WakeNs;
+	lTiming->SampleCount += Count;
+
+	__atomic_store_n(&glIMUTiming.Sequence, glIMUTiming.Sequence + 1, __ATOMIC_RELEASE);
+
+	lSpacingNs = (UINT64)(lSpacingUs * 1000.0);
+	return (lSpacingNs > 0) ? lSpacingNs : 1;
+}
+
+//Producer thread, reads the IMU reports and fans the samples out to the rings
+static void* IMUCaptureThread(void *lpParameter)
+{
+	unsigned char lReport[BUFFER_LENGTH];
+	IMURAWSAMPLE_TypeDef lIMURaw, lBurst[IMU_CAPTURE_BURST];
+	struct pollfd lPollFds[2];
+	UINT64 lTxStart = GetMonotonicTimeNs(), lWakeNs, lSpacingNs;
+	UINT32 lCount, index;
+	BOOL lRunning = TRUE, lAnswered = FALSE;
+	int ret = 0;
+
+	memset(&lIMURaw, 0x00, sizeof(lIMURaw));
+
+	lPollFds[0].fd = hid_imu;
+	lPollFds[0].events = POLLIN;
+	lPollFds[1].fd = glIMUStopEvent;
+	lPollFds[1].events = POLLIN;
+
+	while(lRunning)
+	{
+		ret = poll(lPollFds, 2, 2500);
+		if(ret < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			perror("xunit-IMUCaptureThread : poll failed");
+			break;
+		}
+		else if(ret == 0)
+		{
+			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_TIMEOUT);
+			lTxStart = GetMonotonicTimeNs();
+			continue;
+		}
+
+		if(lPollFds[1].revents & POLLIN)
+			break;
+
+		if(lPollFds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+		{
+			printf("%s(): IMU device is not available\n", __func__);
+			break;
+		}
+
+		//Drain the reports queued by the driver before publishing them, they are timed together at this wakeup
+		lWakeNs = GetMonotonicTimeNs();
+		lCount = 0;
+		while(lCount < IMU_CAPTURE_BURST && (ret = read(hid_imu, lReport, BUFFER_LENGTH)) > 0)
+		{
+			if(lReport[0] != CAMERA_CONTROL_STEREO || lReport[1] != SEND_IMU_VAL_BUFF)
+			{
+				HIDTelemetryStray(HID_CMD_IMU_VALUE_BUFFER);
+				continue;
+			}
+
+			if(lReport[48] == SET_FAIL)
+			{
+				HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lAnswered ? lWakeNs : lTxStart, HID_OUTCOME_FAIL);
+				lRunning = FALSE;
+				break;
+			}
+			else if(lReport[48] != SET_SUCCESS)
+				continue;
+
+			//Only the first report answers the request, the next ones are the stream and their gaps are not latencies
+			if(!lAnswered)
+			{
+				HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_SUCCESS);
+				lAnswered = TRUE;
+			}
+
+			DecodeIMUReport(lReport, &lIMURaw);
+			lBurst[lCount++] = lIMURaw;
+
+			if(glIMUInput.IMU_UPDATE_MODE == IMU_CONT_UPDT_DIS)
+			{
+				if(glIMUInput.IMU_NUM_OF_VALUES > 0)
+					glIMUInput.IMU_NUM_OF_VALUES--;
+				if(glIMUInput.IMU_NUM_OF_VALUES < IMU_AXES_VALUES_MIN)
+				{
+					lRunning = FALSE;
+					break;
+				}
+			}
+		}
+
+		if(ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			perror("xunit-IMUCaptureThread : read failed");
+			lRunning = FALSE;
+		}
+
+		//The newest report arrived by the wakeup, the earlier ones were queued and are dated back by the interval.
+		//Samples become visible to the consumers once per wakeup, not once per report.
+		if(lCount > 0)
+		{
+			lSpacingNs = IMUTimingUpdate(lWakeNs, lCount);
+			for(index = 0; index < lCount; index++)
+				lBurst[index].TimestampNs = lWakeNs - (lCount - 1 - index) * lSpacingNs;
+
+			IMURingFanOut(lBurst, lCount, FALSE);
+		}
+	}
+
+	//A ring subscribed from now on sees that the capture is not running and ends by itself
+	__atomic_store_n(&glIMUCaptureRunning, FALSE, __ATOMIC_SEQ_CST);
+	IMURingFanOut(NULL, 0, TRUE);
+
+	return NULL;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	StartIMUCapture					*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Requests the IMU values from the device and starts a thread which stores	*
+ *			them in library owned rings of IMU_RING_CAPACITY samples, the default	*
+ *			ring and one per subscription. The samples are read back with		*
+ *			PopIMUValueBatch, or with PopIMURawBatchFrom by a subscriber.		*
+  **********************************************************************************************************
+*/
+BOOL StartIMUCapture(void)
+{
+	int ret = 0, index;
+	UINT64 lTxStart = 0, lSignal = 0;
+	IMURing *lRing;
+
+	if(glIMUConfig.IMU_MODE == IMU_ACC_GYRO_DISABLE)
+	{
+		printf("StartIMUCapture: IMU Disabled, Enable using SetIMUConfig\r\n");
+		return FALSE;
+	}
+
+	if(__atomic_load_n(&glIMUCaptureRunning, __ATOMIC_ACQUIRE))
+	{
+		printf("StartIMUCapture: IMU capture is already running\r\n");
+		return FALSE;
+	}
+
+	//A capture thread which ended by itself is joined first
+	if(!StopIMUCapture())
+		return FALSE;
+
+	if(hid_imu < 0)
+	{
+		printf("StartIMUCapture: IMU device is not available\r\n");
+		return FALSE;
+	}
+
+	//The rings and their events are kept from a previous capture, a reader may still be inside a pop
+	pthread_mutex_lock(&glIMURingLock);
+	if(!IMURingAlloc(&glIMURings[IMU_CONSUMER_DEFAULT]))
+	{
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+	glIMURings[IMU_CONSUMER_DEFAULT].Active = TRUE;
+
+	if(glIMUStopEvent < 0)
+		glIMUStopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(glIMUStopEvent < 0)
+	{
+		perror("xunit-StartIMUCapture : eventfd failed");
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	//Initialize the buffer
+	memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
+	g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
+	g_out_packet_buf[2] = SEND_IMU_VAL_BUFF;
+
+	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
+	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
+	if (ret < 0) {
+		perror("xunit-StartIMUCapture : write failed");
+		HIDTelemetryRecord(HID_CMD_IMU_VALUE_BUFFER, lTxStart, HID_OUTCOME_WRITE_ERROR);
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	//Samples left over from a previous capture are discarded once the readers have left,
+	//the stop event of the previous capture is cleared
+	IMURingExclude();
+	if(read(glIMUStopEvent, &lSignal, sizeof(lSignal)) < 0 && errno != EAGAIN)
+		perror("xunit-StartIMUCapture : eventfd read failed");
+
+	for(index = 0; index < IMU_RING_CONSUMERS; index++)
+	{
+		lRing = &glIMURings[index];
+		if(lRing->Active)
+			IMURingReset(lRing, FALSE);
+	}
+
+	__atomic_store_n(&glIMUTiming.Sequence, glIMUTiming.Sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memset(&glIMUTiming.Timing, 0x00, sizeof(glIMUTiming.Timing));
+	glIMUTiming.SeedCount = 0;
+	__atomic_store_n(&glIMUTiming.Sequence, glIMUTiming.Sequence + 1, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&glIMUCaptureRunning, TRUE, __ATOMIC_SEQ_CST);
+	if(pthread_create(&glIMUCaptureThread, NULL, IMUCaptureThread, NULL) != 0)
+	{
+		printf("StartIMUCapture: IMU capture thread creation failed\r\n");
+		__atomic_store_n(&glIMUCaptureRunning, FALSE, __ATOMIC_SEQ_CST);
+		IMURingFanOut(NULL, 0, TRUE);
+		IMURingAdmit();
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	IMURingAdmit();
+	glIMUCaptureJoinable = TRUE;
+	pthread_mutex_unlock(&glIMURingLock);
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	StopIMUCapture					*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Signals the IMU capture thread to stop and waits for it to exit, also	*
+ *			when it has ended by itself (device error, requested count read).	*
+ *			The consumers blocked in a pop are woken up, the samples already	*
+ *			in the rings can still be read until the next StartIMUCapture.	*
+  **********************************************************************************************************
+*/
+BOOL StopIMUCapture(void)
+{
+	UINT64 lSignal = 1;
+
+	if(!glIMUCaptureJoinable)
+		return TRUE;
+
+	//The stop event stays signalled, so every later wait returns at once
+	if(write(glIMUStopEvent, &lSignal, sizeof(lSignal)) < 0)
+	{
+		perror("xunit-StopIMUCapture : eventfd write failed");
+		return FALSE;
+	}
+
+	pthread_join(glIMUCaptureThread, NULL);
+	glIMUCaptureJoinable = FALSE;
+
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	SubscribeIMU					*
+ *  Parameter1	:	UINT32 (*Consumer)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Claims a ring of its own which the capture thread feeds with every	*
+ *			IMU sample from now on, read with PopIMURawBatchFrom(Consumer).	*
+ *			Each subscriber has its own tail, wakeup and overruns, so it does	*
+ *			not take samples from the default ring or from other subscribers.	*
+ *			The capture thread does not wait for a subscriber which falls		*
+ *			IMU_RING_CAPACITY samples behind, the samples it misses are counted	*
+ *			in the Overruns of GetIMUConsumerStatus.			*
+ *			At most IMU_RING_CONSUMERS - 1 subscriptions are held at a time.	*
+  **********************************************************************************************************
+*/
+BOOL SubscribeIMU(UINT32 *Consumer)
+{
+	IMURing *lRing = NULL;
+	int index;
+
+	if(Consumer == NULL)
+		return FALSE;
+
+	//A ring whose previous subscriber is still inside a pop is not given out
+	pthread_mutex_lock(&glIMURingLock);
+	for(index = 0; index < IMU_RING_CONSUMERS; index++)
+	{
+		if(index != IMU_CONSUMER_DEFAULT && !glIMURings[index].Active &&
+			__atomic_load_n(&glIMURings[index].Readers, __ATOMIC_SEQ_CST) == 0)
+		{
+			lRing = &glIMURings[index];
+			break;
+		}
+	}
+
+	if(lRing == NULL)
+	{
+		printf("SubscribeIMU: All the IMU rings are in use\r\n");
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	if(!IMURingAlloc(lRing))
+	{
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	//The capture thread feeds the ring from its next wakeup. When it has already ended,
+	//the ring is ended here so that its reader does not wait for samples which never come.
+	IMURingReset(lRing, FALSE);
+	__atomic_store_n(&lRing->Active, TRUE, __ATOMIC_SEQ_CST);
+	if(!__atomic_load_n(&glIMUCaptureRunning, __ATOMIC_SEQ_CST))
+		__atomic_store_n(&lRing->Ended, TRUE, __ATOMIC_SEQ_CST);
+
+	*Consumer = IMUConsumerId(lRing, index);
+	pthread_mutex_unlock(&glIMURingLock);
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	UnsubscribeIMU					*
+ *  Parameter1	:	UINT32 (Consumer)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Stops feeding a ring claimed with SubscribeIMU. A reader blocked on	*
+ *			the ring is woken up and the later pops of Consumer fail. The ring	*
+ *			is given to a new subscriber only once no reader is inside a pop.	*
+  **********************************************************************************************************
+*/
+BOOL UnsubscribeIMU(UINT32 Consumer)
+{
+	UINT64 lSignal = 1;
+	UINT32 lIndex = IMU_CONSUMER_INDEX(Consumer);
+	IMURing *lRing;
+
+	if(lIndex >= IMU_RING_CONSUMERS || lIndex == IMU_CONSUMER_DEFAULT)
+		return FALSE;
+
+	pthread_mutex_lock(&glIMURingLock);
+	lRing = &glIMURings[lIndex];
+	if(!lRing->Active || IMUConsumerId(lRing, lIndex) != Consumer)
+	{
+		pthread_mutex_unlock(&glIMURingLock);
+		return FALSE;
+	}
+
+	//The new generation refuses the pops of Consumer, and once the capture thread is out of its copy
+	//it no longer sees the ring
+	__atomic_store_n(&lRing->Active, FALSE, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&lRing->Generation, 1, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&glIMUPushing, __ATOMIC_SEQ_CST))
+		usleep(100);
+
+	__atomic_store_n(&lRing->Ended, TRUE, __ATOMIC_SEQ_CST);
+	if(write(lRing->DataEvent, &lSignal, sizeof(lSignal)) < 0)
+		perror("xunit-UnsubscribeIMU : eventfd write failed");
+
+	pthread_mutex_unlock(&glIMURingLock);
+	return TRUE;
+}
+
+
+//Waits until MaxValues samples are in the ring, the timeout expires or the capture stops.
+//Returns the number of samples which can be read, capped to MaxValues.
+static UINT32 IMURingWait(IMURing *Ring, UINT32 MaxValues, INT32 TimeoutMs)
+{
+	struct pollfd lPollFds[2];
+	UINT64 lDeadline = 0, lNow = 0, lSignal = 0;
+	UINT32 lHead, lTail = Ring->Tail, lCount;
+	int lWaitMs, ret;
+
+	if(TimeoutMs > 0)
+		lDeadline = GetMonotonicTimeNs() + ((UINT64)TimeoutMs * 1000000ULL);
+
+	lPollFds[0].fd = Ring->DataEvent;
+	lPollFds[0].events = POLLIN;
+	lPollFds[1].fd = glIMUStopEvent;
+	lPollFds[1].events = POLLIN;
+
+	lHead = __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE);
+	while((lHead - lTail) < MaxValues && TimeoutMs != 0 && !__atomic_load_n(&Ring->Ended, __ATOMIC_ACQUIRE))
+	{
+		lWaitMs = -1;
+		if(TimeoutMs > 0)
+		{
+			lNow = GetMonotonicTimeNs();
+			if(lNow >= lDeadline)
+				break;
+			lWaitMs = (int)((lDeadline - lNow + 999999ULL) / 1000000ULL);
+		}
+
+		//Announce the wait, then check again so that a push in between is not missed
+		__atomic_store_n(&Ring->Threshold, MaxValues, __ATOMIC_RELAXED);
+		__atomic_store_n(&Ring->Waiting, 1, __ATOMIC_SEQ_CST);
+		lHead = __atomic_load_n(&Ring->Head, __ATOMIC_SEQ_CST);
+		if((lHead - lTail) >= MaxValues || __atomic_load_n(&Ring->Ended, __ATOMIC_SEQ_CST))
+		{
+			__atomic_store_n(&Ring->Waiting, 0, __ATOMIC_RELAXED);
+			break;
+		}
+
+		ret = poll(lPollFds, 2, lWaitMs);
+		__atomic_store_n(&Ring->Waiting, 0, __ATOMIC_RELAXED);
+		if(ret < 0 && errno != EINTR)
+		{
+			perror("xunit-IMURingWait : poll failed");
+			break;
+		}
+
+		//Clear the counter, a stale wakeup only causes one more check
+		if(read(Ring->DataEvent, &lSignal, sizeof(lSignal)) < 0 && errno != EAGAIN)
+			perror("xunit-IMURingWait : eventfd read failed");
+
+		if(lPollFds[1].revents & POLLIN)
+			break;
+
+		lHead = __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE);
+	}
+
+	lHead = __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE);
+	lCount = lHead - lTail;
+
+	return (lCount > MaxValues) ? MaxValues : lCount;
+}
+
+
+//Copies out up to MaxValues raw samples of the ring of a consumer, see PopIMURawBatch
+static BOOL IMURingPopRaw(UINT32 Consumer, IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues)
+{
+	UINT32 lTail, lCount, lFirst, lEnded;
+	IMURing *Ring;
+
+	if(lIMURaw == NULL || NumValues == NULL || MaxValues == 0)
+		return FALSE;
+
+	*NumValues = 0;
+	Ring = IMURingEnter(Consumer);
+	if(Ring == NULL)
+		return FALSE;
+
+	if(MaxValues > IMU_RING_CAPACITY)
+		MaxValues = IMU_RING_CAPACITY;
+
+	lCount = IMURingWait(Ring, MaxValues, TimeoutMs);
+	if(lCount == 0)
+	{
+		lEnded = __atomic_load_n(&Ring->Ended, __ATOMIC_ACQUIRE);
+		IMURingLeave(Ring);
+		return !lEnded;
+	}
+
+	//Copy in at most two contiguous runs around the wrap point
+	lTail = Ring->Tail;
+	lFirst = IMU_RING_CAPACITY - (lTail & IMU_RING_MASK);
+	if(lFirst > lCount)
+		lFirst = lCount;
+	memcpy(lIMURaw, &Ring->Samples[lTail & IMU_RING_MASK], lFirst * sizeof(IMURAWSAMPLE_TypeDef));
+	if(lCount > lFirst)
+		memcpy(lIMURaw + lFirst, Ring->Samples, (lCount - lFirst) * sizeof(IMURAWSAMPLE_TypeDef));
+
+	__atomic_store_n(&Ring->Tail, lTail + lCount, __ATOMIC_RELEASE);
+	*NumValues = lCount;
+
+	IMURingLeave(Ring);
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	PopIMURawBatch					*
+ *  Parameter1	:	IMURAWSAMPLE_TypeDef (*lIMURaw)			*
+ *  Parameter2	:	UINT32 (MaxValues)				*
+ *  Parameter3	:	INT32 (TimeoutMs)				*
+ *  Parameter4	:	UINT32 (*NumValues)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Waits until MaxValues samples are available in the default IMU ring, the	*
+ *			timeout expires or the capture stops, then copies out up to MaxValues	*
+ *			raw samples. The default ring has a single consumer, the other readers	*
+ *			subscribe with SubscribeIMU. The samples arriving while the ring is	*
+ *			full are dropped and counted by GetIMURingStatus, the capture never	*
+ *			waits for the consumer.						*
+ *			TimeoutMs 0 does not wait, a negative TimeoutMs waits forever.		*
+ *			Returns FALSE when the capture has stopped and the ring is empty.	*
+  **********************************************************************************************************
+*/
+BOOL PopIMURawBatch(IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues)
+{
+	return IMURingPopRaw(IMU_CONSUMER_DEFAULT, lIMURaw, MaxValues, TimeoutMs, NumValues);
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	PopIMURawBatchFrom				*
+ *  Parameter1	:	UINT32 (Consumer)				*
+ *  Parameter2	:	IMURAWSAMPLE_TypeDef (*lIMURaw)			*
+ *  Parameter3	:	UINT32 (MaxValues)				*
+ *  Parameter4	:	INT32 (TimeoutMs)				*
+ *  Parameter5	:	UINT32 (*NumValues)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Same as PopIMURawBatch on the ring of a subscriber.		*
+ *			Returns FALSE as well once the consumer has been unsubscribed.	*
+  **********************************************************************************************************
+*/
+BOOL PopIMURawBatchFrom(UINT32 Consumer, IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues)
+{
+	return IMURingPopRaw(Consumer, lIMURaw, MaxValues, TimeoutMs, NumValues);
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	PopIMUValueBatch				*
+ *  Parameter1	:	IMUDATAOUTPUT_TypeDef (*lIMUAxes)		*
+ *  Parameter2	:	UINT32 (MaxValues)				*
+ *  Parameter3	:	INT32 (TimeoutMs)				*
+ *  Parameter4	:	UINT32 (*NumValues)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Same as PopIMURawBatch, the samples are scaled with the sensitivity	*
+ *			of their capture. IMU_VALUE_ID rolls over from 1 to IMU_AXES_VALUES_MAX.	*
+  **********************************************************************************************************
+*/
+BOOL PopIMUValueBatch(IMUDATAOUTPUT_TypeDef *lIMUAxes, UINT32 MaxValues, INT32 TimeoutMs, UINT32 *NumValues)
+{
+	IMURing *lRing;
+	UINT32 lTail, lCount, lFirst, lEnded, index;
+
+	if(lIMUAxes == NULL || NumValues == NULL || MaxValues == 0)
+		return FALSE;
+
+	*NumValues = 0;
+	lRing = IMURingEnter(IMU_CONSUMER_DEFAULT);
+	if(lRing == NULL)
+		return FALSE;
+
+	if(MaxValues > IMU_RING_CAPACITY)
+		MaxValues = IMU_RING_CAPACITY;
+
+	lCount = IMURingWait(lRing, MaxValues, TimeoutMs);
+	if(lCount == 0)
+	{
+		lEnded = __atomic_load_n(&lRing->Ended, __ATOMIC_ACQUIRE);
+		IMURingLeave(lRing);
+		return !lEnded;
+	}
+
+	//Convert straight out of the ring, in at most two runs around the wrap point
+	lTail = lRing->Tail;
+	lFirst = IMU_RING_CAPACITY - (lTail & IMU_RING_MASK);
+	if(lFirst > lCount)
+		lFirst = lCount;
+	ConvertIMURawToValues(&lRing->Samples[lTail & IMU_RING_MASK], lFirst, lIMUAxes);
+	if(lCount > lFirst)
+		ConvertIMURawToValues(lRing->Samples, lCount - lFirst, lIMUAxes + lFirst);
+
+	//The ID follows the position of the sample in the stream
+	for(index = 0; index < lCount; index++)
+		lIMUAxes[index].IMU_VALUE_ID = (UINT16)(((lTail + index) % IMU_AXES_VALUES_MAX) + 1);
+
+	__atomic_store_n(&lRing->Tail, lTail + lCount, __ATOMIC_RELEASE);
+	*NumValues = lCount;
+
+	IMURingLeave(lRing);
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	ConvertIMURawToValues				*
+ *  Parameter1	:	const IMURAWSAMPLE_TypeDef (*lIMURaw)		*
+ *  Parameter2	:	UINT32 (NumValues)				*
+ *  Parameter3	:	IMUDATAOUTPUT_TypeDef (*lIMUAxes)		*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Scales the raw samples with the sensitivity of the range configured	*
+ *			when they were captured, found from their timestamp.		*
+ *			IMU_VALUE_ID is numbered from 1 in the order of the samples.	*
+  **********************************************************************************************************
+*/
+BOOL ConvertIMURawToValues(const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUDATAOUTPUT_TypeDef *lIMUAxes)
+{
+	UINT32 index, lEnd;
+	float lAccSensMult, lGyroSensMult;
+
+	if((lIMURaw == NULL || lIMUAxes == NULL) && NumValues > 0)
+		return FALSE;
+
+	//Same float scaling as the values decoded by GetIMUValueBuffer, one run per sensitivity epoch
+	for(index = 0; index < NumValues; )
+	{
+		lEnd = index + IMUSensitivityRun(&lIMURaw[index], NumValues - index, &lAccSensMult, &lGyroSensMult);
+		for(; index < lEnd; index++)
+		{
+			lIMUAxes[index].IMU_VALUE_ID = (UINT16)((index % IMU_AXES_VALUES_MAX) + 1);
+			lIMUAxes[index].accX = lIMURaw[index].accX * lAccSensMult;
+			lIMUAxes[index].accY = lIMURaw[index].accY * lAccSensMult;
+			lIMUAxes[index].accZ = lIMURaw[index].accZ * lAccSensMult;
+			lIMUAxes[index].gyroX = lIMURaw[index].gyroX * lGyroSensMult;
+			lIMUAxes[index].gyroY = lIMURaw[index].gyroY * lGyroSensMult;
+			lIMUAxes[index].gyroZ = lIMURaw[index].gyroZ * lGyroSensMult;
+			lIMUAxes[index].TimestampNs = lIMURaw[index].TimestampNs;
+		}
+	}
+
+	return TRUE;
+}
+
+
+#if defined(__SSE2__)
+//Transposes the axes of 4 raw samples into 3 registers of 4 x INT16 pairs:
+//AccXY = {aX0..3, aY0..3}, AccZGyroX = {aZ0..3, gX0..3}, GyroYZ = {gY0..3, gZ0..3}
+static inline void IMURawTranspose4(const IMURAWSAMPLE_TypeDef *lIMURaw, __m128i *AccXY, __m128i *AccZGyroX, __m128i *GyroYZ)
+{
+	//Each load reads the 12 bytes of axes and the first 4 bytes of the timestamp, all within the sample
+	__m128i r0 = _mm_loadu_si128((const __m128i*)&lIMURaw[0]);
+	__m128i r1 = _mm_loadu_si128((const __m128i*)&lIMURaw[1]);
+	__m128i r2 = _mm_loadu_si128((const __m128i*)&lIMURaw[2]);
+	__m128i r3 = _mm_loadu_si128((const __m128i*)&lIMURaw[3]);
+
+	__m128i t01l = _mm_unpacklo_epi16(r0, r1);	//aX0 aX1 aY0 aY1 aZ0 aZ1 gX0 gX1
+	__m128i t23l = _mm_unpacklo_epi16(r2, r3);
+	__m128i t01h = _mm_unpackhi_epi16(r0, r1);	//gY0 gY1 gZ0 gZ1 ...
+	__m128i t23h = _mm_unpackhi_epi16(r2, r3);
+
+	*AccXY = _mm_unpacklo_epi32(t01l, t23l);	//aX0 aX1 aX2 aX3 aY0 aY1 aY2 aY3
+	*AccZGyroX = _mm_unpackhi_epi32(t01l, t23l);	//aZ0 aZ1 aZ2 aZ3 gX0 gX1 gX2 gX3
+	*GyroYZ = _mm_unpacklo_epi32(t01h, t23h);	//gY0 gY1 gY2 gY3 gZ0 gZ1 gZ2 gZ3
+}
+
+//Sign extends the low or high 4 x INT16 and scales them to float
+static inline __m128 IMUScaleLo(__m128i Axes, __m128 Scale)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(Axes, Axes), 16)), Scale);
+}
+
+static inline __m128 IMUScaleHi(__m128i Axes, __m128 Scale)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(Axes, Axes), 16)), Scale);
+}
+
+static inline void IMUStoreDouble(double *Dest, __m128 Values)
+{
+	_mm_storeu_pd(Dest, _mm_cvtps_pd(Values));
+	_mm_storeu_pd(Dest + 2, _mm_cvtps_pd(_mm_movehl_ps(Values, Values)));
+}
+#endif
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	ConvertIMURawToFloat				*
+ *  Parameter1	:	const IMURAWSAMPLE_TypeDef (*lIMURaw)		*
+ *  Parameter2	:	UINT32 (NumValues)				*
+ *  Parameter3	:	IMUAXESFLOAT_TypeDef (*Axes)			*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Scales the raw samples into one float array per axis, 4 samples at a	*
+ *			time with SSE2. Axes.TimestampNs may be NULL.			*
+  **********************************************************************************************************
+*/
+BOOL ConvertIMURawToFloat(const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUAXESFLOAT_TypeDef *Axes)
+{
+	UINT32 index = 0, lEnd;
+	float lAccSensMult, lGyroSensMult;
+
+	if(Axes == NULL || (lIMURaw == NULL && NumValues > 0))
+		return FALSE;
+
+	//One run per sensitivity epoch, a single run unless the range was changed during the capture
+	while(index < NumValues)
+	{
+		lEnd = index + IMUSensitivityRun(&lIMURaw[index], NumValues - index, &lAccSensMult, &lGyroSensMult);
+
+#if defined(__SSE2__)
+		__m128 lAccScale = _mm_set1_ps(lAccSensMult), lGyroScale = _mm_set1_ps(lGyroSensMult);
+		__m128i lAccXY, lAccZGyroX, lGyroYZ;
+
+		for(; index + 4 <= lEnd; index += 4)
+		{
+			IMURawTranspose4(&lIMURaw[index], &lAccXY, &lAccZGyroX, &lGyroYZ);
+			_mm_storeu_ps(&Axes->accX[index], IMUScaleLo(lAccXY, lAccScale));
+			_mm_storeu_ps(&Axes->accY[index], IMUScaleHi(lAccXY, lAccScale));
+			_mm_storeu_ps(&Axes->accZ[index], IMUScaleLo(lAccZGyroX, lAccScale));
+			_mm_storeu_ps(&Axes->gyroX[index], IMUScaleHi(lAccZGyroX, lGyroScale));
+			_mm_storeu_ps(&Axes->gyroY[index], IMUScaleLo(lGyroYZ, lGyroScale));
+			_mm_storeu_ps(&Axes->gyroZ[index], IMUScaleHi(lGyroYZ, lGyroScale));
+		}
+#endif
+		for(; index < lEnd; index++)
+		{
+			Axes->accX[index] = lIMURaw[index].accX * lAccSensMult;
+			Axes->accY[index] = lIMURaw[index].accY * lAccSensMult;
+			Axes->accZ[index] = lIMURaw[index].accZ * lAccSensMult;
+			Axes->gyroX[index] = lIMURaw[index].gyroX * lGyroSensMult;
+			Axes->gyroY[index] = lIMURaw[index].gyroY * lGyroSensMult;
+			Axes->gyroZ[index] = lIMURaw[index].gyroZ * lGyroSensMult;
+		}
+	}
+
+	if(Axes->TimestampNs != NULL)
+	{
+		for(index = 0; index < NumValues; index++)
+			Axes->TimestampNs[index] = lIMURaw[index].TimestampNs;
+	}
+
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	ConvertIMURawToDouble				*
+ *  Parameter1	:	const IMURAWSAMPLE_TypeDef (*lIMURaw)		*
+ *  Parameter2	:	UINT32 (NumValues)				*
+ *  Parameter3	:	IMUAXESDOUBLE_TypeDef (*Axes)			*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Scales the raw samples into one double array per axis, 4 samples at a	*
+ *			time with SSE2. Axes.TimestampNs may be NULL.			*
+  **********************************************************************************************************
+*/
+BOOL ConvertIMURawToDouble(const IMURAWSAMPLE_TypeDef *lIMURaw, UINT32 NumValues, IMUAXESDOUBLE_TypeDef *Axes)
+{
+	UINT32 index = 0, lEnd;
+	float lAccSensMult, lGyroSensMult;
+
+	if(Axes == NULL || (lIMURaw == NULL && NumValues > 0))
+		return FALSE;
+
+	//One run per sensitivity epoch, a single run unless the range was changed during the capture
+	while(index < NumValues)
+	{
+		lEnd = index + IMUSensitivityRun(&lIMURaw[index], NumValues - index, &lAccSensMult, &lGyroSensMult);
+
+#if defined(__SSE2__)
+		//Scaled in float like the other paths, then widened
+		__m128 lAccScale = _mm_set1_ps(lAccSensMult), lGyroScale = _mm_set1_ps(lGyroSensMult);
+		__m128i lAccXY, lAccZGyroX, lGyroYZ;
+
+		for(; index + 4 <= lEnd; index += 4)
+		{
+			IMURawTranspose4(&lIMURaw[index], &lAccXY, &lAccZGyroX, &lGyroYZ);
+			IMUStoreDouble(&Axes->accX[index], IMUScaleLo(lAccXY, lAccScale));
+			IMUStoreDouble(&Axes->accY[index], IMUScaleHi(lAccXY, lAccScale));
+			IMUStoreDouble(&Axes->accZ[index], IMUScaleLo(lAccZGyroX, lAccScale));
+			IMUStoreDouble(&Axes->gyroX[index], IMUScaleHi(lAccZGyroX, lGyroScale));
+			IMUStoreDouble(&Axes->gyroY[index], IMUScaleLo(lGyroYZ, lGyroScale));
+			IMUStoreDouble(&Axes->gyroZ[index], IMUScaleHi(lGyroYZ, lGyroScale));
+		}
+#endif
+		for(; index < lEnd; index++)
+		{
+			Axes->accX[index] = lIMURaw[index].accX * lAccSensMult;
+			Axes->accY[index] = lIMURaw[index].accY * lAccSensMult;
+			Axes->accZ[index] = lIMURaw[index].accZ * lAccSensMult;
+			Axes->gyroX[index] = lIMURaw[index].gyroX * lGyroSensMult;
+			Axes->gyroY[index] = lIMURaw[index].gyroY * lGyroSensMult;
+			Axes->gyroZ[index] = lIMURaw[index].gyroZ * lGyroSensMult;
+		}
+	}
+
+	if(Axes->TimestampNs != NULL)
+	{
+		for(index = 0; index < NumValues; index++)
+			Axes->TimestampNs[index] = lIMURaw[index].TimestampNs;
+	}
+
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	GetIMURingStatus				*
+ *  Parameter1	:	UINT32 (*Available)				*
+ *  Parameter2	:	UINT32 (*Overruns)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Reads the number of samples waiting in the default IMU ring and the	*
+ *			number of samples dropped because it was full.			*
+ *			Returns FALSE once the capture has stopped.			*
+  **********************************************************************************************************
+*/
+BOOL GetIMURingStatus(UINT32 *Available, UINT32 *Overruns)
+{
+	return GetIMUConsumerStatus(IMU_CONSUMER_DEFAULT, Available, Overruns);
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	GetIMUConsumerStatus				*
+ *  Parameter1	:	UINT32 (Consumer)				*
+ *  Parameter2	:	UINT32 (*Available)				*
+ *  Parameter3	:	UINT32 (*Overruns)				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Same as GetIMURingStatus on the ring of a subscriber.		*
+ *			Returns FALSE as well once the consumer has been unsubscribed.	*
+  **********************************************************************************************************
+*/
+BOOL GetIMUConsumerStatus(UINT32 Consumer, UINT32 *Available, UINT32 *Overruns)
+{
+	UINT32 lIndex = IMU_CONSUMER_INDEX(Consumer);
+	IMURing *lRing;
+
+	if(Available == NULL || Overruns == NULL || lIndex >= IMU_RING_CONSUMERS)
+		return FALSE;
+
+	lRing = &glIMURings[lIndex];
+	if(IMUConsumerId(lRing, lIndex) != Consumer)
+		return FALSE;
+
+	*Available = __atomic_load_n(&lRing->Head, __ATOMIC_ACQUIRE) - __atomic_load_n(&lRing->Tail, __ATOMIC_ACQUIRE);
+	*Overruns = __atomic_load_n(&lRing->Overruns, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&glIMUCaptureRunning, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	GetIMUTimingStats				*
+ *  Parameter1	:	IMUTIMING_TypeDef (*Timing)			*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Reads the output data rate and the jitter estimated from the arrival	*
+ *			time of the samples read by StartIMUCapture.			*
+  **********************************************************************************************************
+*/
+BOOL GetIMUTimingStats(IMUTIMING_TypeDef *Timing)
+{
+	UINT32 lSequence;
+
+	if(Timing == NULL)
+		return FALSE;
+
+	//Retry while the capture thread is in the middle of an update
+	do
+	{
+		while((lSequence = __atomic_load_n(&glIMUTiming.Sequence, __ATOMIC_ACQUIRE)) & 1)
+			;
+		memcpy(Timing, (const void*)&glIMUTiming.Timing, sizeof(IMUTIMING_TypeDef));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&glIMUTiming.Sequence, __ATOMIC_RELAXED) != lSequence);
+
+	return (Timing->SampleCount > 1);
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	StereoCalibRead					*
+ *  Parameter1	:	unsigned char (**in_buffer)			*
+ *  Parameter2	:	unsigned char (**ex_buffer)			*
+ *  Parameter3	:	int *intFileLength				*
+ *  Parameter4	:	int *extFileLength				*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:  	Sends the extension unit command to read the calibration files stored in the flash. *
+  **********************************************************************************************************
+*/
+BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *intFileLength, int *extFileLength)
+{
+	BOOL timeout = TRUE;
+	int ret = 0;
+	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
+
+	int lIntFileLength = 0,lExtFileLength = 0;
+	int lIntPckCnt = 0,lExtPckCnt = 0;
+	int lLoopCount = 1;
+	
+	
+	//1. Issue a Read request - Intrinsic file
+	memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
+
+	g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
+	g_out_packet_buf[2] = READ_CALIB_REQUEST;
+	g_out_packet_buf[3] = INTRINSIC_FILEID;
+
+	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
+	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
+	if (ret < 0) {
+		perror("xunit-StereoCalibRead : write failed");
+		HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_WRITE_ERROR);
+		return FALSE;
+	} else {
+		//printf("%s(): wrote %d bytes\n", __func__,ret);
+	}
+
+	/* Read the status from the device */
+	start = GetTickCount();
+	while(timeout)
+	{
+		/* Get a report from the device */
+		ret = read(hid_fd, g_in_packet_buf, BUFFER_LENGTH);
+		if (ret < 0) {
+			//perror("read");
+		} else {
+			//printf("%s(): read %d bytes:\n", __func__,ret);
+			if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
+				g_in_packet_buf[1] == READ_CALIB_REQUEST) {
+					if(g_in_packet_buf[15] == SEE3CAM_STEREO_HID_SUCCESS) {
+
+						lIntFileLength = (UINT32)(((g_in_packet_buf[7] << 8 ) & 0xFF00) | (g_in_packet_buf[8] & 0xFF));
+
+						lIntPckCnt = lIntFileLength / PCK_SIZE;
+						if(lIntFileLength % PCK_SIZE != 0)
+							lIntPckCnt++;
+						HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_SUCCESS);
+						timeout = FALSE;
+					} else if(g_in_packet_buf[15] == SEE3CAM_STEREO_HID_FAIL) {
+						printf("StereoCalibRead: Return Status Failed 1\r\n");
+						HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_FAIL);
+						return FALSE;
+					}
+			} else {
+				HIDTelemetryStray(HID_CMD_READ_CALIB_REQUEST);
+			}
+		}
+		end = GetTickCount();
+		if(timeout && (end - start > CALIB_TIMEOUT))
+		{
+			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_TIMEOUT);
+			timeout = FALSE;
+			return FALSE;
+		}
+	}
+	Sleep(10);
+	//Allocating the in buffer
+	*in_buffer = (unsigned char*)calloc(lIntPckCnt * PCK_SIZE, sizeof(unsigned char));
+	*intFileLength = lIntFileLength;
+	
+	if(*in_buffer == NULL)	
+	{
+		printf("Memory Allocation failed Intrinsic file\n");
+		return FALSE;
+	}
+	
+
+	//2.Issue a read data - Intrinsic file
+	Sleep(10);
+	
+	for(lLoopCount = 1; lLoopCount < lIntPckCnt; )
+	{
+		memset(g_out_packet_buf,0x00,BUFFER_LENGTH);
+		g_out_packet_buf[1] = CAMERA_CONTROL_STEREO;
+		g_out_packet_buf[2] = READ_CALIB_DATA;
+		g_out_packet_buf[3] = INTRINSIC_FILEID;
+
+		/* Send a Report to the Device */
+		lTxStart = GetMonotonicTimeNs();
+		ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
+		if (ret < 0) {
+			perror("write");
+			HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_WRITE_ERROR);
+			return FALSE;
+		} else {
+			//printf("%s(): wrote %d bytes\n", __func__,ret);
+		}
+
+		/* Read the status from the device */
+		timeout = TRUE;
+		start = GetTickCount();
+		while(timeout)
+		{
+			/* Get a report from the device */
+			ret = read(hid_fd, g_in_packet_buf, BUFFER_LENGTH);
+			if (ret < 0) {
+				//perror("read");
+			} else {
+				//printf("%s(): read %d bytes:\n", __func__,ret);
+				if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
+					g_in_packet_buf[1] == READ_CALIB_DATA) {
+						if(g_in_packet_buf[7] == SEE3CAM_STEREO_HID_SUCCESS) {
+
+							lLoopCount = (UINT32)(((g_in_packet_buf[5] << 8 ) & 0xFF00) | (g_in_packet_buf[6] & 0xFF));		
+							
+							if(lLoopCount == lIntPckCnt)
+							{
+								memcpy(*in_buffer + ((lLoopCount - 1)*PCK_SIZE),&g_in_packet_buf[8],(lIntFileLength % PCK_SIZE));
+								//printf("StereoCalibRead: Write File Passed 2\r\n");
+							}
+							else
+							{
+								memcpy(*in_buffer + ((lLoopCount - 1)*PCK_SIZE),&g_in_packet_buf[8],PCK_SIZE);
+							}
+							HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_SUCCESS);
+							timeout = FALSE;
+						} else if(g_in_packet_buf[7] == SEE3CAM_STEREO_HID_FAIL) {
+							HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_FAIL);
+							return FALSE;
+						}
+				} else {
+					HIDTelemetryStray(HID_CMD_READ_CALIB_DATA);
 				}
 			}
 			end = GetTickCount();
-			if(end - start > CALIB_TIMEOUT)
+			if(timeout && (end - start > CALIB_TIMEOUT))
 			{
 				printf("%s(): Timeout occurred\n", __func__);
+				HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_TIMEOUT);
 				timeout = FALSE;
 				return FALSE;
 			}
@@ -1342,9 +2851,11 @@ BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *
 	g_out_packet_buf[3] = EXTRINSIC_FILEID;
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-StereoCalibRead : write failed");
+		HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1369,17 +2880,22 @@ BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *
 						lExtPckCnt = lExtFileLength / PCK_SIZE;
 						if(lExtFileLength % PCK_SIZE != 0)
 							lExtPckCnt++;
+						HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[15] == SEE3CAM_STEREO_HID_FAIL) {
 						printf("StereoCalibRead: Return Status Failed 1\r\n");
+						HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_READ_CALIB_REQUEST);
 			}
 		}
 		end = GetTickCount();
-		if(end - start > CALIB_TIMEOUT)
+		if(timeout && (end - start > CALIB_TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_READ_CALIB_REQUEST, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1408,9 +2924,11 @@ BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *
 		g_out_packet_buf[3] = EXTRINSIC_FILEID;
 
 		/* Send a Report to the Device */
+		lTxStart = GetMonotonicTimeNs();
 		ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 		if (ret < 0) {
 			perror("write");
+			HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_WRITE_ERROR);
 			return FALSE;
 		} else {
 			//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1442,16 +2960,21 @@ BOOL StereoCalibRead(unsigned char **in_buffer, unsigned char **ex_buffer, int *
 							{
 								memcpy(*ex_buffer + ((lLoopCount - 1)*PCK_SIZE),&g_in_packet_buf[8],PCK_SIZE);
 							}
+							HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_SUCCESS);
 							timeout = FALSE;
 						} else if(g_in_packet_buf[7] == SEE3CAM_STEREO_HID_FAIL) {
+							HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_FAIL);
 							return FALSE;
 						}
+				} else {
+					HIDTelemetryStray(HID_CMD_READ_CALIB_DATA);
 				}
 			}
 			end = GetTickCount();
-			if(end - start > CALIB_TIMEOUT)
+			if(timeout && (end - start > CALIB_TIMEOUT))
 			{
 				printf("%s(): Timeout occurred\n", __func__);
+				HIDTelemetryRecord(HID_CMD_READ_CALIB_DATA, lTxStart, HID_OUTCOME_TIMEOUT);
 				timeout = FALSE;
 				return FALSE;
 			}
@@ -1477,6 +3000,7 @@ BOOL GetStreamModeStereo(UINT32 *iStreamMode)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -1486,9 +3010,11 @@ BOOL GetStreamModeStereo(UINT32 *iStreamMode)
 	g_out_packet_buf[2] = GET_STREAM_MODE_STEREO; 		/* Report Number */
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-GetStreamModeStereo : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_STREAM_MODE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1508,16 +3034,21 @@ BOOL GetStreamModeStereo(UINT32 *iStreamMode)
 				g_in_packet_buf[1] == GET_STREAM_MODE_STEREO ) {
 					if(g_in_packet_buf[4] == GET_SUCCESS) {
 						*iStreamMode = g_in_packet_buf[2];
+						HIDTelemetryRecord(HID_CMD_GET_STREAM_MODE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[4] == GET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_GET_STREAM_MODE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_GET_STREAM_MODE);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_STREAM_MODE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1540,6 +3071,7 @@ BOOL SetStreamModeStereo(UINT32 iStreamMode)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -1550,9 +3082,11 @@ BOOL SetStreamModeStereo(UINT32 iStreamMode)
 	g_out_packet_buf[3] = iStreamMode; 					/* Report Number */
 	
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0) {
 		perror("xunit-SetStreamModeStereo : write failed");
+		HIDTelemetryRecord(HID_CMD_SET_STREAM_MODE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	} else {
 		//printf("%s(): wrote %d bytes\n", __func__,ret);
@@ -1571,16 +3105,21 @@ BOOL SetStreamModeStereo(UINT32 iStreamMode)
 			if(g_in_packet_buf[0] == CAMERA_CONTROL_STEREO &&
 							g_in_packet_buf[1] == SET_STREAM_MODE_STEREO){
 					if(g_in_packet_buf[4] == SET_SUCCESS) {
+						HIDTelemetryRecord(HID_CMD_SET_STREAM_MODE, lTxStart, HID_OUTCOME_SUCCESS);
 						timeout = FALSE;
 					} else if(g_in_packet_buf[4] == SET_FAIL) {
+						HIDTelemetryRecord(HID_CMD_SET_STREAM_MODE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
+			} else {
+				HIDTelemetryStray(HID_CMD_SET_STREAM_MODE);
 			}
 	 	}
 		end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_SET_STREAM_MODE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1603,6 +3142,7 @@ BOOL SetHDRModeStereo(UINT32 HDRMode)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer	
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -1612,10 +3152,12 @@ BOOL SetHDRModeStereo(UINT32 HDRMode)
 	g_out_packet_buf[2] = SET_HDR_MODE_STEREO;
 	g_out_packet_buf[3] = HDRMode;
 	
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0)
 	{
 		perror("xunit-GetHDRMode : write failed");
+		HIDTelemetryRecord(HID_CMD_SET_HDR_MODE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	}
 	else
@@ -1640,21 +3182,28 @@ BOOL SetHDRModeStereo(UINT32 HDRMode)
 			{
 				if (  g_in_packet_buf[4] == SET_SUCCESS )
 				{
+					HIDTelemetryRecord(HID_CMD_SET_HDR_MODE, lTxStart, HID_OUTCOME_SUCCESS);
 					timeout = FALSE;
 				}
 				else
 				{
 					if ( g_in_packet_buf[4] == SET_FAIL )
 					{
+						HIDTelemetryRecord(HID_CMD_SET_HDR_MODE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
 				}
 			}
+			else
+			{
+				HIDTelemetryStray(HID_CMD_SET_HDR_MODE);
+			}
 	 	}
 	 	end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_SET_HDR_MODE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1677,6 +3226,7 @@ BOOL GetHDRModeStereo(UINT32 *HDRMode)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer	
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -1685,10 +3235,12 @@ BOOL GetHDRModeStereo(UINT32 *HDRMode)
 	g_out_packet_buf[1] = CAMERA_CONTROL_STEREO; 	/* Report Number */
 	g_out_packet_buf[2] = GET_HDR_MODE_STEREO;
 	
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0)
 	{
 		perror("xunit-GetHDRMode : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_HDR_MODE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	}
 	else
@@ -1714,21 +3266,28 @@ BOOL GetHDRModeStereo(UINT32 *HDRMode)
 				if (  g_in_packet_buf[4] == GET_SUCCESS )
 				{
 					*HDRMode = g_in_packet_buf[2];
+					HIDTelemetryRecord(HID_CMD_GET_HDR_MODE, lTxStart, HID_OUTCOME_SUCCESS);
 					timeout = FALSE;
 				}
 				else
 				{
 					if ( g_in_packet_buf[4] == GET_FAIL )
 					{
+						HIDTelemetryRecord(HID_CMD_GET_HDR_MODE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
 				}
 			}
+			else
+			{
+				HIDTelemetryStray(HID_CMD_GET_HDR_MODE);
+			}
 	 	}
 	 	end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_HDR_MODE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1753,6 +3312,7 @@ BOOL GetIMUTemperatureData(UINT8 *MSBTemp, UINT8 *LSBTemp)
 	BOOL timeout = TRUE;
 	int ret = 0;
 	unsigned int start, end = 0;
+	UINT64 lTxStart = 0;
 
 	//Initialize the buffer	
 	memset(g_out_packet_buf, 0x00, sizeof(g_out_packet_buf));
@@ -1762,10 +3322,12 @@ BOOL GetIMUTemperatureData(UINT8 *MSBTemp, UINT8 *LSBTemp)
 	g_out_packet_buf[2] = GET_IMU_TEMP_DATA;	
 
 	/* Send a Report to the Device */
+	lTxStart = GetMonotonicTimeNs();
 	ret = write(hid_fd, g_out_packet_buf, BUFFER_LENGTH);
 	if (ret < 0)
 	{
 		perror("xunit-GetIMUTemperatureData : write failed");
+		HIDTelemetryRecord(HID_CMD_GET_IMU_TEMPERATURE, lTxStart, HID_OUTCOME_WRITE_ERROR);
 		return FALSE;
 	}
 	else
@@ -1793,21 +3355,28 @@ BOOL GetIMUTemperatureData(UINT8 *MSBTemp, UINT8 *LSBTemp)
 				{
 					*MSBTemp = g_in_packet_buf[2];
 					*LSBTemp = g_in_packet_buf[3];
+					HIDTelemetryRecord(HID_CMD_GET_IMU_TEMPERATURE, lTxStart, HID_OUTCOME_SUCCESS);
 					timeout = FALSE;
 				}
 				else
 				{
 					if ( g_in_packet_buf[6] == GET_FAIL )
 					{
+						HIDTelemetryRecord(HID_CMD_GET_IMU_TEMPERATURE, lTxStart, HID_OUTCOME_FAIL);
 						return FALSE;
 					}
 				}
 			}
+			else
+			{
+				HIDTelemetryStray(HID_CMD_GET_IMU_TEMPERATURE);
+			}
 	 	}
 	 	end = GetTickCount();
-		if(end - start > TIMEOUT)
+		if(timeout && (end - start > TIMEOUT))
 		{
 			printf("%s(): Timeout occurred\n", __func__);
+			HIDTelemetryRecord(HID_CMD_GET_IMU_TEMPERATURE, lTxStart, HID_OUTCOME_TIMEOUT);
 			timeout = FALSE;
 			return FALSE;
 		}
@@ -1816,6 +3385,150 @@ BOOL GetIMUTemperatureData(UINT8 *MSBTemp, UINT8 *LSBTemp)
 }
 
 
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 					*
+ *  Name	:	GetHIDStatistics				*
+ *  Parameter1	:	HIDCommand 		(Command)		*
+ *  Parameter2	:	HIDSTATS_TypeDef 	(*Stats)		*
+ *  Returns	:	BOOL (TRUE or FALSE)				*
+ *  Description	:   	Reads the counters of a HID command and computes the latency percentiles	*
+ *			from its histogram. Lock free, can be called from any thread.		*
+  **********************************************************************************************************
+*/
+BOOL GetHIDStatistics(HIDCommand Command, HIDSTATS_TypeDef *Stats)
+{
+	HIDTelemetry *lTelemetry;
+	UINT32 lHist[HID_LATENCY_BUCKETS];
+	UINT64 lTotal = 0, lCount = 0;
+	int index;
+
+	if(Command < 0 || Command >= HID_CMD_COUNT || Stats == NULL)
+		return FALSE;
+
+	lTelemetry = &glHIDTelemetry[Command];
+
+	Stats->Issued		= __atomic_load_n(&lTelemetry->Issued, __ATOMIC_RELAXED);
+	Stats->Success		= __atomic_load_n(&lTelemetry->Success, __ATOMIC_RELAXED);
+	Stats->Fail		= __atomic_load_n(&lTelemetry->Fail, __ATOMIC_RELAXED);
+	Stats->Timeout		= __atomic_load_n(&lTelemetry->Timeout, __ATOMIC_RELAXED);
+	Stats->WriteError	= __atomic_load_n(&lTelemetry->WriteError, __ATOMIC_RELAXED);
+	Stats->StrayPackets	= __atomic_load_n(&lTelemetry->StrayPackets, __ATOMIC_RELAXED);
+	Stats->LatencyMaxUs	= __atomic_load_n(&lTelemetry->LatencyMaxUs, __ATOMIC_RELAXED);
+	Stats->LatencyP50Us	= 0;
+	Stats->LatencyP99Us	= 0;
+
+	for(index = 0; index < HID_LATENCY_BUCKETS; index++)
+	{
+		lHist[index] = __atomic_load_n(&lTelemetry->LatencyHist[index], __ATOMIC_RELAXED);
+		lTotal += lHist[index];
+	}
+
+	if(lTotal == 0)
+		return TRUE;
+
+	//Percentiles are reported as the upper bound of the bucket, clipped to the maximum seen
+	for(index = 0; index < HID_LATENCY_BUCKETS; index++)
+	{
+		lCount += lHist[index];
+		if(Stats->LatencyP50Us == 0 && (lCount * 100) >= (lTotal * 50))
+			Stats->LatencyP50Us = HIDBucketLatency(index);
+		if((lCount * 100) >= (lTotal * 99))
+		{
+			Stats->LatencyP99Us = HIDBucketLatency(index);
+			break;
+		}
+	}
+
+	if(Stats->LatencyP50Us > Stats->LatencyMaxUs)
+		Stats->LatencyP50Us = Stats->LatencyMaxUs;
+	if(Stats->LatencyP99Us > Stats->LatencyMaxUs)
+		Stats->LatencyP99Us = Stats->LatencyMaxUs;
+
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 				*
+ *  Name	:	ResetHIDStatistics			*
+ *  Returns	:	BOOL (TRUE or FALSE)			*
+ *  Description	:   	Clears the counters and histograms of all the HID commands.	*
+  **********************************************************************************************************
+*/
+BOOL ResetHIDStatistics(void)
+{
+	int index, bucket;
+
+	for(index = 0; index < HID_CMD_COUNT; index++)
+	{
+		__atomic_store_n(&glHIDTelemetry[index].Issued, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].Success, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].Fail, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].Timeout, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].WriteError, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].StrayPackets, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&glHIDTelemetry[index].LatencyMaxUs, 0, __ATOMIC_RELAXED);
+		for(bucket = 0; bucket < HID_LATENCY_BUCKETS; bucket++)
+			__atomic_store_n(&glHIDTelemetry[index].LatencyHist[bucket], 0, __ATOMIC_RELAXED);
+	}
+	return TRUE;
+}
+
+
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	LIBRAY API 		*
+ *  Name	:	HIDCommandStr		*
+ *  Parameter1	:	int	(Command)	*
+ *  Returns	:	const char *		*
+ *  Description	:   	To convert the HID command to string		    *	
+  **********************************************************************************************************
+*/
+const char *HIDCommandStr(int Command)
+{
+	switch (Command) {
+	case HID_CMD_READ_FIRMWARE_VERSION:
+		return "ReadFirmwareVersion";
+	case HID_CMD_GET_CAMERA_UNIQUE_ID:
+		return "GetCameraUniqueID";
+	case HID_CMD_GET_EXPOSURE:
+		return "GetManualExposure";
+	case HID_CMD_SET_EXPOSURE:
+		return "SetManualExposure";
+	case HID_CMD_SET_AUTO_EXPOSURE:
+		return "SetAutoExposure";
+	case HID_CMD_GET_IMU_CONFIG:
+		return "GetIMUConfig";
+	case HID_CMD_SET_IMU_CONFIG:
+		return "SetIMUConfig";
+	case HID_CMD_CONTROL_IMU_CAPTURE:
+		return "ControlIMUCapture";
+	case HID_CMD_IMU_VALUE_BUFFER:
+		return "IMUValueBuffer";
+	case HID_CMD_READ_CALIB_REQUEST:
+		return "ReadCalibRequest";
+	case HID_CMD_READ_CALIB_DATA:
+		return "ReadCalibData";
+	case HID_CMD_GET_STREAM_MODE:
+		return "GetStreamMode";
+	case HID_CMD_SET_STREAM_MODE:
+		return "SetStreamMode";
+	case HID_CMD_SET_HDR_MODE:
+		return "SetHDRMode";
+	case HID_CMD_GET_HDR_MODE:
+		return "GetHDRMode";
+	case HID_CMD_GET_IMU_TEMPERATURE:
+		return "GetIMUTemperature";
+	case HID_CMD_GET_REVISION:
+		return "GetRevision";
+	default:
+		return "Unknown";
+	}
+}
+
+
 /*
   **********************************************************************************************************
  *  MODULE TYPE	:	LIBRAY API 		*
@@ -1865,6 +3578,24 @@ unsigned int GetTickCount(void)
 }
 
 
+/*
+  **********************************************************************************************************
+ *  MODULE TYPE	:	Internal API 		*
+ *  Name	:	GetMonotonicTimeNs	*
+ *  Returns	:	UINT64			*
+ *  Description	:  	To return the CLOCK_MONOTONIC time in nano seconds	   		*	
+  **********************************************************************************************************
+*/
+UINT64 GetMonotonicTimeNs(void)
+{
+        struct timespec ts;
+        if(clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+                return 0;
+
+        return ((UINT64)ts.tv_sec * 1000000000ULL) + (UINT64)ts.tv_nsec;
+}
+
+
 /*
   **********************************************************************************************************
  *  MODULE TYPE	:	LIBRAY API 			    *
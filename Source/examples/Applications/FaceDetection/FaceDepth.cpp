@@ -19,6 +19,7 @@
 **********************************************************************/
 #include "FaceDepth.h"
 #define RIGHTMATCH 150 //disparity range starts from 150 so in case of the point being less than 150 it means that the face is not fully covered in the right.
+#define MIN_CONFIDENCE 0.1 //Faces matched with a lower confidence show no depth
 
 using namespace cv;
 using namespace std;
@@ -53,7 +54,8 @@ int FaceDepth::Init()
 	if(DEBUG_ENABLED)
 		cout << "Loaded Haarcascade Classifier File!" << endl;
 
-	if(!_Disparity.InitCamera(true, true)) //Initialise the camera
+	//Only the faces are matched, no disparity map is generated
+	if(!_Disparity.InitCamera(false, false)) //Initialise the camera
 	{
 		if(DEBUG_ENABLED)
 			cout << "Camera Initialisation Failed!\n";
@@ -66,28 +68,16 @@ int FaceDepth::Init()
 	return TRUE;
 }
 
-//Unscaling the point to the actual image size for the lower resolutions
-Point FaceDepth::unscalePoint(Point Pt, Size CurrentSize, Size TargetSize)
-{
-	Point DesPt;
-
-	DesPt.x = int( (Pt.x /(float) CurrentSize.width)  * TargetSize.width );
-	DesPt.y = int( (Pt.y /(float) CurrentSize.height) * TargetSize.height);
- 
-	return DesPt;
-}
-
 //Streams the input from the camera
 int FaceDepth::CameraStreaming()
 {	
 	stringstream ss;
-	vector<Rect> LFaces;
-	float DepthValue;
+	vector<Rect> LFaces, FaceCentres;
+	vector<SPARSEDEPTH_TypeDef> FaceDepths;
 	bool RImageDisplay = false;
 	int BrightnessVal = 4;		//Default value
 	int ManualExposure = 0;
-	Mat gDisparityMap, gDisparityMap_viz, RightImage;
-	Point g_SelectedPoint;
+	Mat RightImage;
 	
 	//user key input
 	char WaitKeyStatus;
@@ -113,26 +103,27 @@ int FaceDepth::CameraStreaming()
 			break;
 		}	
 	
-		//Get disparity
-		_Disparity.GetDisparity(LeftImage, RightImage, &gDisparityMap, &gDisparityMap_viz);
-
 		//Detect the faces
 		LFaces = DetectFace(LeftImage);
-	
-		//Estimate the Depth of the point selected
+
+		//Centre half of each face, without the background around it
+		FaceCentres.resize(LFaces.size());
+		for (size_t i = 0; i < LFaces.size(); i++)
+		{
+			FaceCentres[i] = Rect(LFaces[i].x + LFaces[i].width / 4, LFaces[i].y + LFaces[i].height / 4, LFaces[i].width / 2, LFaces[i].height / 2);
+		}
+
+		//Matches only the faces, before they are marked on the image
+		_Disparity.GetSparseDepth(LeftImage, RightImage, FaceCentres, &FaceDepths);
+
+		//Marks the faces with their depth
 		for (size_t i = 0; i < LFaces.size(); i++)
 		{
-			//Pointing to the center of the face
-			g_SelectedPoint = Point(LFaces[i].x + LFaces[i].width / 2, LFaces[i].y + LFaces[i].height / 2);
+			rectangle(LeftImage, LFaces[i], Scalar(255, 0, 0), 2);
 
-			Point scaledPoint = unscalePoint(g_SelectedPoint, LeftImage.size(),  gDisparityMap.size());
-			
-			//Find the depth of the point passed
-			_Disparity.EstimateDepth(scaledPoint, &DepthValue);
-			
-			if(g_SelectedPoint.x > RIGHTMATCH && DepthValue > 0) //Mark the point selected by the user
+			if(LFaces[i].x + LFaces[i].width / 2 > RIGHTMATCH && FaceDepths[i].Depth > 0 && FaceDepths[i].Confidence >= MIN_CONFIDENCE)
 			{				
-				ss << DepthValue / 10 << " cm\0" ;
+				ss << FaceDepths[i].Depth / 10 << " cm\0" ;
 				DisplayText(LeftImage, ss.str(), Point(LFaces[i].x, LFaces[i].y));
 				ss.str(string());
 			}
@@ -257,12 +248,6 @@ vector<Rect> FaceDepth::DetectFace(Mat InputImage)
 	//Detects the faces in the scene
 	FaceCascade.detectMultiScale(InputImage, FacesDetected, 1.3, 5);
 
-	//Marks the faces on the image
-	for(size_t i = 0; i < FacesDetected.size(); i++)
-	{
-		rectangle(InputImage, FacesDetected[i], Scalar(255, 0, 0), 2);  
-	}
-
 	//Return the detected faces
 	return FacesDetected;
 }
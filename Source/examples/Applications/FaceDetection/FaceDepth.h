@@ -40,9 +40,6 @@ private:
 	//Detects the faces in the scene
 	std::vector<cv::Rect> DetectFace(cv::Mat img);
 
-	//Unscaling the point to the actual image size for the lower resolutions
-	cv::Point unscalePoint(cv::Point Pt, cv::Size CurrentSize, cv::Size TargetSize);
-
 	//Streams the input from the camera 
 	int CameraStreaming(); 
 
@@ -228,45 +228,43 @@ double HeightEstimation::EstimateHeight()
 	//Minimum Height to avoid false detections
 	double HeightThreshold = 100.0;
 
-	Mat DepthHalf;
-	Point minLoc, maxLoc;
-
-	vector<float> DepthValue;
-	vector<Point> Depthpoints;
+	vector<Rect> DepthRegions;
+	vector<REGIONDEPTH_TypeDef> DepthValue;
 
 	int DepthOffset = 20;
-	float minDepthValue = 0, tempDepthValue = 0;
-	double minVal = 0, maxVal = 0, HumanHeight = 0;
-
-	//Copying 1 / 3 of the image alone
-	DepthHalf = gDisparityMap(Rect(0, 0, gDisparityMap.cols, 160)).clone();
-
-	//Finding the Minimum and Maximum location of the image
-	minMaxLoc(DepthHalf, &minVal, &maxVal, &minLoc, &maxLoc, Mat());
+	int TopRows = 160;	//1 / 3 of the image alone
+	float minDepthValue = -1;
+	double HumanHeight = 0;
 
-	//Estimating the Depth of the points in the image
-	for(int i = 50; i < DepthHalf.cols - DepthOffset; i += DepthOffset)
+	//Regions of the grid in the top of the image, queried at once
+	for(int i = 50; i < gDisparityMap.cols - DepthOffset; i += DepthOffset)
 	{
-		for(int j = 50; j < DepthHalf.rows - DepthOffset; j += DepthOffset)
+		for(int j = 50; j < TopRows - DepthOffset; j += DepthOffset)
 		{
-			_Disparity.EstimateDepth(Point(i , j), &tempDepthValue);
-			DepthValue.push_back(abs(tempDepthValue));
-			Depthpoints.push_back(Point(i, j));
+			DepthRegions.push_back(Rect(i, j, DepthOffset, DepthOffset));
 		}
 	}
 
-	//Copy the first value
-	minDepthValue = DepthValue[0];
+	//Estimating the mean depth of the regions
+	if(!_Disparity.GetRegionDepth(DepthRegions, &DepthValue))
+	{
+		return 0;
+	}
 
-	//Finding the Lowest Depth
+	//Finding the Lowest Depth, the regions without a valid disparity are skipped
 	for(size_t j = 0; j < DepthValue.size(); j++)
 	{
-		if(DepthValue[j] < minDepthValue)
+		if(DepthValue[j].Depth > 0 && (minDepthValue < 0 || DepthValue[j].Depth < minDepthValue))
 		{
-			minDepthValue = DepthValue[j];
+			minDepthValue = DepthValue[j].Depth;
 		}
 	}
 
+	if(minDepthValue < 0)
+	{
+		return 0;
+	}
+
 	//mm to cm conversion
 	HeadDepth = minDepthValue / 10;
 	HumanHeight = BaseDepth - HeadDepth;
@@ -215,6 +215,13 @@ int VolumeEstimation::BaseDepthEstimation()
 	char WaitKeyStatus;
 	int NoFrames = 0;
 	float DepthValue = 0;
+	DISPARITYPARAMS_TypeDef Params;
+
+	//The camera and the base are static, the temporal filter of the library averages the frames
+	_Disparity.GetDisparityParams(&Params);
+	Params.TemporalAlpha = BASE_DEPTH_ALPHA;
+	Params.TemporalPersistence = BASE_DEPTH_FRAMES;
+	_Disparity.SetDisparityParams(Params);
 
 	cout << endl << "Press q/Q/Esc on the Image Window to quit the application!" << endl;
 	cout << endl << "Press r/R on the Image Window to see the right image" << endl;
@@ -222,8 +229,8 @@ int VolumeEstimation::BaseDepthEstimation()
 	cout << endl << "Press a/A on the Image Window to change to Auto exposure  of the camera" << endl;
 	cout << endl << "Press e/E on the Image Window to change the exposure of the camera" << endl << endl;
 
-	//Estimates the depth of the base from 20 frames and averages it
-	while(NoFrames < 20)
+	//Estimates the depth of the base on the map averaged over BASE_DEPTH_FRAMES frames
+	while(NoFrames < BASE_DEPTH_FRAMES)
 	{
 		if(!_Disparity.GrabFrame(&LeftImage, &RightImage)) //Reads the frame and returns the rectified image
 		{
@@ -234,12 +241,11 @@ int VolumeEstimation::BaseDepthEstimation()
 		//Get Disparity map
 		_Disparity.GetDisparity(LeftImage, RightImage, &gDisparityMap, &gDisparityMap_viz);
 
-		//Estimating the depth
-		_Disparity.EstimateDepth((Point(300, 230)), &DepthValue);
-
-		//Taking Average
-		BaseDepth  += (DepthValue / 10);
-		DepthValue = 0;
+		//Estimating the depth, the last valid one is the longest average
+		if(_Disparity.EstimateDepth((Point(300, 230)), &DepthValue))
+		{
+			BaseDepth = DepthValue / 10;
+		}
 
 		//Text display
 		DisplayText(gDisparityMap_viz, "Base Depth Estimation", Point(30, 30));
@@ -261,9 +267,6 @@ int VolumeEstimation::BaseDepthEstimation()
 	//Closes all the windows
 	destroyAllWindows();
 
-	//Base depth value calculation	// dividing by i for the average
-	BaseDepth = BaseDepth / NoFrames;
-
 	if(DEBUG_ENABLED)
 		cout << "Volume Estimation: Base Depth Found: " << BaseDepth << endl;
 
@@ -15,6 +15,9 @@
 #pragma once
 #include "Tara.h"
 
+#define BASE_DEPTH_FRAMES	20	//Frames averaged by the temporal filter to estimate the depth of the base
+#define BASE_DEPTH_ALPHA	0.1	//Weight of each new frame in that average
+
 class VolumeEstimation
 {
 public:
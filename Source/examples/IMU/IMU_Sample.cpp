@@ -22,211 +22,21 @@ using namespace cv;
 using namespace std;
 using namespace Tara;
 
-/*
-  **********************************************************************************************************
- *  Name		:	GetIMUIntervalTime											   *
- *  Returns		:	Interval time in float										   *
- *  Description	:   Returns the interval time for sampling the values of the IMU.  * **********************************************************************************************************
-*/
-double IMU_Sample::GetIMUIntervalTime(IMUCONFIG_TypeDef	lIMUConfig)
-{
-	double lIMUIntervalTime = 10;
-
-	if(g_eRev == REVISION_A)
-	{
-		if(lIMUConfig.IMU_MODE == IMU_ACC_GYRO_ENABLE)
-		{
-			switch(lIMUConfig.IMU_ODR_CONFIG)
-			{
-				case IMU_ODR_10_14_9HZ:
-					lIMUIntervalTime = 1000.00 / 14.90 ;
-					break;
-
-				case IMU_ODR_50_59_9HZ:
-					lIMUIntervalTime = 1000.00 / 59.50 ;
-					break;
-
-				case IMU_ODR_119HZ:
-					lIMUIntervalTime = 1000.00 / 119.00;
-					break;
-
-				case IMU_ODR_238HZ:
-					lIMUIntervalTime = 1000.00 / 238.00;
-					break;
-
-				case IMU_ODR_476HZ:
-					lIMUIntervalTime = 1000.00 / 476.00;
-					break;
-
-				case IMU_ODR_952HZ:
-					lIMUIntervalTime = 1000.00 / 952.00;
-					break;
-			}
-		}
-		else if(lIMUConfig.IMU_MODE == IMU_ACC_ENABLE)
-		{
-			switch(lIMUConfig.IMU_ODR_CONFIG)
-			{
-				case IMU_ODR_10_14_9HZ:
-					lIMUIntervalTime = 1000.00 / 10.00;
-					break;
-
-				case IMU_ODR_50_59_9HZ:
-					lIMUIntervalTime = 1000.00 / 50.00;
-					break;
-
-				case IMU_ODR_119HZ:
-					lIMUIntervalTime = 1000.00 / 119.00;
-					break;
-
-				case IMU_ODR_238HZ:
-					lIMUIntervalTime = 1000.00 / 238.00;
-					break;
-
-				case IMU_ODR_476HZ:
-					lIMUIntervalTime = 1000.00 / 476.00;
-					break;
-
-				case IMU_ODR_952HZ:
-					lIMUIntervalTime = 1000.00  / 952.00;
-					break;
-			}
-		}
-	}
-	else if(g_eRev == REVISION_B)
-	{
-		switch(lIMUConfig.IMU_ODR_CONFIG)
-		{
-			case IMU_ODR_12_5HZ:
-				lIMUIntervalTime = 1000.00 / 12.5 ;
-				break;
-
-			case IMU_ODR_26HZ:
-				lIMUIntervalTime = 1000.00 / 26.00;
-				break;
-
-			case IMU_ODR_52HZ:
-				lIMUIntervalTime = 1000.00 / 52.00;
-				break;
-
-			case IMU_ODR_104HZ:
-				lIMUIntervalTime = 1000.00 / 104.00;
-				break;
-
-			case IMU_ODR_208HZ:
-				lIMUIntervalTime = 1000.00 / 208.00;
-				break;
-
-			case IMU_ODR_416HZ:
-				lIMUIntervalTime = 1000.00 / 416.00;
-				break;
-
-			case IMU_ODR_833HZ:
-				lIMUIntervalTime = 1000.00 / 833.00;
-				break;
-
-			case IMU_ODR_1666HZ:
-				lIMUIntervalTime = 1000.00 / 1666.00;
-				break;
-		}
-	}
-	return lIMUIntervalTime;
-}
-
 /* Initialises all the values */
 IMU_Sample::IMU_Sample(void)
 {
-	glIMUAbortThread = FALSE;
-	glIMU_Interval = 0.0f;
-
 	angleX = 0.0f;
 	angleY = 0.0f;
 	angleZ = 0.0f;
 }
 
-/* Square of a number */
-double IMU_Sample::squared(double x)
-{
-	return x * x;
-}
-
-/* Computes the angle of rotation with respect to the axes */
-void IMU_Sample::getInclination(double g_x, double g_y, double g_z, double a_x, double a_y, double a_z)
+/* Computes the angle of rotation with respect to the axes from the attitude of the filter */
+void IMU_Sample::getInclination(const ORIENTATION_TypeDef &Orientation)
 {
-	int w = 0;
-	double tmpf = 0.0;
-	int signRzGyro;
-	static bool firstSample = true;
-	double wGyro = 10.0;
-	double norm;
-
-	// Normalise the accelerometer measurement
-	norm = sqrt(a_x * a_x + a_y * a_y + a_z * a_z);
-	a_x /= norm;
-	a_y /= norm;
-	a_z /= norm;
-
-	double RwAcc[3] = {a_x, a_y, a_z};
-	double RwGyro[3] = { g_x, g_y, g_z };
-	double Awz[2];
-	double Gyro[3];
-
-
-	if (firstSample)
-	{
-		//initialize with accelerometer readings
-		for (w = 0; w <= 2; w++)
-		{
-			RwEst[w] = RwAcc[w];
-		}
-	}
-
-	else
-	{
-		//evaluate Gyro vector
-		if (fabs(RwEst[2]) < 0.1)
-		{
-			//Rz is too small and because it is used as reference for computing Axz, Ayz it's error fluctuations will amplify leading to bad results
-			//in this case skip the gyro data and just use previous estimate
-			for (w = 0;w <= 2;w++)
-			{
-				Gyro[w] = RwEst[w];
-			}
-		}
-		else {
-			//get angles between projection of R on ZX/ZY plane and Z axis, based on last RwEst
-			for (w = 0;w <= 1;w++)
-			{
-				tmpf = RwGyro[w];                        //get current gyro rate in deg/s
-				tmpf *= glIMU_Interval / 1000.0f;                     //get angle change in deg
-				Awz[w] = atan2(RwEst[w], RwEst[2]) * RAD2DEG;   //get angle and convert to degrees
-				Awz[w] += tmpf;             //get updated angle according to gyro movement
-			}
-
-			//estimate sign of RzGyro by looking in what qudrant the angle Axz is,
-			//RzGyro is pozitive if  Axz in range -90 ..90 => cos(Awz) >= 0
-			signRzGyro = (cos(Awz[0] * DEG2RAD) >= 0) ? 1 : -1;
-
-			//reverse calculation of Gyro from Awz angles, for formulas deductions see  http://starlino.com/imu_guide.html
-			Gyro[0] = sin(Awz[0] * DEG2RAD);
-			Gyro[0] /= sqrt(1 + squared(cos(Awz[0] * DEG2RAD)) * squared(tan(Awz[1] * DEG2RAD)));
-			Gyro[1] = sin(Awz[1] * DEG2RAD);
-			Gyro[1] /= sqrt(1 + squared(cos(Awz[1] * DEG2RAD)) * squared(tan(Awz[0] * DEG2RAD)));
-			Gyro[2] = signRzGyro * sqrt(1 - squared(Gyro[0]) - squared(Gyro[1]));
-		}
-
-		//combine Accelerometer and gyro readings
-		for (w = 0; w <= 2; w++)
-			RwEst[w] = (RwAcc[w] + wGyro * Gyro[w]) / (1 + wGyro);
-
-		//Normalizing the estimates
-		norm = sqrt(RwEst[0] * RwEst[0] + RwEst[1] * RwEst[1] + RwEst[2] * RwEst[2]);
-		RwEst[0] /= norm;
-		RwEst[1] /= norm;
-		RwEst[2] /= norm;
-	}
+	double w = Orientation.Q[0], x = Orientation.Q[1], y = Orientation.Q[2], z = Orientation.Q[3];
 
-	firstSample = false;
+	//Gravity direction in the camera frame
+	double RwEst[3] = { 2.0 * (x * z - w * y), 2.0 * (w * x + y * z), w * w - x * x - y * y + z * z };
 
 	//Computing the angles
 	angleX = RwEst[0] * HALF_PI * RAD2DEG;
@@ -341,60 +151,6 @@ void Sleep(unsigned int TimeInMilli)
 	return;
 }
 
-/* Killing the thread */
-void KillThread(int sig)
-{
-	pthread_exit(0);
-}
-
-/* GetIMUValue Thread calls the HID command */
-void* GetIMUValueThread(void *lpParameter)
-{
-	IMUDATAOUTPUT_TypeDef *lIMUOutput = (IMUDATAOUTPUT_TypeDef*)(lpParameter);
-	signal(SIGUSR1, KillThread);
-
-	//HID command
-	if(GetIMUValueBuffer(&IMUDataReadyEvent , lIMUOutput))
-	{
-		cout << "GetIMUValueBuffer success\n";
-	}
-	else
-	{
-		cout << "GetIMUValueBuffer Ended\n";
-	}
-	return NULL;
-
-}
-
-/* UpdateIMUValue Thread uses the values from the GetIMUValue everytime when the semaphore is set */
-void* UpdateIMUValueThread(void *lpParameter)
-{
-	IMUDATAOUTPUT_TypeDef *lIMUOutputAdd, *lIMUOutput = NULL;
-	lIMUOutputAdd = lIMUOutput = (IMUDATAOUTPUT_TypeDef*)(lpParameter);
-	signal(SIGUSR1, KillThread);
-
-	//Blocking call waits for unlock event
-	for( ;((glIMUAbortThread == FALSE)  && ((glIMUInput.IMU_UPDATE_MODE == IMU_CONT_UPDT_EN) ||
-		(lIMUOutput->IMU_VALUE_ID <= glIMUInput.IMU_NUM_OF_VALUES))) ; )
-	{
-		if(glIMUInput.IMU_UPDATE_MODE != IMU_CONT_UPDT_DIS)
-		{
-
-			pthread_mutex_lock(&IMUDataReadyEvent);
-		}
-
-		//Calculating angles based on the current raw values from IMU
-		IMU_SampleObj.getInclination(lIMUOutput->gyroX, lIMUOutput->gyroY, lIMUOutput->gyroZ,
-				                     lIMUOutput->accX, lIMUOutput->accY, lIMUOutput->accZ);
-		//Round robin mechanism to use the same buffer
-		if(lIMUOutput->IMU_VALUE_ID < IMU_AXES_VALUES_MAX)
-			lIMUOutput++;
-		else
-			lIMUOutput = lIMUOutputAdd;
-	}
-	return NULL;
-}
-
 /* Init the camera and read the values */
 int IMU_Sample::Init()
 {
@@ -456,8 +212,6 @@ int IMU_Sample::Init()
 			cout << "GetIMUConfig Failed\n";
 			return FALSE;
 		}
-		//Finding the sampling interval time
-		glIMU_Interval = GetIMUIntervalTime(lIMUConfig);
 	}
 
 	//Configuring IMU update mode
@@ -478,54 +232,37 @@ int IMU_Sample::Init()
 
 	//Getting the IMU values
 	cout << "\nGetting IMU Value buffer\n";
-	IMUDATAOUTPUT_TypeDef *lIMUOutput = NULL;
-	pthread_t thread1, thread2;
-
-	//Allocating buffers for output structure
-	if(glIMUInput.IMU_UPDATE_MODE == IMU_CONT_UPDT_EN)
-	{
-		lIMUOutput = (IMUDATAOUTPUT_TypeDef*)malloc(IMU_AXES_VALUES_MAX * sizeof(IMUDATAOUTPUT_TypeDef));
-	}
-	else
-	{
-		lIMUOutput = (IMUDATAOUTPUT_TypeDef*)malloc(1 * sizeof(IMUDATAOUTPUT_TypeDef));
-	}
+	ORIENTATION_TypeDef lOrientation;
 
-	//Memory validation
-	if(lIMUOutput == NULL)
-	{
-		cout << "Memory Allocation for output failed\n";
-		return FALSE;
-	}
-
-	lIMUOutput->IMU_VALUE_ID = 0;
 	cout << "\nHit Enter key to stop\n";
 
-	//Mutex initialization
-	pthread_mutex_init(&IMUDataReadyEvent, NULL);
-	pthread_mutex_lock(&IMUDataReadyEvent);
-
-	//Thread creation
-	if(pthread_create(&thread1, NULL, GetIMUValueThread, (void*) lIMUOutput) != 0)
+	//Starts the library thread which reads the IMU values
+	if(!StartIMUCapture())
 	{
-		cout << "Get IMU value thread creation failed\n";
+		cout << "StartIMUCapture Failed\n";
 		return FALSE;
 	}
-	if(pthread_create(&thread2, NULL, UpdateIMUValueThread, (void*) lIMUOutput) != 0)
+
+	//Starts the orientation filter on the IMU values
+	if(!_OrientationFilter.Start())
 	{
-		cout << "Update IMU value thread creation failed\n";
+		cout << "Orientation filter start failed\n";
+		StopIMUCapture();
 		return FALSE;
 	}
 
 	//Calling function
 	for(;(!kbhit() && (glIMUInput.IMU_UPDATE_MODE != IMU_CONT_UPDT_DIS));)
 	{
+		//Calculating angles based on the latest attitude
+		if(_OrientationFilter.GetOrientation(&lOrientation))
+			getInclination(lOrientation);
+
 		updateCircles();
 		Sleep(1);
 	}
 
 	cout << "Keyboard hitted\n";
-	glIMUAbortThread = TRUE;
 	lIMUInput.IMU_UPDATE_MODE = IMU_CONT_UPDT_DIS;
 	lIMUInput.IMU_NUM_OF_VALUES = IMU_AXES_VALUES_MIN;
 
@@ -537,14 +274,13 @@ int IMU_Sample::Init()
 		return FALSE;
 	}
 
-	//Releasing the threads and mutex
-	pthread_kill(thread1, SIGUSR1);
-	pthread_kill(thread2, SIGUSR1);
-	pthread_mutex_destroy(&IMUDataReadyEvent);
-	glIMUAbortThread = FALSE;
+	//Stopping the capture wakes up the filter thread, which then exits
+	StopIMUCapture();
+	_OrientationFilter.Stop();
+
+	if(DEBUG_ENABLED)
+		cout << "Orientation filter : " << _OrientationFilter.GetAverageUpdateNs() << " ns per sample\n";
 
-	//Freeing the memory
-	free(lIMUOutput);
 	DeinitExtensionUnit();
 
 	return TRUE;
@@ -19,7 +19,6 @@
 #include "Tara.h"
 #include <math.h>
 #include <pthread.h>
-#include <signal.h>
 
 #define		M_PI				3.14159265358979323846
 #define		HALF_PI				(M_PI / 2)
@@ -36,35 +35,25 @@ public:
 	int Init();
 
 	// Function declarations
-	void getInclination(double w_x, double w_y, double w_z, double a_x, double a_y, double a_z);
+	void getInclination(const Tara::ORIENTATION_TypeDef &Orientation);
 
 private:
 
 	double angleX, angleY, angleZ; // Rotational angle for cube [NEW]
-	double RwEst[3];
-	double glIMU_Interval;
 
 	TaraRev g_eRev;
-	double squared(double x);
+
+	//Attitude estimation running on the IMU values
+	Tara::OrientationFilter _OrientationFilter;
 
 	/* Drawing Points in circles for illustration*/
 	cv::Point PointOnCircle(double radius, double angleInDegrees, cv::Point origin);
 
 	/* Drawing angles in circles for illustration */
 	void updateCircles();
-
-	/*  Returns the interval time for sampling the values of the IMU. */
-	double GetIMUIntervalTime(IMUCONFIG_TypeDef	lIMUConfig);
 }IMU_SampleObj;
 
 IMUDATAINPUT_TypeDef			glIMUInput;
-BOOL						    glIMUAbortThread;
-pthread_mutex_t				    IMUDataReadyEvent;
-
-//Pthread call routine
-void*	GetIMUValueThread(void *lpParameter);
-
-void*	UpdateIMUValueThread(void *lpParameter);
 
 //Keyboard hit detection
 int 	kbhit(void);
@@ -200,16 +200,23 @@ int PointCloudApp::ShowPointCloud()
 {
 	#pragma region For Point Cloud Rendering
 
-		cv::Mat xyz;
+		cv::Mat xyz, Valid;
         reprojectImageTo3D(gDisparityMap, xyz, _Disparity.DepthMap, true);
 
+		//Pixels without a disparity are skipped before their depth is read
+		_Disparity.GetConfidenceMap(NULL, &Valid);
+
 		PointCloud<PointXYZRGB>::Ptr point_cloud_ptr (new PointCloud<PointXYZRGB>);
 		const double max_z = 1.0e4;
 
 		for (int Row = 0; Row < xyz.rows; Row++)
 		{
+			const uchar *ValidRow = Valid.empty() ? NULL : Valid.ptr<uchar>(Row);
 			for (int Col = 0; Col < xyz.cols-100; Col++)
 			{
+				if(ValidRow && !ValidRow[Col])
+					continue;
+
 				PointXYZRGB point;
 				uchar Pix=(uchar)255;
 				//Just taking the Z Axis alone
@@ -0,0 +1,432 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+/**********************************************************************
+ DisparityBenchmark: Measures the latency of the disparity presets on
+		the same captured or recorded frames, checks that the
+		striped SGBM gives the same disparity as the single call
+		and compares the census SGM matcher, the temporal
+		prior and the post processing with the full SGBM search.
+**********************************************************************/
+
+#include "DisparityBenchmark.h"
+
+using namespace cv;
+using namespace std;
+using namespace Tara;
+
+//Initialises all the necessary files
+int DisparityBenchmark::Init(string RecordDir)
+{
+	DISPARITYPARAMS_TypeDef Params;
+	vector<Mat> Reference, Striped, SGBMReference, WithPrior, FullSize, EdgeAware, WithCheck, PostProcessed, Temporal, Upsampled;
+	int Stripes = getNumberOfCPUs();
+
+	cout << endl  << "		Disparity Benchmark Application " << endl  << endl;
+	cout << " Disparity Benchmark - Measures the disparity presets on the same frames" << endl << endl;
+
+	//Initialise the camera
+	if(!_Disparity.InitCamera(true, false))
+	{
+		if(DEBUG_ENABLED)
+			cout << "Camera Initialisation Failed\n";
+		return FALSE;
+	}
+
+	//Frames recorded by a previous run are matched again, otherwise they are captured and recorded
+	if(RecordDir.empty() || !LoadFrames(RecordDir))
+	{
+		if(!CaptureFrames())
+			return FALSE;
+
+		if(!RecordDir.empty())
+			SaveFrames(RecordDir);
+	}
+
+	for(int Preset = 0; Preset < DISPARITY_PRESET_COUNT; Preset++)
+	{
+		GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+		RunConfiguration(DisparityPresetStr((DisparityPreset)Preset), Params, &Reference);
+
+		if(Preset == DISPARITY_PRESET_BALANCED_SGBM)
+			SGBMReference = Reference;
+
+		//The census and semi dense matchers are checked against SGBM on the same scale
+		if((Params.Matcher == DISPARITY_MATCHER_CENSUS_SGM || Params.Matcher == DISPARITY_MATCHER_SEMI_DENSE) && !SGBMReference.empty())
+			CompareMatchers("SGBM", SGBMReference, Reference);
+
+		//The WLS filter is replaced by the edge aware filters of the left view on the same matching
+		if(Params.Filtered && Params.PostFilter == DISPARITY_FILTER_WLS)
+		{
+			for(int Filter = DISPARITY_FILTER_DOMAIN_TRANSFORM; Filter <= DISPARITY_FILTER_GUIDED; Filter++)
+			{
+				GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+				Params.PostFilter = Filter;
+
+				RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ((Filter == DISPARITY_FILTER_GUIDED) ?
+						", guided filter instead" : ", domain transform instead"), Params, &EdgeAware);
+				CompareMatchers("WLS", Reference, EdgeAware);
+			}
+			GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+		}
+
+		//The pyramid matcher is checked against SGBM over the full range on the full size images,
+		//its latency is read against that run and the Balanced SGBM preset
+		if(Params.Matcher == DISPARITY_MATCHER_PYRAMID_SGBM)
+		{
+			DISPARITYPARAMS_TypeDef FullSizeParams;
+			GetDisparityPresetParams(DISPARITY_PRESET_QUALITY_SGBM_WLS, &FullSizeParams);
+			FullSizeParams.Filtered = false;
+			RunConfiguration("Full size SGBM", FullSizeParams, &FullSize);
+			CompareMatchers("full size SGBM", FullSize, Reference);
+		}
+
+		//The SGBM presets are also matched in stripes, one per core
+		if(Params.Matcher == DISPARITY_MATCHER_SGBM && Stripes > 1)
+		{
+			stringstream ss;
+			ss << DisparityPresetStr((DisparityPreset)Preset) << ", " << Stripes << " stripes";
+
+			Params.Stripes = Stripes;
+			RunConfiguration(ss.str(), Params, &Striped);
+			CompareStripes(Reference, Striped, Stripes);
+		}
+
+		//The speckles of BM and SGBM removed in parallel tiles after matching instead of inside the matcher
+		if(Params.Matcher == DISPARITY_MATCHER_BM || Params.Matcher == DISPARITY_MATCHER_SGBM)
+		{
+			GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+			Params.ParallelSpeckle = true;
+			RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ", parallel speckle filter", Params, &PostProcessed);
+			CompareMatchers("the speckle filter of the matcher", Reference, PostProcessed);
+		}
+
+		//The consecutive frames matched with the range of the previous map, then with the range of a coarse pass
+		if(Preset == DISPARITY_PRESET_BALANCED_SGBM)
+		{
+			for(int Prior = DISPARITY_PRIOR_STATIC; Prior <= DISPARITY_PRIOR_MOTION + 1; Prior++)
+			{
+				GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+				Params.TemporalPrior = (Prior <= DISPARITY_PRIOR_MOTION) ? Prior : DISPARITY_PRIOR_OFF;
+				Params.AutoRange = (Prior > DISPARITY_PRIOR_MOTION);
+
+				RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ((Prior == DISPARITY_PRIOR_STATIC) ? ", static prior" :
+						(Prior == DISPARITY_PRIOR_MOTION) ? ", motion prior" : ", auto range"), Params, &WithPrior);
+				CompareMatchers("the full search", SGBMReference, WithPrior);
+			}
+
+			//Pixels rejected by the LR check, its cost is read against the latency of a preset with the right matcher
+			GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+			Params.LRCheck = true;
+			RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ", LR check", Params, &WithCheck);
+			CompareMatchers("no LR check", SGBMReference, WithCheck);
+
+			//The holes of the LR check filled from their background
+			Params.ParallelSpeckle = true;
+			Params.HoleFill = DISPARITY_HOLE_FILL_BACKGROUND;
+			RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ", LR check, hole filling", Params, &PostProcessed);
+			CompareMatchers("no LR check", SGBMReference, PostProcessed);
+
+			//Flicker averaged out by the temporal filter, its latency is read against the preset with the WLS filter
+			GetDisparityPresetParams((DisparityPreset)Preset, &Params);
+			Params.TemporalAlpha = BENCHMARK_TEMPORAL_ALPHA;
+			Params.TemporalPersistence = BENCHMARK_TEMPORAL_PERSISTENCE;
+			RunConfiguration(string(DisparityPresetStr((DisparityPreset)Preset)) + ", temporal filter", Params, &Temporal);
+			CompareMatchers("no temporal filter", SGBMReference, Temporal);
+			CompareFlicker("no temporal filter", SGBMReference, Temporal);
+		}
+	}
+
+	//The Balanced SGBM map scaled back to the image size by each upsampling, checked against SGBM on the full size images.
+	//The maps keep the disparities of the matching scale, they are brought to the full size ones first
+	if(!FullSize.empty())
+	{
+		for(int Upsampling = DISPARITY_UPSAMPLE_BILINEAR; Upsampling <= DISPARITY_UPSAMPLE_GUIDED; Upsampling++)
+		{
+			GetDisparityPresetParams(DISPARITY_PRESET_BALANCED_SGBM, &Params);
+			Params.Upsampling = Upsampling;
+
+			RunConfiguration(string(DisparityPresetStr(DISPARITY_PRESET_BALANCED_SGBM)) + ((Upsampling == DISPARITY_UPSAMPLE_BILINEAR) ? ", bilinear upsampling" :
+					(Upsampling == DISPARITY_UPSAMPLE_JOINT_BILATERAL) ? ", joint bilateral upsampling" : ", guided upsampling"), Params, &Upsampled);
+
+			for(size_t Frame = 0; Frame < Upsampled.size(); Frame++)
+			{
+				Mat Invalid = (Upsampled[Frame] < 0);
+				Upsampled[Frame].convertTo(Upsampled[Frame], CV_16S, 1.0 / Params.ScaleImage);
+				Upsampled[Frame].setTo(Scalar(-1), Invalid);
+			}
+			CompareMatchers("full size SGBM", FullSize, Upsampled);
+		}
+	}
+
+	MeasureOutputs();
+
+	return TRUE;
+}
+
+//Captures the frames used by all the configurations
+BOOL DisparityBenchmark::CaptureFrames()
+{
+	Mat LeftImage, RightImage;
+
+	cout << "Capturing " << BENCHMARK_FRAMES << " frames, keep the scene in front of the camera" << endl;
+
+	LeftFrames.clear();
+	RightFrames.clear();
+	while(LeftFrames.size() < BENCHMARK_FRAMES)
+	{
+		if(!_Disparity.GrabFrame(&LeftImage, &RightImage)) //Reads the frame and returns the rectified image
+		{
+			cout << "CaptureFrames : Grabbing the frame failed" << endl;
+			return FALSE;
+		}
+
+		LeftFrames.push_back(LeftImage.clone());
+		RightFrames.push_back(RightImage.clone());
+	}
+
+	return TRUE;
+}
+
+//Loads the frames recorded by SaveFrames
+BOOL DisparityBenchmark::LoadFrames(string RecordDir)
+{
+	char FileName[32];
+	Mat LeftImage, RightImage;
+
+	LeftFrames.clear();
+	RightFrames.clear();
+	while(LeftFrames.size() < BENCHMARK_FRAMES)
+	{
+		sprintf(FileName, "/left_%03d.png", (int)LeftFrames.size());
+		LeftImage = imread(RecordDir + FileName, IMREAD_GRAYSCALE);
+		sprintf(FileName, "/right_%03d.png", (int)RightFrames.size());
+		RightImage = imread(RecordDir + FileName, IMREAD_GRAYSCALE);
+
+		if(LeftImage.empty() || RightImage.empty())
+			break;
+
+		LeftFrames.push_back(LeftImage);
+		RightFrames.push_back(RightImage);
+	}
+
+	if(LeftFrames.empty())
+		return FALSE;
+
+	cout << "Loaded " << LeftFrames.size() << " recorded frames from " << RecordDir << endl;
+	return TRUE;
+}
+
+//Records the captured frames as PNG files, loaded by the next run
+BOOL DisparityBenchmark::SaveFrames(string RecordDir)
+{
+	char FileName[32];
+
+	for(size_t Frame = 0; Frame < LeftFrames.size(); Frame++)
+	{
+		sprintf(FileName, "/left_%03d.png", (int)Frame);
+		if(!imwrite(RecordDir + FileName, LeftFrames[Frame]))
+		{
+			cout << "SaveFrames : Writing to " << RecordDir << " failed" << endl;
+			return FALSE;
+		}
+		sprintf(FileName, "/right_%03d.png", (int)Frame);
+		imwrite(RecordDir + FileName, RightFrames[Frame]);
+	}
+
+	cout << "Recorded " << LeftFrames.size() << " frames to " << RecordDir << endl;
+	return TRUE;
+}
+
+//Runs GetDisparity on the captured frames and prints the measured cost
+BOOL DisparityBenchmark::RunConfiguration(string Name, const DISPARITYPARAMS_TypeDef &Params, vector<Mat> *Disparities)
+{
+	DISPARITYTIMING_TypeDef Timing;
+	double TotalMs = 0, MaxMs = 0, FrameMs;
+	int64 Start;
+
+	_Disparity.SetDisparityParams(Params);
+
+	//The parameters are applied and the buffers allocated by the first frames, a short recording has fewer
+	for(size_t Frame = 0; Frame < min((size_t)BENCHMARK_WARMUP, LeftFrames.size()); Frame++)
+	{
+		_Disparity.GetDisparity(LeftFrames[Frame], RightFrames[Frame]);
+	}
+
+	Disparities->clear();
+	for(size_t Frame = 0; Frame < LeftFrames.size(); Frame++)
+	{
+		Start = getTickCount();
+		_Disparity.GetDisparity(LeftFrames[Frame], RightFrames[Frame]);
+		FrameMs = (getTickCount() - Start) * 1000.0 / getTickFrequency();
+
+		TotalMs += FrameMs;
+		MaxMs = max(MaxMs, FrameMs);
+		Disparities->push_back(_Disparity.gDisparityMap.clone());
+	}
+
+	cout.precision(1);
+	cout << fixed << Name << " : " << TotalMs / LeftFrames.size() << " ms mean, " << MaxMs << " ms max, "
+		<< 1000.0 * LeftFrames.size() / TotalMs << " fps" << endl;
+
+	//Matching cost saved by the prior or the auto range
+	if(_Disparity.GetDisparityTiming(&Timing) && Timing.SearchRatio != 1.0)
+	{
+		cout << "	" << 100.0 * Timing.SearchRatio << " % of the disparities searched" << endl;
+	}
+
+	return TRUE;
+}
+
+//Measures ColouriseDisparity and GetDepthMap alone on the map of the last configuration
+void DisparityBenchmark::MeasureOutputs()
+{
+	Mat gDisparityMap, gDisparityMap_viz, DepthMap;
+	double ColouriseMs = 0, DepthMs = 0;
+	int64 Start;
+
+	for(size_t Frame = 0; Frame < LeftFrames.size(); Frame++)
+	{
+		Start = getTickCount();
+		_Disparity.ColouriseDisparity(&gDisparityMap, &gDisparityMap_viz);
+		ColouriseMs += (getTickCount() - Start) * 1000.0 / getTickFrequency();
+
+		Start = getTickCount();
+		_Disparity.GetDepthMap(&DepthMap, CV_16U);
+		DepthMs += (getTickCount() - Start) * 1000.0 / getTickFrequency();
+	}
+
+	cout.precision(2);
+	cout << fixed << "Colourise : " << ColouriseMs / max(LeftFrames.size(), (size_t)1) << " ms mean, depth map : "
+		<< DepthMs / max(LeftFrames.size(), (size_t)1) << " ms mean, added only by their consumers" << endl;
+}
+
+//Compares a striped run with the single call run, near the stripe seams and elsewhere
+void DisparityBenchmark::CompareStripes(const vector<Mat> &Reference, const vector<Mat> &Striped, int Stripes)
+{
+	double SeamDiff = 0, SeamPixels = 0, OtherDiff = 0, OtherPixels = 0;
+	Mat Mismatch, RowDiff;
+	bool NearSeam;
+
+	for(size_t Frame = 0; Frame < Reference.size() && Frame < Striped.size(); Frame++)
+	{
+		const Mat &Ref = Reference[Frame], &Str = Striped[Frame];
+
+		//Pixels differing by more than one disparity level or valid in only one of the maps
+		Mismatch = (abs(Ref - Str) > StereoMatcher::DISP_SCALE) | ((Ref >= 0) != (Str >= 0));
+		reduce(Mismatch / 255, RowDiff, 1, REDUCE_SUM, CV_32S);
+
+		for(int Row = 0; Row < Ref.rows; Row++)
+		{
+			NearSeam = false;
+			for(int Seam = 1; Seam < Stripes; Seam++)
+			{
+				if(abs(Row - Ref.rows * Seam / Stripes) <= BENCHMARK_SEAM_BAND)
+					NearSeam = true;
+			}
+
+			if(NearSeam)
+			{
+				SeamDiff += RowDiff.at<int>(Row, 0);
+				SeamPixels += Ref.cols;
+			}
+			else
+			{
+				OtherDiff += RowDiff.at<int>(Row, 0);
+				OtherPixels += Ref.cols;
+			}
+		}
+	}
+
+	cout.precision(3);
+	cout << fixed << "	Differences to the single call : " << 100.0 * SeamDiff / max(SeamPixels, 1.0) << " % near the seams, "
+		<< 100.0 * OtherDiff / max(OtherPixels, 1.0) << " % elsewhere" << endl;
+}
+
+//Compares a matcher with the SGBM reference, density of both and disagreement where both are valid
+void DisparityBenchmark::CompareMatchers(string Name, const vector<Mat> &Reference, const vector<Mat> &Disparities)
+{
+	double RefValid = 0, Valid = 0, BothValid = 0, Differ = 0, Pixels = 0;
+	Mat RefMask, Mask, BothMask;
+
+	for(size_t Frame = 0; Frame < Reference.size() && Frame < Disparities.size(); Frame++)
+	{
+		const Mat &Ref = Reference[Frame], &Disp = Disparities[Frame];
+
+		RefMask = (Ref >= 0);
+		Mask = (Disp >= 0);
+		BothMask = RefMask & Mask;
+
+		RefValid += countNonZero(RefMask);
+		Valid += countNonZero(Mask);
+		BothValid += countNonZero(BothMask);
+		Differ += countNonZero((abs(Ref - Disp) > StereoMatcher::DISP_SCALE) & BothMask);
+		Pixels += (double)Ref.total();
+	}
+
+	cout.precision(1);
+	cout << fixed << "	Against " << Name << " : " << 100.0 * Valid / max(Pixels, 1.0) << " % valid (reference " << 100.0 * RefValid / max(Pixels, 1.0)
+		<< " %), " << 100.0 * Differ / max(BothValid, 1.0) << " % of the pixels valid in both differ by more than one disparity" << endl;
+}
+
+//Sums the change of the disparity between consecutive frames over the pixels valid in both
+static void SumFrameChange(const vector<Mat> &Disparities, double *Change, double *Pixels)
+{
+	Mat Mask, Diff;
+
+	*Change = 0;
+	*Pixels = 0;
+	for(size_t Frame = 1; Frame < Disparities.size(); Frame++)
+	{
+		Mask = (Disparities[Frame] >= 0) & (Disparities[Frame - 1] >= 0);
+		absdiff(Disparities[Frame], Disparities[Frame - 1], Diff);
+		Diff.setTo(Scalar(0), ~Mask);
+
+		*Change += sum(Diff)[0];
+		*Pixels += countNonZero(Mask);
+	}
+}
+
+//Compares the mean change of the disparity between consecutive frames, where both frames are valid
+void DisparityBenchmark::CompareFlicker(string Name, const vector<Mat> &Reference, const vector<Mat> &Disparities)
+{
+	double RefChange, RefPixels, Change, Pixels;
+
+	SumFrameChange(Reference, &RefChange, &RefPixels);
+	SumFrameChange(Disparities, &Change, &Pixels);
+
+	cout.precision(3);
+	cout << fixed << "	Flicker against " << Name << " : " << Change / max(Pixels, 1.0) / StereoMatcher::DISP_SCALE << " disparities per frame (reference "
+		<< RefChange / max(RefPixels, 1.0) / StereoMatcher::DISP_SCALE << ")" << endl;
+}
+
+//main application
+int main(int argc, char **argv)
+{
+	if(DEBUG_ENABLED)
+	{
+		cout << "Disparity Benchmark\n";
+		cout << "-------------------\n\n";
+	}
+
+	//Disparity Benchmark
+	DisparityBenchmark _DisparityBenchmark;
+	_DisparityBenchmark.Init((argc > 1) ? argv[1] : "");
+
+	if(DEBUG_ENABLED)
+		cout << "Exit : Disparity Benchmark\n";
+
+	return TRUE;
+}
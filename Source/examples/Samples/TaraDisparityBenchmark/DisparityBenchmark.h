@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2018, e-con Systems.
+//
+// All rights reserved.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS.
+// IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT/INDIRECT DAMAGES HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Tara.h"
+
+#define BENCHMARK_FRAMES		100	//Frames captured once and matched by every configuration
+#define BENCHMARK_WARMUP		5	//Frames matched before the timing starts
+#define BENCHMARK_SEAM_BAND		20	//Rows on each side of a stripe seam checked for artefacts
+#define BENCHMARK_TEMPORAL_ALPHA	0.2	//Weight of the new frame of the temporal filter run
+#define BENCHMARK_TEMPORAL_PERSISTENCE	5	//Frames a hole keeps its average in that run
+
+class DisparityBenchmark
+{
+public:
+	//Initalises the methods, RecordDir holds the frames recorded by a previous run or receives the captured ones
+	int Init(std::string RecordDir);
+
+private:
+
+	//Captures the frames used by all the configurations
+	BOOL CaptureFrames();
+
+	//Loads the frames recorded by SaveFrames
+	BOOL LoadFrames(std::string RecordDir);
+
+	//Records the captured frames as PNG files
+	BOOL SaveFrames(std::string RecordDir);
+
+	//Runs the compute only GetDisparity on the captured frames and prints the measured cost
+	BOOL RunConfiguration(std::string Name, const Tara::DISPARITYPARAMS_TypeDef &Params, std::vector<cv::Mat> *Disparities);
+
+	//Measures ColouriseDisparity and GetDepthMap alone, the cost their consumers add to GetDisparity
+	void MeasureOutputs();
+
+	//Compares a striped run with the single call run, near the stripe seams and elsewhere
+	void CompareStripes(const std::vector<cv::Mat> &Reference, const std::vector<cv::Mat> &Striped, int Stripes);
+
+	//Compares a matcher with the SGBM reference, density of both and disagreement where both are valid
+	void CompareMatchers(std::string Name, const std::vector<cv::Mat> &Reference, const std::vector<cv::Mat> &Disparities);
+
+	//Compares the change of the disparity between consecutive frames, where both frames are valid
+	void CompareFlicker(std::string Name, const std::vector<cv::Mat> &Reference, const std::vector<cv::Mat> &Disparities);
+
+	//disparity Object
+	Tara::Disparity _Disparity;
+
+	//Rectified frames
+	std::vector<cv::Mat> LeftFrames, RightFrames;
+};
@@ -52,6 +52,8 @@ int DisparityViewer::CameraStreaming()
 	bool GrayScaleDisplay = false;
 	int  BrightnessVal = 4;		//Default value
 	int ManualExposure = 0;
+	int Preset = DISPARITY_OPTION ? DISPARITY_PRESET_BALANCED_SGBM : DISPARITY_PRESET_FAST_BM;
+	DISPARITYTIMING_TypeDef Timing;
 
 	//Window creation
 	namedWindow("Disparity Image", WINDOW_AUTOSIZE);
@@ -62,7 +64,10 @@ int DisparityViewer::CameraStreaming()
 	cout << endl << "Press b/B on the Image Window to change the brightness of the camera" << endl;
 	cout << endl << "Press d/D on the Image Window to see the grayscale disparity map" << endl;
 	cout << endl << "Press a/A on the Image Window to change to Auto exposure  of the camera" << endl;
-	cout << endl << "Press e/E on the Image Window to change the exposure of the camera" << endl << endl;
+	cout << endl << "Press e/E on the Image Window to change the exposure of the camera" << endl;
+	cout << endl << "Press p/P on the Image Window to switch to the next disparity preset" << endl;
+	cout << endl << "Press g/G on the Image Window to toggle the automatic disparity range" << endl;
+	cout << endl << "Press f/F on the Image Window to switch to the next disparity post filter" << endl << endl;
 
 	cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 	string Inputline;
@@ -79,6 +84,18 @@ int DisparityViewer::CameraStreaming()
 		//Get disparity
 		_Disparity.GetDisparity(LeftImage, RightImage, &gDisparityMap, &gDisparityMap_viz);
 
+		//Measured cost of the current preset
+		if(_Disparity.GetDisparityTiming(&Timing))
+		{
+			stringstream ss;
+			ss.precision(1);
+			ss << fixed << Timing.LatencyMs << " ms, " << Timing.Fps << " fps";
+			if(Timing.SearchRatio != 1.0)
+				ss << ", " << 100.0 * Timing.SearchRatio << " % searched";
+			DisplayText(gDisparityMap_viz, DisparityPresetStr((DisparityPreset)Preset), Point(20, 40));
+			DisplayText(gDisparityMap_viz, ss.str(), Point(20, 80));
+		}
+
 		//Display the Images
 		imshow("Disparity Image", gDisparityMap_viz);
 		imshow("Left Image", LeftImage);
@@ -146,6 +163,41 @@ int DisparityViewer::CameraStreaming()
 				cout << endl << " Value out of Range - Invalid!!" << endl;
 			}
 		}
+		else if(WaitKeyStatus == 'p' || WaitKeyStatus == 'P') //Disparity preset
+		{
+			Preset = (Preset + 1) % DISPARITY_PRESET_COUNT;
+			_Disparity.SetDisparityPreset((DisparityPreset)Preset);
+			cout << endl << "Disparity preset : " << DisparityPresetStr((DisparityPreset)Preset) << endl;
+		}
+		else if(WaitKeyStatus == 'g' || WaitKeyStatus == 'G') //Automatic disparity range
+		{
+			DISPARITYPARAMS_TypeDef Params;
+			_Disparity.GetDisparityParams(&Params);
+			Params.AutoRange = !Params.AutoRange;
+			_Disparity.SetDisparityParams(Params);
+			cout << endl << "Automatic disparity range : " << (Params.AutoRange ? "on" : "off") << endl;
+		}
+		else if(WaitKeyStatus == 'f' || WaitKeyStatus == 'F') //Post filter: none, WLS, domain transform, guided
+		{
+			DISPARITYPARAMS_TypeDef Params;
+			_Disparity.GetDisparityParams(&Params);
+			if(!Params.Filtered)
+			{
+				Params.Filtered = true;
+				Params.PostFilter = DISPARITY_FILTER_WLS;
+			}
+			else if(Params.PostFilter == DISPARITY_FILTER_GUIDED)
+			{
+				Params.Filtered = false;
+			}
+			else
+			{
+				Params.PostFilter++;
+			}
+			_Disparity.SetDisparityParams(Params);
+			cout << endl << "Disparity post filter : " << (!Params.Filtered ? "off" : (Params.PostFilter == DISPARITY_FILTER_WLS) ? "WLS" :
+					(Params.PostFilter == DISPARITY_FILTER_DOMAIN_TRANSFORM) ? "domain transform" : "guided") << endl;
+		}
 		//Sets up Auto Exposure
 		else if(WaitKeyStatus == 'a' || WaitKeyStatus == 'A' ) //Auto Exposure
 		{